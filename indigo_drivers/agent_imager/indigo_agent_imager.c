@@ -59,6 +59,11 @@
 #define AGENT_IMAGER_FOCUS_FINAL_ITEM  				(AGENT_IMAGER_FOCUS_PROPERTY->items+1)
 #define AGENT_IMAGER_FOCUS_BACKLASH_ITEM     	(AGENT_IMAGER_FOCUS_PROPERTY->items+2)
 #define AGENT_IMAGER_FOCUS_STACK_ITEM					(AGENT_IMAGER_FOCUS_PROPERTY->items+3)
+#define AGENT_IMAGER_FOCUS_POINTS_ITEM				(AGENT_IMAGER_FOCUS_PROPERTY->items+4)
+
+#define AGENT_IMAGER_FOCUS_MODE_PROPERTY			(DEVICE_PRIVATE_DATA->agent_imager_focus_mode_property)
+#define AGENT_IMAGER_FOCUS_ITERATIVE_ITEM			(AGENT_IMAGER_FOCUS_MODE_PROPERTY->items+0)
+#define AGENT_IMAGER_FOCUS_CURVE_ITEM					(AGENT_IMAGER_FOCUS_MODE_PROPERTY->items+1)
 
 #define AGENT_IMAGER_DITHERING_PROPERTY				(DEVICE_PRIVATE_DATA->agent_imager_dithering_property)
 #define AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM (AGENT_IMAGER_DITHERING_PROPERTY->items+0)
@@ -104,6 +109,8 @@
 #define AGENT_IMAGER_STATS_FWHM_ITEM      		(AGENT_IMAGER_STATS_PROPERTY->items+8)
 #define AGENT_IMAGER_STATS_HFD_ITEM      			(AGENT_IMAGER_STATS_PROPERTY->items+9)
 #define AGENT_IMAGER_STATS_PEAK_ITEM      		(AGENT_IMAGER_STATS_PROPERTY->items+10)
+#define AGENT_IMAGER_STATS_MEDIAN_HFD_ITEM		(AGENT_IMAGER_STATS_PROPERTY->items+11)
+#define AGENT_IMAGER_STATS_STAR_COUNT_ITEM		(AGENT_IMAGER_STATS_PROPERTY->items+12)
 
 #define AGENT_IMAGER_SELECTION_PROPERTY				(DEVICE_PRIVATE_DATA->agent_selection_property)
 #define AGENT_IMAGER_SELECTION_X_ITEM  				(AGENT_IMAGER_SELECTION_PROPERTY->items+0)
@@ -115,12 +122,16 @@
 #define SEQUENCE_SIZE			16
 
 #define SELECTION_RADIUS	9
+#define FOCUS_MIN_STARS		10
+#define FOCUS_MAX_POINTS	15
+#define FOCUS_MIN_FIT			4
 
 #define MAX(X, Y) (((X) > (Y)) ? (X) : (Y))
 
 typedef struct {
 	indigo_property *agent_imager_batch_property;
 	indigo_property *agent_imager_focus_property;
+	indigo_property *agent_imager_focus_mode_property;
 	indigo_property *agent_imager_dithering_property;
 	indigo_property *agent_imager_download_file_property;
 	indigo_property *agent_imager_download_files_property;
@@ -151,6 +162,7 @@ static void save_config(indigo_device *device) {
 	pthread_mutex_lock(&DEVICE_PRIVATE_DATA->mutex);
 	indigo_save_property(device, NULL, AGENT_IMAGER_BATCH_PROPERTY);
 	indigo_save_property(device, NULL, AGENT_IMAGER_FOCUS_PROPERTY);
+	indigo_save_property(device, NULL, AGENT_IMAGER_FOCUS_MODE_PROPERTY);
 	indigo_save_property(device, NULL, AGENT_IMAGER_DITHERING_PROPERTY);
 	indigo_save_property(device, NULL, AGENT_IMAGER_SEQUENCE_PROPERTY);
 	if (DEVICE_CONTEXT->property_save_file_handle) {
@@ -200,21 +212,21 @@ static void set_headers(indigo_device *device) {
 	}
 }
 
-static bool capture_raw_frame(indigo_device *device) {
+static indigo_raw_header *expose_raw_frame(indigo_device *device) {
 	indigo_property *remote_exposure_property = indigo_filter_cached_property(device, INDIGO_FILTER_CCD_INDEX, CCD_EXPOSURE_PROPERTY_NAME);
 	if (remote_exposure_property == NULL) {
 		INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE not found");
-		return false;
+		return NULL;
 	}
 	indigo_property *remote_image_property = indigo_filter_cached_property(device, INDIGO_FILTER_CCD_INDEX, CCD_IMAGE_PROPERTY_NAME);
 	if (remote_image_property == NULL) {
 		INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_IMAGE not found");
-		return false;
+		return NULL;
 	}
 	indigo_property *remote_format_property = indigo_filter_cached_property(device, INDIGO_FILTER_CCD_INDEX, CCD_IMAGE_FORMAT_PROPERTY_NAME);
 	if (remote_format_property == NULL) {
 		INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_IMAGE_FORMAT not found");
-		return false;
+		return NULL;
 	}
 	for (int item_index = 0; item_index < remote_format_property->count; item_index++) {
 		indigo_item *item = remote_format_property->items + item_index;
@@ -226,7 +238,7 @@ static bool capture_raw_frame(indigo_device *device) {
 		while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
 			indigo_usleep(200000);
 		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-			return false;
+			return NULL;
 		indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, remote_exposure_property->device, CCD_EXPOSURE_PROPERTY_NAME, CCD_EXPOSURE_ITEM_NAME, exposure_time);
 		for (int i = 0; i < 1000 && remote_exposure_property->state != INDIGO_BUSY_STATE && AGENT_ABORT_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE && AGENT_PAUSE_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE; i++)
 			indigo_usleep(1000);
@@ -237,7 +249,7 @@ static bool capture_raw_frame(indigo_device *device) {
 			continue;
 		}
 		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-			return false;
+			return NULL;
 		if (remote_exposure_property->state != INDIGO_BUSY_STATE) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become busy in 1 second");
 			indigo_usleep(ONE_SECOND_DELAY);
@@ -269,7 +281,7 @@ static bool capture_raw_frame(indigo_device *device) {
 			continue;
 		}
 		if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-			return false;
+			return NULL;
 		if (remote_exposure_property->state != INDIGO_OK_STATE) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become OK");
 			indigo_usleep(ONE_SECOND_DELAY);
@@ -279,52 +291,65 @@ static bool capture_raw_frame(indigo_device *device) {
 	}
 	if (remote_exposure_property->state != INDIGO_OK_STATE) {
 		INDIGO_DRIVER_ERROR(DRIVER_NAME, "Exposure failed");
-		return false;
+		return NULL;
+	}
+	if (strchr(remote_image_property->device, '@'))
+		indigo_populate_http_blob_item(remote_image_property->items);
+	indigo_raw_header *header = (indigo_raw_header *)(remote_image_property->items->blob.value);
+	if (header == NULL || (header->signature != INDIGO_RAW_MONO8 && header->signature != INDIGO_RAW_MONO16 && header->signature != INDIGO_RAW_RGB24 && header->signature != INDIGO_RAW_RGB48)) {
+		indigo_send_message(device, "Invalid image format, only RAW is supported");
+		return NULL;
 	}
-	if (AGENT_IMAGER_SELECTION_X_ITEM->number.value > 0 && AGENT_IMAGER_SELECTION_X_ITEM->number.value > 0) {
-		if (strchr(remote_image_property->device, '@'))
-			indigo_populate_http_blob_item(remote_image_property->items);
-		indigo_raw_header *header = (indigo_raw_header *)(remote_image_property->items->blob.value);
-		if (header && (header->signature == INDIGO_RAW_MONO8 || header->signature == INDIGO_RAW_MONO16 || header->signature == INDIGO_RAW_RGB24 || header->signature == INDIGO_RAW_RGB48)) {
-			if (AGENT_IMAGER_STATS_FRAME_ITEM->number.value == 0) {
-				indigo_result result;
-				indigo_delete_frame_digest(&DEVICE_PRIVATE_DATA->reference);
-				result = indigo_selection_frame_digest(header->signature, (void*)header + sizeof(indigo_raw_header), &AGENT_IMAGER_SELECTION_X_ITEM->number.value, &AGENT_IMAGER_SELECTION_Y_ITEM->number.value, SELECTION_RADIUS, header->width, header->height, &DEVICE_PRIVATE_DATA->reference);
-				if (result == INDIGO_OK)
-					indigo_update_property(device, AGENT_IMAGER_SELECTION_PROPERTY, NULL);
+	return header;
+}
+
+static bool evaluate_raw_frame(indigo_device *device, indigo_raw_header *header) {
+	// field statistics are valid even if selected star is lost
+	double fwhm;
+	int star_count;
+	indigo_field_psf(header->signature, (void*)header + sizeof(indigo_raw_header), header->width, header->height, &AGENT_IMAGER_STATS_MEDIAN_HFD_ITEM->number.value, &fwhm, &star_count);
+	AGENT_IMAGER_STATS_STAR_COUNT_ITEM->number.value = star_count;
+	if (AGENT_IMAGER_SELECTION_X_ITEM->number.value > 0 && AGENT_IMAGER_SELECTION_Y_ITEM->number.value > 0) {
+		if (AGENT_IMAGER_STATS_FRAME_ITEM->number.value == 0) {
+			indigo_result result;
+			indigo_delete_frame_digest(&DEVICE_PRIVATE_DATA->reference);
+			result = indigo_selection_frame_digest(header->signature, (void*)header + sizeof(indigo_raw_header), &AGENT_IMAGER_SELECTION_X_ITEM->number.value, &AGENT_IMAGER_SELECTION_Y_ITEM->number.value, SELECTION_RADIUS, header->width, header->height, &DEVICE_PRIVATE_DATA->reference);
+			if (result == INDIGO_OK)
+				indigo_update_property(device, AGENT_IMAGER_SELECTION_PROPERTY, NULL);
+			if (result == INDIGO_OK) {
+				AGENT_IMAGER_STATS_FRAME_ITEM->number.value++;
+			} else {
+				return false;
+			}
+		} else {
+			indigo_frame_digest digest;
+			indigo_result result;
+			result = indigo_selection_frame_digest(header->signature, (void*)header + sizeof(indigo_raw_header), &AGENT_IMAGER_SELECTION_X_ITEM->number.value, &AGENT_IMAGER_SELECTION_Y_ITEM->number.value, SELECTION_RADIUS, header->width, header->height, &digest);
+			if (result == INDIGO_OK)
+				indigo_update_property(device, AGENT_IMAGER_SELECTION_PROPERTY, NULL);
+			if (result == INDIGO_OK) {
+				result = indigo_calculate_drift(&DEVICE_PRIVATE_DATA->reference, &digest, &DEVICE_PRIVATE_DATA->drift_x, &DEVICE_PRIVATE_DATA->drift_y);
 				if (result == INDIGO_OK) {
 					AGENT_IMAGER_STATS_FRAME_ITEM->number.value++;
-				} else {
-					return false;
+					AGENT_IMAGER_STATS_DRIFT_X_ITEM->number.value = round(1000 * DEVICE_PRIVATE_DATA->drift_x) / 1000;
+					AGENT_IMAGER_STATS_DRIFT_Y_ITEM->number.value = round(1000 * DEVICE_PRIVATE_DATA->drift_y) / 1000;
+					INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Drift %.4gpx, %.4gpx", DEVICE_PRIVATE_DATA->drift_x, DEVICE_PRIVATE_DATA->drift_y);
 				}
 			} else {
-				indigo_frame_digest digest;
-				indigo_result result;
-				result = indigo_selection_frame_digest(header->signature, (void*)header + sizeof(indigo_raw_header), &AGENT_IMAGER_SELECTION_X_ITEM->number.value, &AGENT_IMAGER_SELECTION_Y_ITEM->number.value, SELECTION_RADIUS, header->width, header->height, &digest);
-				if (result == INDIGO_OK)
-					indigo_update_property(device, AGENT_IMAGER_SELECTION_PROPERTY, NULL);
-				if (result == INDIGO_OK) {
-					result = indigo_calculate_drift(&DEVICE_PRIVATE_DATA->reference, &digest, &DEVICE_PRIVATE_DATA->drift_x, &DEVICE_PRIVATE_DATA->drift_y);
-					if (result == INDIGO_OK) {
-						AGENT_IMAGER_STATS_FRAME_ITEM->number.value++;
-						AGENT_IMAGER_STATS_DRIFT_X_ITEM->number.value = round(1000 * DEVICE_PRIVATE_DATA->drift_x) / 1000;
-						AGENT_IMAGER_STATS_DRIFT_Y_ITEM->number.value = round(1000 * DEVICE_PRIVATE_DATA->drift_y) / 1000;
-						INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Drift %.4gpx, %.4gpx", DEVICE_PRIVATE_DATA->drift_x, DEVICE_PRIVATE_DATA->drift_y);
-					}
-				} else {
-					return false;
-				}
-				indigo_delete_frame_digest(&digest);
+				return false;
 			}
-			indigo_selection_psf(header->signature, (void*)header + sizeof(indigo_raw_header), AGENT_IMAGER_SELECTION_X_ITEM->number.value, AGENT_IMAGER_SELECTION_Y_ITEM->number.value, 4, header->width, header->height, &AGENT_IMAGER_STATS_FWHM_ITEM->number.value, &AGENT_IMAGER_STATS_HFD_ITEM->number.value, &AGENT_IMAGER_STATS_PEAK_ITEM->number.value);
-		} else {
-			indigo_send_message(device, "Invalid image format, only RAW is supported");
-			return false;
+			indigo_delete_frame_digest(&digest);
 		}
+		indigo_selection_psf(header->signature, (void*)header + sizeof(indigo_raw_header), AGENT_IMAGER_SELECTION_X_ITEM->number.value, AGENT_IMAGER_SELECTION_Y_ITEM->number.value, 4, header->width, header->height, &AGENT_IMAGER_STATS_FWHM_ITEM->number.value, &AGENT_IMAGER_STATS_HFD_ITEM->number.value, &AGENT_IMAGER_STATS_PEAK_ITEM->number.value);
 	}
 	return true;
 }
 
+static bool capture_raw_frame(indigo_device *device) {
+	indigo_raw_header *header = expose_raw_frame(device);
+	return header != NULL && evaluate_raw_frame(device, header);
+}
+
 static bool exposure_batch(indigo_device *device) {
 	AGENT_IMAGER_STATS_EXPOSURE_ITEM->number.value = 0;
 	AGENT_IMAGER_STATS_DELAY_ITEM->number.value = 0;
@@ -530,6 +555,135 @@ static void streaming_batch_process(indigo_device *device) {
 	}
 }
 
+static bool wait_for_focuser(indigo_device *device, indigo_property *remote_steps_property) {
+	while (remote_steps_property->state == INDIGO_BUSY_STATE)
+		indigo_usleep(200000);
+	while (AGENT_PAUSE_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+		indigo_usleep(200000);
+	if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+		return false;
+	if (remote_steps_property->state != INDIGO_OK_STATE) {
+		INDIGO_DRIVER_ERROR(DRIVER_NAME, "FOCUSER_STEPS_PROPERTY didn't become OK");
+		return false;
+	}
+	return true;
+}
+
+static bool move_focuser(indigo_device *device, indigo_property *remote_steps_property, indigo_property *remote_direction_property, bool moving_out, double steps, bool wait) {
+	if (steps < 1)
+		return true;
+	indigo_change_switch_property_1(FILTER_DEVICE_CONTEXT->client, remote_direction_property->device, remote_direction_property->name, moving_out ? FOCUSER_DIRECTION_MOVE_OUTWARD_ITEM_NAME : FOCUSER_DIRECTION_MOVE_INWARD_ITEM_NAME, true);
+	indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, remote_steps_property->device, remote_steps_property->name, FOCUSER_STEPS_ITEM_NAME, steps);
+	for (int i = 0; i < 1000 && remote_steps_property->state != INDIGO_BUSY_STATE && AGENT_ABORT_PROCESS_PROPERTY->state != INDIGO_BUSY_STATE; i++)
+		indigo_usleep(1000);
+	if (AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+		return false;
+	if (remote_steps_property->state != INDIGO_BUSY_STATE) {
+		INDIGO_DRIVER_ERROR(DRIVER_NAME, "FOCUSER_STEPS_PROPERTY didn't become busy in 1 second");
+		return false;
+	}
+	return !wait || wait_for_focuser(device, remote_steps_property);
+}
+
+// HFD of a defocused star follows a hyperbola, HFD^2 = a^2 + (a/b)^2 * (x - c)^2, so weighted least squares parabola fitted to HFD^2 gives the focus position c directly
+
+static bool fit_focus_curve(double *position, double *hfd, int count, double *focus) {
+	double mean = 0, scale = 0, min_y = hfd[0] * hfd[0];
+	for (int i = 0; i < count; i++) {
+		mean += position[i];
+		if (hfd[i] * hfd[i] < min_y)
+			min_y = hfd[i] * hfd[i];
+	}
+	mean /= count;
+	for (int i = 0; i < count; i++)
+		scale = MAX(scale, fabs(position[i] - mean));
+	if (scale == 0)
+		return false;
+	// normal equations for y = p0 + p1 * u + p2 * u^2, relative error of HFD is roughly constant, so weight is 1 / HFD^4 (normalized to 1 at the minimum)
+	double s[5] = { 0 }, t[3] = { 0 };
+	for (int i = 0; i < count; i++) {
+		double u = (position[i] - mean) / scale, y = hfd[i] * hfd[i], w = (min_y / y) * (min_y / y), uk = w;
+		for (int k = 0; k < 5; k++) {
+			s[k] += uk;
+			if (k < 3)
+				t[k] += uk * y;
+			uk *= u;
+		}
+	}
+	double det = s[0] * (s[2] * s[4] - s[3] * s[3]) - s[1] * (s[1] * s[4] - s[2] * s[3]) + s[2] * (s[1] * s[3] - s[2] * s[2]);
+	if (fabs(det) < 1e-9 * s[0] * s[0] * s[0])
+		return false;
+	double p1 = (s[0] * (t[1] * s[4] - s[3] * t[2]) - t[0] * (s[1] * s[4] - s[2] * s[3]) + s[2] * (s[1] * t[2] - t[1] * s[2])) / det;
+	double p2 = (s[0] * (s[2] * t[2] - t[1] * s[3]) - s[1] * (s[1] * t[2] - t[1] * s[2]) + t[0] * (s[1] * s[3] - s[2] * s[2])) / det;
+	double p0 = (t[0] - s[1] * p1 - s[2] * p2) / s[0];
+	if (p2 <= 0)
+		return false;
+	double u0 = -p1 / (2 * p2);
+	// vertex must be inside of sampled range and minimal HFD must be real
+	if (u0 < -1 || u0 > 1 || p0 - p2 * u0 * u0 <= 0)
+		return false;
+	*focus = mean + u0 * scale;
+	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Curve fit focus = %g, minimal HFD = %g", *focus, sqrt(p0 - p2 * u0 * u0));
+	return true;
+}
+
+static bool curve_autofocus(indigo_device *device, indigo_property *remote_steps_property, indigo_property *remote_direction_property, bool *fitted) {
+	double position[FOCUS_MAX_POINTS], hfd[FOCUS_MAX_POINTS];
+	int count = (int)AGENT_IMAGER_FOCUS_POINTS_ITEM->number.value, valid = 0, best = -1;
+	double step = MAX(AGENT_IMAGER_FOCUS_INITIAL_ITEM->number.value, 1);
+	double backlash = AGENT_IMAGER_FOCUS_BACKLASH_ITEM->number.value;
+	// offset is relative to starting position, all samples are approached moving out, so backlash is taken up only once
+	double offset = -((count - 1) / 2) * step;
+	*fitted = false;
+	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Moving in %d steps to first sample", (int)(backlash - offset));
+	if (!move_focuser(device, remote_steps_property, remote_direction_property, false, backlash - offset, true))
+		return false;
+	if (!move_focuser(device, remote_steps_property, remote_direction_property, true, backlash, true))
+		return false;
+	for (int i = 0; i < count; i++) {
+		indigo_raw_header *header = expose_raw_frame(device);
+		if (header == NULL)
+			return false;
+		// frame is evaluated while focuser moves to the next sample
+		bool moving = i < count - 1;
+		if (moving && !move_focuser(device, remote_steps_property, remote_direction_property, true, step, false))
+			return false;
+		// selected star profile is capped by its small radius and flattens the curve, so median HFD of the field is used even if selection is set
+		evaluate_raw_frame(device, header);
+		indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
+		double value = AGENT_IMAGER_STATS_MEDIAN_HFD_ITEM->number.value;
+		INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Sample %d at %d: HFD = %g, stars = %d", i, (int)offset, value, (int)AGENT_IMAGER_STATS_STAR_COUNT_ITEM->number.value);
+		if (value > 0 && AGENT_IMAGER_STATS_STAR_COUNT_ITEM->number.value > 0) {
+			position[valid] = offset;
+			hfd[valid] = value;
+			if (best < 0 || value < hfd[best])
+				best = valid;
+			valid++;
+		}
+		if (moving) {
+			if (!wait_for_focuser(device, remote_steps_property))
+				return false;
+			offset += step;
+		}
+	}
+	double target = 0;
+	// minimum at the first or the last sample means focus was not bracketed
+	if (valid >= FOCUS_MIN_FIT && best > 0 && best < valid - 1 && fit_focus_curve(position, hfd, valid, &target)) {
+		*fitted = true;
+	} else if (best >= 0) {
+		target = position[best];
+	}
+	target = round(target);
+	if (target < offset) {
+		INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Moving in %d steps to final position", (int)(offset - target + backlash));
+		if (!move_focuser(device, remote_steps_property, remote_direction_property, false, offset - target + backlash, true))
+			return false;
+		return move_focuser(device, remote_steps_property, remote_direction_property, true, backlash, true);
+	}
+	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Moving out %d steps to final position", (int)(target - offset));
+	return move_focuser(device, remote_steps_property, remote_direction_property, true, target - offset, true);
+}
+
 static bool autofocus(indigo_device *device) {
 	AGENT_IMAGER_STATS_EXPOSURE_ITEM->number.value = 0;
 	AGENT_IMAGER_STATS_DELAY_ITEM->number.value = 0;
@@ -540,6 +694,8 @@ static bool autofocus(indigo_device *device) {
 	double steps = AGENT_IMAGER_FOCUS_INITIAL_ITEM->number.value;
 	double steps_with_backlash = steps + AGENT_IMAGER_FOCUS_BACKLASH_ITEM->number.value;
 	bool moving_out = true, first_move = true;
+	// quality is based on selected star profile if selection is set, otherwise on median HFD of all stars in the frame
+	bool use_selection = AGENT_IMAGER_SELECTION_X_ITEM->number.value > 0 && AGENT_IMAGER_SELECTION_Y_ITEM->number.value > 0;
 	indigo_property *remote_upload_mode_property = indigo_filter_cached_property(device, INDIGO_FILTER_CCD_INDEX, CCD_UPLOAD_MODE_PROPERTY_NAME);
 	if (remote_upload_mode_property == NULL) {
 		INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_UPLOAD_MODE_PROPERTY_NAME not found");
@@ -556,6 +712,15 @@ static bool autofocus(indigo_device *device) {
 		return false;
 	}
 	indigo_change_switch_property_1(FILTER_DEVICE_CONTEXT->client, remote_upload_mode_property->device, remote_upload_mode_property->name, CCD_UPLOAD_MODE_CLIENT_ITEM_NAME, true);
+	if (AGENT_IMAGER_FOCUS_CURVE_ITEM->sw.value) {
+		bool fitted;
+		if (!curve_autofocus(device, remote_steps_property, remote_direction_property, &fitted))
+			return false;
+		if (fitted)
+			return capture_raw_frame(device);
+		// focuser is at the best sample now, refine it iteratively
+		indigo_send_message(device, "Failed to fit focus curve, switching to iterative mode");
+	}
 	indigo_change_switch_property_1(FILTER_DEVICE_CONTEXT->client, remote_direction_property->device, remote_direction_property->name, FOCUSER_DIRECTION_MOVE_OUTWARD_ITEM_NAME, true);
 	while (true) {
 		double quality = 0;
@@ -564,11 +729,21 @@ static bool autofocus(indigo_device *device) {
 			if (!capture_raw_frame(device))
 				return false;
 			indigo_update_property(device, AGENT_IMAGER_STATS_PROPERTY, NULL);
-			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Peak = %g, HFD = %g,  FWHM = %g", AGENT_IMAGER_STATS_PEAK_ITEM->number.value, AGENT_IMAGER_STATS_HFD_ITEM->number.value, AGENT_IMAGER_STATS_FWHM_ITEM->number.value);
-			if (AGENT_IMAGER_STATS_HFD_ITEM->number.value == 0 || AGENT_IMAGER_STATS_FWHM_ITEM->number.value == 0)
-				continue;
-			quality += AGENT_IMAGER_STATS_PEAK_ITEM->number.value / AGENT_IMAGER_STATS_FWHM_ITEM->number.value / AGENT_IMAGER_STATS_HFD_ITEM->number.value;
-			frame_count++;
+			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Peak = %g, HFD = %g,  FWHM = %g, median HFD = %g, stars = %d", AGENT_IMAGER_STATS_PEAK_ITEM->number.value, AGENT_IMAGER_STATS_HFD_ITEM->number.value, AGENT_IMAGER_STATS_FWHM_ITEM->number.value, AGENT_IMAGER_STATS_MEDIAN_HFD_ITEM->number.value, (int)AGENT_IMAGER_STATS_STAR_COUNT_ITEM->number.value);
+			if (use_selection) {
+				if (AGENT_IMAGER_STATS_HFD_ITEM->number.value == 0 || AGENT_IMAGER_STATS_FWHM_ITEM->number.value == 0)
+					continue;
+				quality += AGENT_IMAGER_STATS_PEAK_ITEM->number.value / AGENT_IMAGER_STATS_FWHM_ITEM->number.value / AGENT_IMAGER_STATS_HFD_ITEM->number.value;
+				frame_count++;
+			} else {
+				if (AGENT_IMAGER_STATS_STAR_COUNT_ITEM->number.value == 0 || AGENT_IMAGER_STATS_MEDIAN_HFD_ITEM->number.value == 0)
+					continue;
+				quality += 1 / AGENT_IMAGER_STATS_MEDIAN_HFD_ITEM->number.value;
+				frame_count++;
+				// median of enough stars is stable, no need to stack more frames
+				if (AGENT_IMAGER_STATS_STAR_COUNT_ITEM->number.value >= FOCUS_MIN_STARS)
+					break;
+			}
 		}
 		if (quality == 0) {
 			indigo_send_message(device, "Failed to evaluate quality");
@@ -934,13 +1109,19 @@ static indigo_result agent_device_attach(indigo_device *device) {
 		indigo_init_number_item(AGENT_IMAGER_BATCH_EXPOSURE_ITEM, AGENT_IMAGER_BATCH_EXPOSURE_ITEM_NAME, "Exposure time", 0, 0xFFFF, 0, 1);
 		indigo_init_number_item(AGENT_IMAGER_BATCH_DELAY_ITEM, AGENT_IMAGER_BATCH_DELAY_ITEM_NAME, "Delay after each exposure", 0, 0xFFFF, 0, 0);
 		// -------------------------------------------------------------------------------- Focus properties
-		AGENT_IMAGER_FOCUS_PROPERTY = indigo_init_number_property(NULL, device->name, AGENT_IMAGER_FOCUS_PROPERTY_NAME, "Agent", "Autofocus settings", INDIGO_OK_STATE, INDIGO_RW_PERM, 4);
+		AGENT_IMAGER_FOCUS_PROPERTY = indigo_init_number_property(NULL, device->name, AGENT_IMAGER_FOCUS_PROPERTY_NAME, "Agent", "Autofocus settings", INDIGO_OK_STATE, INDIGO_RW_PERM, 5);
 		if (AGENT_IMAGER_FOCUS_PROPERTY == NULL)
 			return INDIGO_FAILED;
 		indigo_init_number_item(AGENT_IMAGER_FOCUS_INITIAL_ITEM, AGENT_IMAGER_FOCUS_INITIAL_ITEM_NAME, "Initial step", 0, 0xFFFF, 1, 20);
 		indigo_init_number_item(AGENT_IMAGER_FOCUS_FINAL_ITEM, AGENT_IMAGER_FOCUS_FINAL_ITEM_NAME, "Final step", 0, 0xFFFF, 1, 5);
 		indigo_init_number_item(AGENT_IMAGER_FOCUS_BACKLASH_ITEM, AGENT_IMAGER_FOCUS_BACKLASH_ITEM_NAME, "Backlash", 0, 0xFFFF, 1, 0);
 		indigo_init_number_item(AGENT_IMAGER_FOCUS_STACK_ITEM, AGENT_IMAGER_FOCUS_STACK_ITEM_NAME, "Stacking", 1, 5, 1, 3);
+		indigo_init_number_item(AGENT_IMAGER_FOCUS_POINTS_ITEM, AGENT_IMAGER_FOCUS_POINTS_ITEM_NAME, "Curve points", 5, FOCUS_MAX_POINTS, 1, 7);
+		AGENT_IMAGER_FOCUS_MODE_PROPERTY = indigo_init_switch_property(NULL, device->name, AGENT_IMAGER_FOCUS_MODE_PROPERTY_NAME, "Agent", "Autofocus mode", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 2);
+		if (AGENT_IMAGER_FOCUS_MODE_PROPERTY == NULL)
+			return INDIGO_FAILED;
+		indigo_init_switch_item(AGENT_IMAGER_FOCUS_ITERATIVE_ITEM, AGENT_IMAGER_FOCUS_ITERATIVE_ITEM_NAME, "Iterative mode", true);
+		indigo_init_switch_item(AGENT_IMAGER_FOCUS_CURVE_ITEM, AGENT_IMAGER_FOCUS_CURVE_ITEM_NAME, "Curve fitting mode", false);
 		// -------------------------------------------------------------------------------- Dithering properties
 		AGENT_IMAGER_DITHERING_PROPERTY = indigo_init_number_property(NULL, device->name, AGENT_IMAGER_DITHERING_PROPERTY_NAME, "Agent", "Dithering settings", INDIGO_OK_STATE, INDIGO_RW_PERM, 2);
 		if (AGENT_IMAGER_DITHERING_PROPERTY == NULL)
@@ -1006,7 +1187,7 @@ static indigo_result agent_device_attach(indigo_device *device) {
 		indigo_init_number_item(AGENT_IMAGER_SELECTION_X_ITEM, AGENT_IMAGER_SELECTION_X_ITEM_NAME, "Selection X (px)", 0, 0xFFFF, 0, 0);
 		indigo_init_number_item(AGENT_IMAGER_SELECTION_Y_ITEM, AGENT_IMAGER_SELECTION_Y_ITEM_NAME, "Selection Y (px)", 0, 0xFFFF, 0, 0);
 		// -------------------------------------------------------------------------------- Focusing stats
-		AGENT_IMAGER_STATS_PROPERTY = indigo_init_number_property(NULL, device->name, AGENT_IMAGER_STATS_PROPERTY_NAME, "Agent", "Stats", INDIGO_OK_STATE, INDIGO_RO_PERM, 11);
+		AGENT_IMAGER_STATS_PROPERTY = indigo_init_number_property(NULL, device->name, AGENT_IMAGER_STATS_PROPERTY_NAME, "Agent", "Stats", INDIGO_OK_STATE, INDIGO_RO_PERM, 13);
 		if (AGENT_IMAGER_STATS_PROPERTY == NULL)
 			return INDIGO_FAILED;
 		indigo_init_number_item(AGENT_IMAGER_STATS_EXPOSURE_ITEM, AGENT_IMAGER_STATS_EXPOSURE_ITEM_NAME, "Elapsed exposure", 0, 3600, 0, 0);
@@ -1020,6 +1201,8 @@ static indigo_result agent_device_attach(indigo_device *device) {
 		indigo_init_number_item(AGENT_IMAGER_STATS_FWHM_ITEM, AGENT_IMAGER_STATS_FWHM_ITEM_NAME, "FWHM", 0, 0xFFFF, 0, 0);
 		indigo_init_number_item(AGENT_IMAGER_STATS_HFD_ITEM, AGENT_IMAGER_STATS_HFD_ITEM_NAME, "HFD", 0, 0xFFFF, 0, 0);
 		indigo_init_number_item(AGENT_IMAGER_STATS_PEAK_ITEM, AGENT_IMAGER_STATS_PEAK_ITEM_NAME, "Peak", 0, 0xFFFF, 0, 0);
+		indigo_init_number_item(AGENT_IMAGER_STATS_MEDIAN_HFD_ITEM, AGENT_IMAGER_STATS_MEDIAN_HFD_ITEM_NAME, "Median HFD", 0, 0xFFFF, 0, 0);
+		indigo_init_number_item(AGENT_IMAGER_STATS_STAR_COUNT_ITEM, AGENT_IMAGER_STATS_STAR_COUNT_ITEM_NAME, "Star count", 0, 0xFFFF, 0, 0);
 		// -------------------------------------------------------------------------------- Sequencer
 		AGENT_IMAGER_SEQUENCE_PROPERTY = indigo_init_text_property(NULL, device->name, AGENT_IMAGER_SEQUENCE_PROPERTY_NAME, "Agent", "Sequence", INDIGO_OK_STATE, INDIGO_RW_PERM, 1 + SEQUENCE_SIZE);
 		if (AGENT_IMAGER_SEQUENCE_PROPERTY == NULL)
@@ -1048,6 +1231,8 @@ static indigo_result agent_enumerate_properties(indigo_device *device, indigo_cl
 		indigo_define_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
 	if (indigo_property_match(AGENT_IMAGER_FOCUS_PROPERTY, property))
 		indigo_define_property(device, AGENT_IMAGER_FOCUS_PROPERTY, NULL);
+	if (indigo_property_match(AGENT_IMAGER_FOCUS_MODE_PROPERTY, property))
+		indigo_define_property(device, AGENT_IMAGER_FOCUS_MODE_PROPERTY, NULL);
 	if (indigo_property_match(AGENT_IMAGER_DITHERING_PROPERTY, property))
 		indigo_define_property(device, AGENT_IMAGER_DITHERING_PROPERTY, NULL);
 	if (indigo_property_match(AGENT_IMAGER_DOWNLOAD_IMAGE_PROPERTY, property))
@@ -1093,6 +1278,13 @@ static indigo_result agent_change_property(indigo_device *device, indigo_client
 		save_config(device);
 		indigo_update_property(device, AGENT_IMAGER_FOCUS_PROPERTY, NULL);
 		return INDIGO_OK;
+	} else if (indigo_property_match(AGENT_IMAGER_FOCUS_MODE_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- AGENT_IMAGER_FOCUS_MODE
+		indigo_property_copy_values(AGENT_IMAGER_FOCUS_MODE_PROPERTY, property, false);
+		AGENT_IMAGER_FOCUS_MODE_PROPERTY->state = INDIGO_OK_STATE;
+		save_config(device);
+		indigo_update_property(device, AGENT_IMAGER_FOCUS_MODE_PROPERTY, NULL);
+		return INDIGO_OK;
 	} else if (indigo_property_match(AGENT_IMAGER_DITHERING_PROPERTY, property)) {
 			// -------------------------------------------------------------------------------- AGENT_DITHERING
 		indigo_property_copy_values(AGENT_IMAGER_DITHERING_PROPERTY, property, false);
@@ -1286,6 +1478,7 @@ static indigo_result agent_device_detach(indigo_device *device) {
 	assert(device != NULL);
 	indigo_release_property(AGENT_IMAGER_BATCH_PROPERTY);
 	indigo_release_property(AGENT_IMAGER_FOCUS_PROPERTY);
+	indigo_release_property(AGENT_IMAGER_FOCUS_MODE_PROPERTY);
 	indigo_release_property(AGENT_IMAGER_DITHERING_PROPERTY);
 	indigo_release_property(AGENT_IMAGER_DOWNLOAD_IMAGE_PROPERTY);
 	indigo_release_property(AGENT_IMAGER_DOWNLOAD_FILE_PROPERTY);
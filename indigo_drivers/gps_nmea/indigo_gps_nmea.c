@@ -111,9 +111,10 @@ static void gps_refresh_callback(indigo_device *device) {
 	char buffer[128];
 	char **tokens;
 	INDIGO_DRIVER_LOG(DRIVER_NAME, "NMEA reader started");
+	indigo_reader *reader = indigo_create_reader(PRIVATE_DATA->handle);
 	while (IS_CONNECTED && PRIVATE_DATA->handle > 0) {
 		//pthread_mutex_lock(&PRIVATE_DATA->serial_mutex);
-		if (indigo_read_line(PRIVATE_DATA->handle, buffer, sizeof(buffer)) > 0 && (tokens = parse(buffer))) {
+		if (indigo_reader_read_line(reader, buffer, sizeof(buffer)) > 0 && (tokens = parse(buffer))) {
 			if (!strcmp(tokens[0], "RMC")) { // Recommended Minimum sentence C
 				int time = atoi(tokens[1]);
 				int date = atoi(tokens[9]);
@@ -233,6 +234,7 @@ static void gps_refresh_callback(indigo_device *device) {
 		}
 		//pthread_mutex_unlock(&PRIVATE_DATA->serial_mutex);
 	}
+	indigo_release_reader(reader);
 	INDIGO_DRIVER_LOG(DRIVER_NAME, "NMEA reader finished");
 }
 
@@ -78,6 +78,7 @@
 typedef struct {
 	bool parked;
 	int handle;
+	indigo_reader *reader;
 	int device_count;
 	indigo_timer *position_timer;
 	pthread_mutex_t port_mutex;
@@ -102,6 +103,7 @@ static bool meade_open(indigo_device *device) {
 		PRIVATE_DATA->handle = indigo_open_network_device(name, 4030, &proto);
 	}
 	if (PRIVATE_DATA->handle >= 0) {
+		PRIVATE_DATA->reader = indigo_create_reader(PRIVATE_DATA->handle);
 		INDIGO_DRIVER_LOG(DRIVER_NAME, "Connected to %s", name);
 		return true;
 	} else {
@@ -112,27 +114,10 @@ static bool meade_open(indigo_device *device) {
 
 static bool meade_command(indigo_device *device, char *command, char *response, int max, int sleep) {
 	pthread_mutex_lock(&PRIVATE_DATA->port_mutex);
-	char c;
-	struct timeval tv;
 	// flush
-	while (true) {
-		fd_set readout;
-		FD_ZERO(&readout);
-		FD_SET(PRIVATE_DATA->handle, &readout);
-		tv.tv_sec = 0;
-		tv.tv_usec = 100000;
-		long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-		if (result == 0)
-			break;
-		if (result < 0) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
-		result = read(PRIVATE_DATA->handle, &c, 1);
-		if (result < 1) {
-			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-			return false;
-		}
+	if (PRIVATE_DATA->reader == NULL || !indigo_reader_discard(PRIVATE_DATA->reader, 100000)) {
+		pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+		return false;
 	}
 	// write command
 	indigo_write(PRIVATE_DATA->handle, command, strlen(command));
@@ -140,31 +125,16 @@ static bool meade_command(indigo_device *device, char *command, char *response,
 		indigo_usleep(sleep);
 	// read response
 	if (response != NULL) {
-		int index = 0;
-		int timeout = 3;
-		while (index < max) {
-			fd_set readout;
-			FD_ZERO(&readout);
-			FD_SET(PRIVATE_DATA->handle, &readout);
-			tv.tv_sec = timeout;
-			tv.tv_usec = 100000;
-			timeout = 0;
-			long result = select(PRIVATE_DATA->handle+1, &readout, NULL, NULL, &tv);
-			if (result <= 0)
-				break;
-			result = read(PRIVATE_DATA->handle, &c, 1);
-			if (result < 1) {
-				INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to read from %s -> %s (%d)", DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
-				pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
-				return false;
-			}
-			if (c < 0)
-				c = ':';
-			if (c == '#')
-				break;
-			response[index++] = c;
+		// max is the number of characters to read, response buffer has room for terminating zero
+		if (indigo_reader_read_until(PRIVATE_DATA->reader, response, max + 1, '#', 3100000, 100000) < 0) {
+			INDIGO_DRIVER_ERROR(DRIVER_NAME, "Failed to read from %s -> %s (%d)", DEVICE_PORT_ITEM->text.value, strerror(errno), errno);
+			pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
+			return false;
+		}
+		for (char *c = response; *c; c++) {
+			if (*c < 0)
+				*c = ':';
 		}
-		response[index] = 0;
 	}
 	pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
 	INDIGO_DRIVER_DEBUG(DRIVER_NAME, "Command %s -> %s", command, response != NULL ? response : "NULL");
@@ -184,40 +154,44 @@ static bool meade_command(indigo_device *device, char *command, char *response,
 
 static void meade_close(indigo_device *device) {
 	if (PRIVATE_DATA->handle > 0) {
+		pthread_mutex_lock(&PRIVATE_DATA->port_mutex);
+		indigo_release_reader(PRIVATE_DATA->reader);
+		PRIVATE_DATA->reader = NULL;
 		close(PRIVATE_DATA->handle);
 		PRIVATE_DATA->handle = 0;
+		pthread_mutex_unlock(&PRIVATE_DATA->port_mutex);
 		INDIGO_DRIVER_LOG(DRIVER_NAME, "Disconnected from %s", DEVICE_PORT_ITEM->text.value);
 	}
 }
 
 static void meade_get_coords(indigo_device *device) {
 	char response[128];
-	if (meade_command(device, ":GR#", response, sizeof(response), 0)) {
+	if (meade_command(device, ":GR#", response, sizeof(response) - 1, 0)) {
 		if (strlen(response) < 8) {
 			if (MOUNT_TYPE_MEADE_ITEM->sw.value) {
-				meade_command(device, ":P#", response, sizeof(response), 0);
-				meade_command(device, ":GR#", response, sizeof(response), 0);
+				meade_command(device, ":P#", response, sizeof(response) - 1, 0);
+				meade_command(device, ":GR#", response, sizeof(response) - 1, 0);
 			} else if (MOUNT_TYPE_10MICRONS_ITEM->sw.value) {
 				meade_command(device, ":U1#", NULL, 0, 0);
-				meade_command(device, ":GR#", response, sizeof(response), 0);
+				meade_command(device, ":GR#", response, sizeof(response) - 1, 0);
 			} else if (MOUNT_TYPE_GEMINI_ITEM->sw.value || MOUNT_TYPE_AP_ITEM->sw.value || MOUNT_TYPE_ON_STEP_ITEM->sw.value) {
 				meade_command(device, ":U#", NULL, 0, 0);
-				meade_command(device, ":GR#", response, sizeof(response), 0);
+				meade_command(device, ":GR#", response, sizeof(response) - 1, 0);
 			}
 		}
 		MOUNT_EQUATORIAL_COORDINATES_RA_ITEM->number.value = indigo_stod(response);
 	}
-	if (meade_command(device, ":GD#", response, sizeof(response), 0)) {
+	if (meade_command(device, ":GD#", response, sizeof(response) - 1, 0)) {
 		MOUNT_EQUATORIAL_COORDINATES_DEC_ITEM->number.value = indigo_stod(response);
 	}
 	if (MOUNT_TYPE_MEADE_ITEM->sw.value || MOUNT_TYPE_10MICRONS_ITEM->sw.value || MOUNT_TYPE_ON_STEP_ITEM->sw.value) {
-		if (meade_command(device, ":D#", response, sizeof(response), 0))
+		if (meade_command(device, ":D#", response, sizeof(response) - 1, 0))
 			MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = *response ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
 	} else if (MOUNT_TYPE_GEMINI_ITEM->sw.value) {
-		if (meade_command(device, ":Gv#", response, sizeof(response), 0))
+		if (meade_command(device, ":Gv#", response, sizeof(response) - 1, 0))
 			MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = (*response == 'S' || *response == 'C') ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
 	} else if (MOUNT_TYPE_AVALON_ITEM->sw.value) {
-		if (meade_command(device, ":X34#", response, sizeof(response), 0))
+		if (meade_command(device, ":X34#", response, sizeof(response) - 1, 0))
 			MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = (response[1] == '5' || response[2] == '5') ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
 	} else {
 		if (fabs(MOUNT_EQUATORIAL_COORDINATES_RA_ITEM->number.value - MOUNT_EQUATORIAL_COORDINATES_RA_ITEM->number.target) < 1.0/3600.0 && fabs(MOUNT_EQUATORIAL_COORDINATES_DEC_ITEM->number.value - MOUNT_EQUATORIAL_COORDINATES_DEC_ITEM->number.target) < 1.0/3600.0)
@@ -234,11 +208,11 @@ static void meade_get_utc(indigo_device *device) {
 		memset(&tm, 0, sizeof(tm));
 		MOUNT_UTC_TIME_PROPERTY->state = INDIGO_ALERT_STATE;
 		char separator[2];
-		if (meade_command(device, ":GC#", response, sizeof(response), 0) && sscanf(response, "%d%c%d%c%d", &tm.tm_mon, separator, &tm.tm_mday, separator, &tm.tm_year) == 5) {
-			if (meade_command(device, ":GL#", response, sizeof(response), 0) && sscanf(response, "%d%c%d%c%d", &tm.tm_hour, separator, &tm.tm_min, separator, &tm.tm_sec) == 5) {
+		if (meade_command(device, ":GC#", response, sizeof(response) - 1, 0) && sscanf(response, "%d%c%d%c%d", &tm.tm_mon, separator, &tm.tm_mday, separator, &tm.tm_year) == 5) {
+			if (meade_command(device, ":GL#", response, sizeof(response) - 1, 0) && sscanf(response, "%d%c%d%c%d", &tm.tm_hour, separator, &tm.tm_min, separator, &tm.tm_sec) == 5) {
 				tm.tm_year += 100; // TODO: To be fixed in year 2100 :)
 				tm.tm_mon -= 1;
-				if (meade_command(device, ":GG#", response, sizeof(response), 0)) {
+				if (meade_command(device, ":GG#", response, sizeof(response) - 1, 0)) {
 					if (MOUNT_TYPE_AP_ITEM->sw.value && response[0] == ':') {
 						if (response[1] == 'A') {
 							switch (response[2]) {
@@ -286,7 +260,7 @@ static void meade_get_utc(indigo_device *device) {
 					tm.tm_gmtoff = -atoi(response) * 3600;
 					sprintf(MOUNT_UTC_OFFSET_ITEM->text.value, "%d", -atoi(response));
 					if (PRIVATE_DATA->use_dst_commands) {
-						if (meade_command(device, ":GH#", response, sizeof(response), 0)) {
+						if (meade_command(device, ":GH#", response, sizeof(response) - 1, 0)) {
 							tm.tm_isdst = atoi(response);
 						}
 					} else {
@@ -303,10 +277,10 @@ static void meade_get_utc(indigo_device *device) {
 
 static void meade_get_observatory(indigo_device *device) {
 	char response[128];
-	if (meade_command(device, ":Gt#", response, sizeof(response), 0)) {
+	if (meade_command(device, ":Gt#", response, sizeof(response) - 1, 0)) {
 		MOUNT_GEOGRAPHIC_COORDINATES_LATITUDE_ITEM->number.target = MOUNT_GEOGRAPHIC_COORDINATES_LATITUDE_ITEM->number.value = indigo_stod(response);
 	}
-	if (meade_command(device, ":Gg#", response, sizeof(response), 0)) {
+	if (meade_command(device, ":Gg#", response, sizeof(response) - 1, 0)) {
 		double longitude = indigo_stod(response);
 		if (longitude < 0)
 			longitude += 360;
@@ -394,7 +368,7 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 			}
 			if (result) {
 				if (MOUNT_TYPE_DETECT_ITEM->sw.value) {
-					if (meade_command(device, ":GVP#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":GVP#", response, sizeof(response) - 1, 0)) {
 						INDIGO_DRIVER_LOG(DRIVER_NAME, "Product:  %s", response);
 						strncpy(PRIVATE_DATA->product, response, 64);
 					}
@@ -423,7 +397,7 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 					MOUNT_GUIDE_RATE_PROPERTY->hidden = true;
 					PRIVATE_DATA->parked = false;
 					strcpy(MOUNT_INFO_VENDOR_ITEM->text.value, "Meade");
-					if (meade_command(device, ":GVF#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":GVF#", response, sizeof(response) - 1, 0)) {
 						INDIGO_DRIVER_LOG(DRIVER_NAME, "Version:  %s", response);
 						char *sep = strchr(response, '|');
 						if (sep != NULL)
@@ -432,11 +406,11 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 					} else {
 						strncpy(MOUNT_INFO_MODEL_ITEM->text.value, PRIVATE_DATA->product, INDIGO_VALUE_SIZE);
 					}
-					if (meade_command(device, ":GVN#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":GVN#", response, sizeof(response) - 1, 0)) {
 						INDIGO_DRIVER_LOG(DRIVER_NAME, "Firmware: %s", response);
 						strncpy(MOUNT_INFO_FIRMWARE_ITEM->text.value, response, INDIGO_VALUE_SIZE);
 					}
-					if (meade_command(device, ":GW#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":GW#", response, sizeof(response) - 1, 0)) {
 						INDIGO_DRIVER_LOG(DRIVER_NAME, "Status:   %s", response);
 						ALIGNMENT_MODE_PROPERTY->hidden = false;
 						if (*response == 'P' || *response == 'G') {
@@ -454,7 +428,7 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 					meade_get_observatory(device);
 					meade_get_coords(device);
 					meade_get_utc(device);
-					if (meade_command(device, ":GH#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":GH#", response, sizeof(response) - 1, 0)) {
 						PRIVATE_DATA->use_dst_commands = *response != 0;
 					}
 				} else if (MOUNT_TYPE_EQMAC_ITEM->sw.value) {
@@ -485,7 +459,7 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 					PRIVATE_DATA->parked = false;
 					indigo_set_switch(MOUNT_TRACKING_PROPERTY, MOUNT_TRACKING_OFF_ITEM, true);
 					indigo_set_switch(MOUNT_PARK_PROPERTY, MOUNT_PARK_UNPARKED_ITEM, true);
-					if (meade_command(device, ":Gstat#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":Gstat#", response, sizeof(response) - 1, 0)) {
 						if (*response == '0') {
 							indigo_set_switch(MOUNT_TRACKING_PROPERTY, MOUNT_TRACKING_ON_ITEM, true);
 						} else if (*response == '5') {
@@ -532,7 +506,7 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 					PRIVATE_DATA->parked = false;
 					indigo_set_switch(MOUNT_TRACKING_PROPERTY, MOUNT_TRACKING_OFF_ITEM, true);
 					indigo_set_switch(MOUNT_PARK_PROPERTY, MOUNT_PARK_UNPARKED_ITEM, true);
-					if (meade_command(device, ":X34#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":X34#", response, sizeof(response) - 1, 0)) {
 						if (response[1] == '1') {
 							indigo_set_switch(MOUNT_TRACKING_PROPERTY, MOUNT_TRACKING_ON_ITEM, true);
 						} else {
@@ -540,7 +514,7 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 							PRIVATE_DATA->parked = true;
 						}
 					}
-					if (meade_command(device, ":X22#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":X22#", response, sizeof(response) - 1, 0)) {
 						int ra, dec;
 						if (sscanf(response, "%db%d#", &ra, &dec) == 2) {
 							MOUNT_GUIDE_RATE_RA_ITEM->number.value = MOUNT_GUIDE_RATE_RA_ITEM->number.target = ra;
@@ -579,11 +553,11 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 					MOUNT_PARK_PARKED_ITEM->sw.value = false;
 					PRIVATE_DATA->parked = false;
 					strcpy(MOUNT_INFO_VENDOR_ITEM->text.value, "On-Step");
-					if (meade_command(device, ":GVN#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":GVN#", response, sizeof(response) - 1, 0)) {
 						INDIGO_DRIVER_LOG(DRIVER_NAME, "Firmware: %s", response);
 						strncpy(MOUNT_INFO_FIRMWARE_ITEM->text.value, response, INDIGO_VALUE_SIZE);
 					}
-					if (meade_command(device, ":GW#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":GW#", response, sizeof(response) - 1, 0)) {
 						INDIGO_DRIVER_LOG(DRIVER_NAME, "Status:   %s", response);
 						ALIGNMENT_MODE_PROPERTY->hidden = false;
 						if (*response == 'P' || *response == 'G') {
@@ -598,7 +572,7 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 						}
 						indigo_define_property(device, ALIGNMENT_MODE_PROPERTY, NULL);
 					}
-					if (meade_command(device, ":$QZ?", response, sizeof(response), 0))
+					if (meade_command(device, ":$QZ?", response, sizeof(response) - 1, 0))
 						indigo_set_switch(MOUNT_PEC_PROPERTY, response[0] == 'P' ? MOUNT_PEC_ENABLED_ITEM : MOUNT_PEC_DISABLED_ITEM, true);
 					meade_get_observatory(device);
 					meade_get_coords(device);
@@ -745,7 +719,7 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 						INDIGO_DRIVER_ERROR(DRIVER_NAME, "%s failed", command);
 						MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = INDIGO_ALERT_STATE;
 					} else {
-						if (!meade_command(device, ":CM#", response, sizeof(response), 100000) || *response == 0) {
+						if (!meade_command(device, ":CM#", response, sizeof(response) - 1, 100000) || *response == 0) {
 							INDIGO_DRIVER_ERROR(DRIVER_NAME, ":CM# failed");
 							MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = INDIGO_ALERT_STATE;
 						}
@@ -1083,7 +1057,7 @@ static indigo_result mount_change_property(indigo_device *device, indigo_client
 		MOUNT_HOME_PROPERTY->state = INDIGO_ALERT_STATE;
 		if (MOUNT_HOME_ITEM->sw.value) {
 			if (MOUNT_TYPE_AVALON_ITEM->sw.value) {
-				if (meade_command(device, ":X361#", response, sizeof(response), 0) && strcmp(response, "pA") == 0) {
+				if (meade_command(device, ":X361#", response, sizeof(response) - 1, 0) && strcmp(response, "pA") == 0) {
 					MOUNT_HOME_PROPERTY->state = INDIGO_OK_STATE;
 				}
 			}
@@ -1221,7 +1195,7 @@ static void focuser_timer_callback(indigo_device *device) {
 		char response[16];
 		if (MOUNT_TYPE_MEADE_ITEM->sw.value || MOUNT_TYPE_AP_ITEM->sw.value) {
 			meade_command(device, ":FQ#", NULL, 0, 0);
-			if (meade_command(device, ":FP#", response, sizeof(response), 0)) {
+			if (meade_command(device, ":FP#", response, sizeof(response) - 1, 0)) {
 				FOCUSER_POSITION_ITEM->number.value = atoi(response);
 				FOCUSER_POSITION_PROPERTY->state = INDIGO_OK_STATE;
 			} else {
@@ -1231,12 +1205,12 @@ static void focuser_timer_callback(indigo_device *device) {
 			FOCUSER_STEPS_PROPERTY->state = INDIGO_OK_STATE;
 			indigo_update_property(device, FOCUSER_STEPS_PROPERTY, NULL);
 		} else if (MOUNT_TYPE_ON_STEP_ITEM->sw.value) {
-			if (!meade_command(device, ":FG#", response, sizeof(response), 0)) {
+			if (!meade_command(device, ":FG#", response, sizeof(response) - 1, 0)) {
 				FOCUSER_POSITION_PROPERTY->state = INDIGO_ALERT_STATE;
 				FOCUSER_STEPS_PROPERTY->state = INDIGO_ALERT_STATE;
 			} else {
 				FOCUSER_POSITION_ITEM->number.value = atoi(response);
-				if (!meade_command(device, ":FT#", response, sizeof(response), 0)) {
+				if (!meade_command(device, ":FT#", response, sizeof(response) - 1, 0)) {
 					FOCUSER_POSITION_PROPERTY->state = INDIGO_ALERT_STATE;
 					FOCUSER_STEPS_PROPERTY->state = INDIGO_ALERT_STATE;
 				} else if (response[0] == 'M') {
@@ -1287,7 +1261,7 @@ static indigo_result focuser_change_property(indigo_device *device, indigo_clien
 					FOCUSER_SPEED_ITEM->number.max = 2;
 					FOCUSER_SPEED_PROPERTY->state = INDIGO_OK_STATE;
 					meade_command(device, FOCUSER_SPEED_ITEM->number.value == 1 ? ":FS#" : ":FF#", NULL, 0, 0);
-					if (meade_command(device, ":FP#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":FP#", response, sizeof(response) - 1, 0)) {
 						FOCUSER_POSITION_ITEM->number.value = atoi(response);
 						FOCUSER_POSITION_PROPERTY->state = INDIGO_OK_STATE;
 					} else {
@@ -1299,17 +1273,17 @@ static indigo_result focuser_change_property(indigo_device *device, indigo_clien
 					FOCUSER_SPEED_PROPERTY->state = INDIGO_OK_STATE;
 					sprintf(command, "F%d", (int)FOCUSER_SPEED_ITEM->number.value);
 					meade_command(device, command, NULL, 0, 0);
-					if (meade_command(device, ":FG#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":FG#", response, sizeof(response) - 1, 0)) {
 						FOCUSER_POSITION_ITEM->number.value = atoi(response);
 						FOCUSER_POSITION_PROPERTY->state = INDIGO_OK_STATE;
 						FOCUSER_POSITION_PROPERTY->perm = INDIGO_RW_PERM;
 					} else {
 						FOCUSER_POSITION_PROPERTY->state = INDIGO_ALERT_STATE;
 					}
-					if (meade_command(device, ":FI#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":FI#", response, sizeof(response) - 1, 0)) {
 						FOCUSER_POSITION_ITEM->number.min = atoi(response);
 					}
-					if (meade_command(device, ":FM#", response, sizeof(response), 0)) {
+					if (meade_command(device, ":FM#", response, sizeof(response) - 1, 0)) {
 						FOCUSER_POSITION_ITEM->number.max = atoi(response);
 					}
 				}
@@ -1384,7 +1358,7 @@ static indigo_result focuser_change_property(indigo_device *device, indigo_clien
 			FOCUSER_ABORT_MOTION_ITEM->sw.value = false;
 			if (MOUNT_TYPE_MEADE_ITEM->sw.value || MOUNT_TYPE_AP_ITEM->sw.value) {
 				meade_command(device, ":FQ#", NULL, 0, 0);
-				if (meade_command(device, ":FP#", response, sizeof(response), 0)) {
+				if (meade_command(device, ":FP#", response, sizeof(response) - 1, 0)) {
 					FOCUSER_POSITION_ITEM->number.value = atoi(response);
 					FOCUSER_POSITION_PROPERTY->state = INDIGO_OK_STATE;
 				} else {
@@ -1392,7 +1366,7 @@ static indigo_result focuser_change_property(indigo_device *device, indigo_clien
 				}
 			} else if (MOUNT_TYPE_ON_STEP_ITEM->sw.value) {
 				meade_command(device, ":FQ#", NULL, 0, 0);
-				if (meade_command(device, ":FG#", response, sizeof(response), 0)) {
+				if (meade_command(device, ":FG#", response, sizeof(response) - 1, 0)) {
 					FOCUSER_POSITION_ITEM->number.value = atoi(response);
 					FOCUSER_POSITION_PROPERTY->state = INDIGO_OK_STATE;
 				} else {
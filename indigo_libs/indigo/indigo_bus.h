@@ -154,7 +154,8 @@ extern char *indigo_switch_rule_text[];
 typedef enum {
 	INDIGO_ENABLE_BLOB_ALSO,
 	INDIGO_ENABLE_BLOB_NEVER,
-	INDIGO_ENABLE_BLOB_URL
+	INDIGO_ENABLE_BLOB_URL,
+	INDIGO_ENABLE_BLOB_BINARY						///< like INDIGO_ENABLE_BLOB_ALSO, but XML payload is sent as raw bytes to INDIGO 2.0 peers
 } indigo_enable_blob_mode;
 
 #define INDIGO_ENABLE_BLOB INDIGO_ENABLE_BLOB_URL
@@ -196,6 +197,14 @@ typedef enum {
 	INDIGO_LOG_TRACE
 } indigo_log_levels;
 
+/** Reference counted immutable BLOB content.
+ */
+typedef struct {
+	void *content;											///< BLOB content (must not be modified once published)
+	long size;													///< allocated size
+	int reference_count;								///< number of holders, content is freed when the last one releases it
+} indigo_blob_buffer;
+
 /** Property item definition.
  */
 typedef struct {/* there is no .name =  because of g++ C99 bug affecting string initialier */
@@ -235,6 +244,7 @@ typedef struct {/* there is no .name =  because of g++ C99 bug affecting string
 			char url[INDIGO_VALUE_SIZE];		///< item URL on source server
 			long size;                      ///< item size (for blob properties) in bytes
 			void *value;                    ///< item value (for blob properties)
+			indigo_blob_buffer *buffer;			///< shared buffer value points into (if not NULL, BLOB cache retains it instead of copying value, it is detached on update if value and size are not inside it)
 		} blob;
 	};
 } indigo_item;
@@ -341,16 +351,20 @@ typedef struct {
 	int output;													///< output handle
 	bool web_socket;										///< connection over WebSocket (RFC6455)
 	char url_prefix[INDIGO_NAME_SIZE];	///< server url prefix (for BLOB download)
+	struct indigo_output_queue *output_queue;	///< outbound message queue (if NULL, output is written synchronously)
+	pthread_mutex_t mutex;							///< serializes output to this connection
 } indigo_adapter_context;
 
 /** BLOB entry type.
  */
-typedef struct {
+typedef struct indigo_blob_entry {
 	indigo_item *item;     							///< BLOB item
 	void *content;            					///< BLOB content
 	long size;              						///< BLOB size
 	char format[INDIGO_NAME_SIZE];  		///< BLOB format, known file type suffix like ".fits" or ".jpeg"
-	pthread_mutex_t mutext;							///< BLOB mutex
+	pthread_mutex_t mutext;							///< BLOB mutex (held by cache while content is replaced, for indigo_validate_blob() users)
+	indigo_blob_buffer *buffer;					///< shared buffer holding content
+	struct indigo_blob_entry *next;			///< next entry in BLOB cache chain
 } indigo_blob_entry;
 
 /** Last diagnostic messages.
@@ -476,7 +490,22 @@ extern void *indigo_alloc_blob_buffer(long size);
 /** Resize property.
  */
 extern void indigo_release_property(indigo_property *property);
-/** Validate address of item of registered BLOB property.
+/** Allocate shared BLOB buffer with reference count 1 (content rounded up to 2880 bytes).
+ */
+extern indigo_blob_buffer *indigo_alloc_shared_blob_buffer(long size);
+/** Add reference to shared BLOB buffer.
+ */
+extern indigo_blob_buffer *indigo_retain_blob_buffer(indigo_blob_buffer *buffer);
+/** Drop reference to shared BLOB buffer, free it if it was the last one.
+ */
+extern void indigo_release_blob_buffer(indigo_blob_buffer *buffer);
+/** Check that size bytes at data lie inside shared BLOB buffer.
+ */
+extern bool indigo_blob_buffer_contains(indigo_blob_buffer *buffer, const void *data, long size);
+/** Get cached content of item of registered BLOB property, entry->buffer is retained and must be released by caller.
+ */
+extern bool indigo_retain_blob(indigo_item *item, indigo_blob_entry *entry);
+/** Validate address of item of registered BLOB property, content must be accessed with entry->mutext locked (deprecated, use indigo_retain_blob()).
  */
 extern indigo_blob_entry *indigo_validate_blob(indigo_item *item);
 
@@ -576,6 +605,19 @@ extern void indigo_trim_local_service(char *device_name);
  */
 extern bool indigo_async(void *fun(void *data), void *data);
 
+/** Split range [0, count) to chunks and run worker(data, from, to) for them on shared worker threads (caller thread takes part as well).
+ Returns when all chunks are done.
+ */
+extern void indigo_parallel(void (*worker)(void *data, long from, long to), void *data, long count);
+
+/** Attribute for pixel kernels left to the compiler to vectorize, on x86_64 Linux both generic and AVX2 code is built and selected at load time.
+ */
+#if defined(INDIGO_LINUX) && defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define INDIGO_IMAGE_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define INDIGO_IMAGE_KERNEL
+#endif
+
 /** Convert sexagesimal string to double.
  */
 extern double indigo_stod(char *string);
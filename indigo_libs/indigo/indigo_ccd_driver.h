@@ -273,6 +273,14 @@ extern "C" {
  */
 #define CCD_IMAGE_FORMAT_JPEG_ITEM        (CCD_IMAGE_FORMAT_PROPERTY->items+3)
 
+/** CCD_IMAGE_FORMAT.FITS_RICE property item pointer.
+ */
+#define CCD_IMAGE_FORMAT_FITS_RICE_ITEM   (CCD_IMAGE_FORMAT_PROPERTY->items+4)
+
+/** CCD_IMAGE_FORMAT.XISF_LZ4 property item pointer.
+ */
+#define CCD_IMAGE_FORMAT_XISF_LZ4_ITEM    (CCD_IMAGE_FORMAT_PROPERTY->items+5)
+
 /** CCD_IMAGE_FILE property pointer, property is mandatory, read-only property.
  */
 #define CCD_IMAGE_FILE_PROPERTY           (CCD_CONTEXT->ccd_image_file_property)
@@ -281,6 +289,46 @@ extern "C" {
  */
 #define CCD_IMAGE_FILE_ITEM               (CCD_IMAGE_FILE_PROPERTY->items+0)
 
+/** CCD_IMAGE_STATS property pointer, property is mandatory, read-only property, updated by indigo_process_image() for each frame if CCD_IMAGE_STATS_ENABLE.ENABLED is set.
+ */
+#define CCD_IMAGE_STATS_PROPERTY          (CCD_CONTEXT->ccd_image_stats_property)
+
+/** CCD_IMAGE_STATS.MIN property item pointer.
+ */
+#define CCD_IMAGE_STATS_MIN_ITEM          (CCD_IMAGE_STATS_PROPERTY->items+0)
+
+/** CCD_IMAGE_STATS.MAX property item pointer.
+ */
+#define CCD_IMAGE_STATS_MAX_ITEM          (CCD_IMAGE_STATS_PROPERTY->items+1)
+
+/** CCD_IMAGE_STATS.MEAN property item pointer.
+ */
+#define CCD_IMAGE_STATS_MEAN_ITEM         (CCD_IMAGE_STATS_PROPERTY->items+2)
+
+/** CCD_IMAGE_STATS.MEDIAN property item pointer.
+ */
+#define CCD_IMAGE_STATS_MEDIAN_ITEM       (CCD_IMAGE_STATS_PROPERTY->items+3)
+
+/** CCD_IMAGE_STATS.NOISE property item pointer (MAD based standard deviation estimate).
+ */
+#define CCD_IMAGE_STATS_NOISE_ITEM        (CCD_IMAGE_STATS_PROPERTY->items+4)
+
+/** CCD_IMAGE_STATS.SATURATED property item pointer (number of samples at full scale).
+ */
+#define CCD_IMAGE_STATS_SATURATED_ITEM    (CCD_IMAGE_STATS_PROPERTY->items+5)
+
+/** CCD_IMAGE_STATS_ENABLE property pointer, property is mandatory, read-write property.
+ */
+#define CCD_IMAGE_STATS_ENABLE_PROPERTY   (CCD_CONTEXT->ccd_image_stats_enable_property)
+
+/** CCD_IMAGE_STATS_ENABLE.ENABLED property item pointer.
+ */
+#define CCD_IMAGE_STATS_ENABLED_ITEM      (CCD_IMAGE_STATS_ENABLE_PROPERTY->items+0)
+
+/** CCD_IMAGE_STATS_ENABLE.DISABLED property item pointer.
+ */
+#define CCD_IMAGE_STATS_DISABLED_ITEM     (CCD_IMAGE_STATS_ENABLE_PROPERTY->items+1)
+
 /** CCD_IMAGE property pointer, property is mandatory, read-only property.
  */
 #define CCD_IMAGE_PROPERTY                (CCD_CONTEXT->ccd_image_property)
@@ -357,6 +405,14 @@ extern "C" {
  */
 #define CCD_JPEG_SETTINGS_WHITE_TRESHOLD_ITEM     (CCD_JPEG_SETTINGS_PROPERTY->items+4)
 
+/** CCD_JPEG_SETTINGS.PREVIEW_WIDTH property item pointer.
+ */
+#define CCD_JPEG_SETTINGS_PREVIEW_WIDTH_ITEM     (CCD_JPEG_SETTINGS_PROPERTY->items+5)
+
+/** CCD_JPEG_SETTINGS.PREVIEW_QUALITY property item pointer.
+ */
+#define CCD_JPEG_SETTINGS_PREVIEW_QUALITY_ITEM     (CCD_JPEG_SETTINGS_PROPERTY->items+6)
+
 /** CCD_RBI_FLUSH property pointer.
  */
 #define CCD_RBI_FLUSH_PROPERTY          (CCD_CONTEXT->ccd_rbi_flush_property)
@@ -381,14 +437,22 @@ extern "C" {
 #define CCD_RBI_FLUSH_DISABLED_ITEM     (CCD_RBI_FLUSH_ENABLE_PROPERTY->items + 1)
 
 
+/** Frame buffer pool (private to CCD driver base).
+ */
+typedef struct indigo_ccd_frame_pool indigo_ccd_frame_pool;
+
+/** FITS keyword registry (private to CCD driver base).
+ */
+typedef struct indigo_ccd_fits_keywords indigo_ccd_fits_keywords;
+
 /** CCD device context structure.
  */
 typedef struct {
 	indigo_device_context device_context;         ///< device context base
 	bool countdown_enabled;												///< countdown enabled
 	indigo_timer *countdown_timer;								///< countdown timer
-	void *preview_image;													///< preview image buffer
-	unsigned long preview_image_size;												///< preview image buffer size
+	void *preview_image;													///< unused, preview is held in shared buffer of CCD_PREVIEW_IMAGE item
+	unsigned long preview_image_size;												///< unused
 	indigo_property *ccd_info_property;           ///< CCD_INFO property pointer
 	indigo_property *ccd_upload_mode_property;    ///< CCD_UPLOAD_MODE property pointer
 	indigo_property *ccd_preview_property;				///< CCD_PREVIEW property pointer
@@ -415,6 +479,15 @@ typedef struct {
 	indigo_property *ccd_jpeg_settings;						///< CCD_JPEG_SETTINGS property pointer
 	indigo_property *ccd_rbi_flush_enable_property; ///< CCD_RBI_FLUSH_ENABLE property pointer
 	indigo_property *ccd_rbi_flush_property;			///< CCD_RBI_FLUSH property pointer
+	indigo_ccd_frame_pool *frame_pool;						///< frame buffer pool (created on first use)
+	char file_name_pattern[INDIGO_VALUE_SIZE];		///< local mode file name pattern for which file_name_index is valid
+	int file_name_index;													///< last index used for file_name_pattern
+	indigo_ccd_fits_keywords *fits_keywords;			///< FITS keyword registry (created on first use)
+	void *image_buffer;														///< image buffer used if header doesn't fit FITS_HEADER_SIZE
+	unsigned long image_buffer_size;							///< image buffer size
+	indigo_property *ccd_image_stats_property;    ///< CCD_IMAGE_STATS property pointer
+	indigo_property *ccd_image_stats_enable_property; ///< CCD_IMAGE_STATS_ENABLE property pointer
+	pthread_mutex_t image_mutex;									///< serializes image processing of driver and frame pool threads
 } indigo_ccd_context;
 
 /** Suspend countdown.
@@ -456,7 +529,21 @@ typedef struct {
 	const char *comment;
 } indigo_fits_keyword;
 
+/** Set FITS keyword in device keyword registry, it is added to FITS header and XISF metadata of all subsequent images until removed.
+ Keyword with the same name is replaced, keyword is formatted immediately, so it can be allocated on caller's stack.
+ */
+extern void indigo_ccd_set_fits_keyword(indigo_device *device, indigo_fits_keyword *keyword);
+
+/** Remove FITS keyword from device keyword registry.
+ */
+extern void indigo_ccd_remove_fits_keyword(indigo_device *device, const char *name);
+
+/** Remove all FITS keywords from device keyword registry.
+ */
+extern void indigo_ccd_clear_fits_keywords(indigo_device *device);
+
 /** Process raw image in image buffer (starting on data + FITS_HEADER_SIZE offset).
+ Header larger than FITS_HEADER_SIZE (e.g. with many keywords) grows in 2880 byte blocks, image is then copied to device image buffer.
  */
 extern void indigo_process_image(indigo_device *device, void *data, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords);
 
@@ -466,6 +553,36 @@ extern void indigo_process_dslr_image(indigo_device *device, void *data, int blo
 
 extern void indigo_process_dslr_preview_image(indigo_device *device, void *data, int blobsize);
 
+/** Local image file write policy.
+ */
+typedef enum {
+	INDIGO_CCD_WRITE_BUFFERED = 0,	///< files are written through page cache
+	INDIGO_CCD_WRITE_SYNC,					///< file data are flushed to media before CCD_IMAGE_FILE is updated
+	INDIGO_CCD_WRITE_DIRECT					///< like INDIGO_CCD_WRITE_SYNC, but page cache is bypassed if possible (O_DIRECT)
+} indigo_ccd_write_policy;
+
+/** Local image file write policy, files are written on background thread and CCD_IMAGE_FILE is updated when write is finished.
+ */
+extern indigo_ccd_write_policy indigo_ccd_local_write_policy;
+
+/** Acquire image buffer of at least size bytes (including FITS_HEADER_SIZE) from device frame pool, blocks while all pool buffers are in use.
+ Buffer of published CCD_IMAGE stays referenced until it is replaced by the next frame and it is never overwritten while clients hold it.
+ */
+extern void *indigo_ccd_acquire_frame_buffer(indigo_device *device, long size);
+
+/** Return acquired image buffer to the pool without processing it (e.g. on failed readout).
+ */
+extern void indigo_ccd_release_frame_buffer(indigo_device *device, void *buffer);
+
+/** Queue acquired image buffer for indigo_process_image() on device processing thread and return immediately, buffer is returned to the pool once processed.
+ Keywords are copied, so they can be allocated on caller's stack. indigo_process_image() calls are serialized, so driver can still process other images directly.
+ */
+extern void indigo_ccd_process_frame_buffer(indigo_device *device, void *buffer, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords);
+
+/** Wait until all queued image buffers are processed.
+ */
+extern void indigo_ccd_flush_frame_buffers(indigo_device *device);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,7 +24,16 @@
 
 #include <stdio.h>
 
-typedef enum { none = 0, centroid, donuts } indigo_guide_algorithm;
+typedef enum { none = 0, centroid, donuts, multistar } indigo_guide_algorithm;
+
+#define INDIGO_MAX_GUIDE_STARS	24
+
+typedef struct {
+	double x;
+	double y;
+	double flux;
+	double snr;
+} indigo_guide_star;
 
 typedef struct {
 	indigo_guide_algorithm algorithm;
@@ -39,13 +48,28 @@ typedef struct {
 		double centroid_y;
 	};
 	double snr;
+	int star_count;
+	indigo_guide_star *stars;
 } indigo_frame_digest;
 
+typedef struct {
+	double x;
+	double y;
+	double flux;
+	double peak;
+	double hfd;
+	double fwhm;
+} indigo_star_detection;
+
 extern indigo_result indigo_selection_psf(indigo_raw_type raw_type, const void *data, double x, double y, const int radius, const int width, const int height, double *fwhm, double *hfd, double *peak);
+extern indigo_result indigo_find_stars(indigo_raw_type raw_type, const void *data, const int width, const int height, const int max_stars, indigo_star_detection star_list[], int *star_count);
+extern indigo_result indigo_field_psf(indigo_raw_type raw_type, const void *data, const int width, const int height, double *hfd, double *fwhm, int *star_count);
 
 extern indigo_result indigo_selection_frame_digest(indigo_raw_type raw_type, const void *data, double *x, double *y, const int radius, const int width, const int height, indigo_frame_digest *c);
 extern indigo_result indigo_centroid_frame_digest(indigo_raw_type raw_type, const void *data, const int width, const int height, indigo_frame_digest *c);
 extern indigo_result indigo_donuts_frame_digest(indigo_raw_type raw_type, const void *data, const int width, const int height, indigo_frame_digest *fdigest);
+extern indigo_result indigo_multistar_reference_digest(indigo_raw_type raw_type, const void *data, const int radius, const int count, const int width, const int height, indigo_frame_digest *c);
+extern indigo_result indigo_multistar_frame_digest(indigo_raw_type raw_type, const void *data, const indigo_frame_digest *ref, const int radius, const int width, const int height, indigo_frame_digest *c);
 extern indigo_result indigo_calculate_drift(const indigo_frame_digest *ref, const indigo_frame_digest *new, double *drift_x, double *drift_y);
 extern indigo_result indigo_delete_frame_digest(indigo_frame_digest *fdigest);
 
@@ -31,6 +31,8 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include <indigo/indigo_bus.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -40,6 +42,42 @@ typedef enum {
 	INDIGO_PROTOCOL_UDP = 1
 } indigo_network_protocol;
 
+/** BLOB payload of outbound message, written from retained shared buffer instead of being copied into message.
+ */
+typedef struct indigo_message_blob {
+	long offset;											///< position in message content where payload is inserted
+	indigo_blob_buffer *buffer;				///< retained shared buffer
+	const unsigned char *data;				///< payload
+	long size;												///< payload size
+	bool base64;											///< payload is base64 encoded while written
+	struct indigo_message_blob *next;	///< next payload
+} indigo_message_blob;
+
+/** Outbound message (growable buffer).
+ */
+typedef struct {
+	char *data;												///< message content
+	long length;											///< content length
+	long size;												///< allocated size
+	indigo_message_blob *blobs;				///< BLOB payloads inserted into content (NULL for plain text)
+} indigo_message;
+
+/** Outbound queue delivery policy.
+ */
+typedef enum {
+	INDIGO_QUEUE_KEEP,								///< message is always delivered (definitions, deletions, messages)
+	INDIGO_QUEUE_COALESCE,						///< pending message with the same key is dropped, the latest value wins
+	INDIGO_QUEUE_BLOB									///< like INDIGO_QUEUE_COALESCE, but message is rejected if the queue is full
+} indigo_queue_policy;
+
+/** Bounded outbound queue drained by a writer thread.
+ */
+typedef struct indigo_output_queue indigo_output_queue;
+
+/** Buffered reader attached to a handle (once created, all reads from the handle must go through it).
+ */
+typedef struct indigo_reader indigo_reader;
+
 /** Open serial connection at speed 9600.
  */
 extern int indigo_open_serial(const char *dev_file);
@@ -84,7 +122,7 @@ extern int indigo_recv(int handle, char *buffer, long length);
 extern int indigo_close(int handle);
 #endif
 
-/** Read line.
+/** Read line (on sockets available data is peeked and only the line is consumed, otherwise it is read byte by byte).
  */
 extern int indigo_read_line(int handle, char *buffer, int length);
 
@@ -102,6 +140,66 @@ extern bool indigo_printf(int handle, const char *format, ...);
 
 extern int indigo_scanf(int handle, const char *format, ...);
 
+/** Create buffered reader for handle.
+ */
+extern indigo_reader *indigo_create_reader(int handle);
+
+/** Read line terminated by \n (\r is skipped), returns line length or -1 on error.
+ */
+extern int indigo_reader_read_line(indigo_reader *reader, char *buffer, int length);
+
+/** Read up to delimiter (consumed, but not stored) or length - 1 bytes. Waits at most timeout us for the first byte and next_timeout us
+ for each following chunk (negative value means wait forever), returns number of bytes read (timeout ends read early) or -1 on error.
+ */
+extern int indigo_reader_read_until(indigo_reader *reader, char *buffer, int length, char delimiter, long timeout, long next_timeout);
+
+/** Read exactly length bytes, returns length or -1 on error.
+ */
+extern int indigo_reader_read(indigo_reader *reader, char *buffer, int length);
+
+/** Drop buffered data and drain input until it is quiet for timeout us, returns false on error.
+ */
+extern bool indigo_reader_discard(indigo_reader *reader, long timeout);
+
+/** Release buffered reader (handle is not closed).
+ */
+extern void indigo_release_reader(indigo_reader *reader);
+
+/** Append formatted text to message.
+ */
+extern void indigo_message_printf(indigo_message *message, const char *format, ...);
+
+/** Append buffer to message.
+ */
+extern void indigo_message_append(indigo_message *message, const char *data, long length);
+
+/** Make room for length bytes at the end of message and return pointer to it (message length is not changed).
+ */
+extern char *indigo_message_reserve(indigo_message *message, long length);
+
+/** Append BLOB payload to message, optionally base64 encoded.
+ If buffer is not NULL, it is retained and the payload is written from it, otherwise data is copied into message.
+ */
+extern void indigo_message_append_blob(indigo_message *message, indigo_blob_buffer *buffer, const void *data, long size, bool base64);
+
+/** Write message to handle and release its content.
+ */
+extern bool indigo_write_message(int handle, indigo_message *message);
+
+/** Create outbound queue for handle and start its writer thread.
+ */
+extern indigo_output_queue *indigo_create_output_queue(int handle);
+
+/** Queue message (queue takes ownership of message content, key is used for coalescing and can be NULL for INDIGO_QUEUE_KEEP).
+ Returns false if message was dropped (BLOB over queue limit or connection failed), caller is never blocked.
+ Only message content counts against queue limit, BLOB payloads appended with shared buffer are not copied.
+ */
+extern bool indigo_queue_message(indigo_output_queue *queue, const char *key, indigo_queue_policy policy, indigo_message *message);
+
+/** Write pending messages, stop writer thread and release queue (handle is shut down if peer doesn't read pending messages within 5 seconds).
+ */
+extern void indigo_release_output_queue(indigo_output_queue *queue);
+
 #ifdef __cplusplus
 }
 #endif
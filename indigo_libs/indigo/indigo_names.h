@@ -462,6 +462,14 @@
  */
 #define CCD_IMAGE_FORMAT_JPEG_ITEM_NAME       "JPEG"
 
+/** CCD_IMAGE_FORMAT.FITS_RICE property item name.
+ */
+#define CCD_IMAGE_FORMAT_FITS_RICE_ITEM_NAME  "FITS_RICE"
+
+/** CCD_IMAGE_FORMAT.XISF_LZ4 property item name.
+ */
+#define CCD_IMAGE_FORMAT_XISF_LZ4_ITEM_NAME   "XISF_LZ4"
+
 //----------------------------------------------------------------------
 /** CCD_IMAGE_FILE property name.
  */
@@ -471,6 +479,46 @@
  */
 #define CCD_IMAGE_FILE_ITEM_NAME              "FILE"
 
+/** CCD_IMAGE_STATS property name.
+ */
+#define CCD_IMAGE_STATS_PROPERTY_NAME         "CCD_IMAGE_STATS"
+
+/** CCD_IMAGE_STATS.MIN property item name.
+ */
+#define CCD_IMAGE_STATS_MIN_ITEM_NAME         "MIN"
+
+/** CCD_IMAGE_STATS.MAX property item name.
+ */
+#define CCD_IMAGE_STATS_MAX_ITEM_NAME         "MAX"
+
+/** CCD_IMAGE_STATS.MEAN property item name.
+ */
+#define CCD_IMAGE_STATS_MEAN_ITEM_NAME        "MEAN"
+
+/** CCD_IMAGE_STATS.MEDIAN property item name.
+ */
+#define CCD_IMAGE_STATS_MEDIAN_ITEM_NAME      "MEDIAN"
+
+/** CCD_IMAGE_STATS.NOISE property item name.
+ */
+#define CCD_IMAGE_STATS_NOISE_ITEM_NAME       "NOISE"
+
+/** CCD_IMAGE_STATS.SATURATED property item name.
+ */
+#define CCD_IMAGE_STATS_SATURATED_ITEM_NAME   "SATURATED"
+
+/** CCD_IMAGE_STATS_ENABLE property name.
+ */
+#define CCD_IMAGE_STATS_ENABLE_PROPERTY_NAME  "CCD_IMAGE_STATS_ENABLE"
+
+/** CCD_IMAGE_STATS_ENABLE.ENABLED property item name.
+ */
+#define CCD_IMAGE_STATS_ENABLED_ITEM_NAME     "ENABLED"
+
+/** CCD_IMAGE_STATS_ENABLE.DISABLED property item name.
+ */
+#define CCD_IMAGE_STATS_DISABLED_ITEM_NAME    "DISABLED"
+
 /** CCD_IMAGE property name.
  */
 #define CCD_IMAGE_PROPERTY_NAME               "CCD_IMAGE"
@@ -545,6 +593,14 @@
  */
 #define CCD_JPEG_SETTINGS_WHITE_TRESHOLD_ITEM_NAME			"WHITE_TRESHOLD"
 
+/** CCD_JPEG_SETTINGS.PREVIEW_WIDTH property item name.
+ */
+#define CCD_JPEG_SETTINGS_PREVIEW_WIDTH_ITEM_NAME			"PREVIEW_WIDTH"
+
+/** CCD_JPEG_SETTINGS.PREVIEW_QUALITY property item name.
+ */
+#define CCD_JPEG_SETTINGS_PREVIEW_QUALITY_ITEM_NAME			"PREVIEW_QUALITY"
+
 /** CCD_RBI_FLUSH_ENABLE property name.
  */
 #define CCD_RBI_FLUSH_PROPERTY_NAME          "CCD_RBI_FLUSH_ENABLE"
@@ -2143,6 +2199,7 @@
 #define AGENT_GUIDER_DETECTION_DONUTS_ITEM_NAME  			"DONUTS"
 #define AGENT_GUIDER_DETECTION_CENTROID_ITEM_NAME    	"CENTROID"
 #define AGENT_GUIDER_DETECTION_SELECTION_ITEM_NAME    "SELECTION"
+#define AGENT_GUIDER_DETECTION_MULTISTAR_ITEM_NAME    "MULTISTAR"
 
 #define AGENT_GUIDER_DEC_MODE_PROPERTY_NAME						"AGENT_GUIDER_DEC_MODE"
 #define AGENT_GUIDER_DEC_MODE_BOTH_ITEM_NAME    			"BOTH"
@@ -2170,6 +2227,7 @@
 #define AGENT_GUIDER_SETTINGS_DITH_X_ITEM_NAME				"DITHERING_X"
 #define AGENT_GUIDER_SETTINGS_DITH_Y_ITEM_NAME				"DITHERING_Y"
 #define AGENT_GUIDER_SETTINGS_STACK_ITEM_NAME					"STACK"
+#define AGENT_GUIDER_SETTINGS_STAR_COUNT_ITEM_NAME		"STAR_COUNT"
 
 #define AGENT_GUIDER_SELECTION_PROPERTY_NAME					"AGENT_GUIDER_SELECTION"
 #define AGENT_GUIDER_SELECTION_X_ITEM_NAME						"X"
@@ -2199,6 +2257,11 @@
 #define AGENT_IMAGER_FOCUS_FINAL_ITEM_NAME  					"FINAL"
 #define AGENT_IMAGER_FOCUS_BACKLASH_ITEM_NAME     		"BACKLASH"
 #define AGENT_IMAGER_FOCUS_STACK_ITEM_NAME  					"STACK"
+#define AGENT_IMAGER_FOCUS_POINTS_ITEM_NAME  					"POINTS"
+
+#define AGENT_IMAGER_FOCUS_MODE_PROPERTY_NAME					"AGENT_IMAGER_FOCUS_MODE"
+#define AGENT_IMAGER_FOCUS_ITERATIVE_ITEM_NAME				"ITERATIVE"
+#define AGENT_IMAGER_FOCUS_CURVE_ITEM_NAME						"CURVE"
 
 #define AGENT_IMAGER_DITHERING_PROPERTY_NAME 					"AGENT_IMAGER_DITHERING_"
 #define AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM_NAME "AGGRESSIVITY"
@@ -2220,6 +2283,8 @@
 #define AGENT_IMAGER_STATS_FWHM_ITEM_NAME							"FWHM"
 #define AGENT_IMAGER_STATS_HFD_ITEM_NAME							"HFD"
 #define AGENT_IMAGER_STATS_PEAK_ITEM_NAME							"PEAK"
+#define AGENT_IMAGER_STATS_MEDIAN_HFD_ITEM_NAME				"MEDIAN_HFD"
+#define AGENT_IMAGER_STATS_STAR_COUNT_ITEM_NAME				"STAR_COUNT"
 
 #define AGENT_ALIGNMENT_POINT_PROPERY_NAME						"AGENT_ALIGNMENT_POINT_%d"
 #define AGENT_ALIGNMENT_POINT_RA_ITEM_NAME   					"RA"
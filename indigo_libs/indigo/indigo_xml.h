@@ -42,7 +42,7 @@ extern bool indigo_use_blob_urls;
  */
 extern void indigo_xml_parse(indigo_device *device, indigo_client *client);
 
-/** Escape XML string.
+/** Escape XML string (result is valid until the fifth subsequent call on the same thread).
  */
 extern char *indigo_xml_escape(char *string);
 
@@ -21,14 +21,13 @@
 
 #include <ctype.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
 #include <indigo/indigo_base64.h>
 #include <indigo/indigo_base64_luts.h>
 #include <stdio.h>
 
-/* out size should be at least 4*inlen/3 + 4.
- * returns length of out (without trailing NULL).
- */
-long base64_encode(unsigned char *out, const unsigned char *in, long inlen) {
+static long base64_encode_scalar(unsigned char *out, const unsigned char *in, long inlen) {
 	uint16_t* b64lut = (uint16_t*)base64lut;
 	long dlen = ((inlen+2)/3)*4; /* 4/3, rounded up */
 	uint16_t* wbuf = (uint16_t*)out;
@@ -58,8 +57,7 @@ long base64_encode(unsigned char *out, const unsigned char *in, long inlen) {
 }
 
 
-/* base64 should not contain whitespaces.*/
-long base64_decode_fast(unsigned char* out, const unsigned char* in, long inlen) {
+static long base64_decode_scalar(unsigned char* out, const unsigned char* in, long inlen) {
 	long outlen = 0;
 	uint8_t b1, b2, b3;
 	uint16_t s1, s2;
@@ -118,6 +116,208 @@ long base64_decode_fast(unsigned char* out, const unsigned char* in, long inlen)
 }
 
 
+// SIMD kernels process the bulk of the buffer and return number of consumed input bytes, the rest is left to scalar code.
+// Decoders leave at least the last quad (possibly padded) to scalar code and stop early on any character outside of base64 alphabet.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define BASE64_X86
+
+#include <immintrin.h>
+
+__attribute__((target("sse4.1"))) static inline __m128i encode_translate_sse(__m128i v) {
+	// split 3 bytes to 4 6-bit indices (in 32-bit lanes)
+	__m128i indices = _mm_or_si128(_mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040)), _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010)));
+	// map indices to ASCII by offset of their range
+	__m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+	range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+	const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+}
+
+__attribute__((target("sse4.1"))) static long base64_encode_sse(unsigned char *out, const unsigned char *in, long inlen) {
+	const __m128i shuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	long done = 0;
+	while (inlen - done >= 16) {
+		__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in + done)), shuffle);
+		_mm_storeu_si128((__m128i *)out, encode_translate_sse(v));
+		out += 16;
+		done += 12;
+	}
+	return done;
+}
+
+__attribute__((target("sse4.1"))) static long base64_decode_sse(unsigned char *out, const unsigned char *in, long inlen) {
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2f = _mm_set1_epi8(0x2f);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	long done = 0;
+	// 16 bytes are stored for 12 decoded, so there must be at least 2 more quads left
+	while (inlen - done >= 24) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + done));
+		__m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+		if (!_mm_testz_si128(_mm_shuffle_epi8(lut_lo, _mm_and_si128(v, mask_2f)), _mm_shuffle_epi8(lut_hi, hi_nibbles)))
+			break;
+		v = _mm_add_epi8(v, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(v, mask_2f), hi_nibbles)));
+		v = _mm_madd_epi16(_mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+		_mm_storeu_si128((__m128i *)out, _mm_shuffle_epi8(v, pack));
+		out += 12;
+		done += 16;
+	}
+	return done;
+}
+
+__attribute__((target("avx2"))) static long base64_encode_avx2(unsigned char *out, const unsigned char *in, long inlen) {
+	const __m256i shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m256i offsets = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0, 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	long done = 0;
+	// each lane takes 12 bytes, the upper one reads up to in + 28
+	while (inlen - done >= 28) {
+		__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + done))), _mm_loadu_si128((const __m128i *)(in + done + 12)), 1);
+		v = _mm256_shuffle_epi8(v, shuffle);
+		__m256i indices = _mm256_or_si256(_mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040)), _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010)));
+		__m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices), _mm256_set1_epi8(13)));
+		_mm256_storeu_si256((__m256i *)out, _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices));
+		out += 32;
+		done += 24;
+	}
+	return done + base64_encode_sse(out, in + done, inlen - done);
+}
+
+__attribute__((target("avx2"))) static long base64_decode_avx2(unsigned char *out, const unsigned char *in, long inlen) {
+	const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+	const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	long done = 0;
+	// 32 bytes are stored for 24 decoded, so there must be at least 4 more quads left
+	while (inlen - done >= 48) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(in + done));
+		__m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_2f);
+		if (!_mm256_testz_si256(_mm256_shuffle_epi8(lut_lo, _mm256_and_si256(v, mask_2f)), _mm256_shuffle_epi8(lut_hi, hi_nibbles)))
+			break;
+		v = _mm256_add_epi8(v, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(v, mask_2f), hi_nibbles)));
+		v = _mm256_madd_epi16(_mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+		v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack), _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		_mm256_storeu_si256((__m256i *)out, v);
+		out += 24;
+		done += 32;
+	}
+	return done + base64_decode_sse(out, in + done, inlen - done);
+}
+
+#elif defined(__aarch64__)
+
+#define BASE64_NEON
+
+#include <arm_neon.h>
+
+static const uint8_t neon_decode_lut[128] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+static long base64_encode_neon(unsigned char *out, const unsigned char *in, long inlen) {
+	const uint8x16x4_t lut = { { vld1q_u8((const uint8_t *)base64digits), vld1q_u8((const uint8_t *)base64digits + 16), vld1q_u8((const uint8_t *)base64digits + 32), vld1q_u8((const uint8_t *)base64digits + 48) } };
+	const uint8x16_t mask_3f = vdupq_n_u8(0x3f);
+	long done = 0;
+	while (inlen - done >= 48) {
+		uint8x16x3_t src = vld3q_u8(in + done);
+		uint8x16x4_t dst;
+		dst.val[0] = vqtbl4q_u8(lut, vshrq_n_u8(src.val[0], 2));
+		dst.val[1] = vqtbl4q_u8(lut, vandq_u8(vorrq_u8(vshlq_n_u8(src.val[0], 4), vshrq_n_u8(src.val[1], 4)), mask_3f));
+		dst.val[2] = vqtbl4q_u8(lut, vandq_u8(vorrq_u8(vshlq_n_u8(src.val[1], 2), vshrq_n_u8(src.val[2], 6)), mask_3f));
+		dst.val[3] = vqtbl4q_u8(lut, vandq_u8(src.val[2], mask_3f));
+		vst4q_u8(out, dst);
+		out += 64;
+		done += 48;
+	}
+	return done;
+}
+
+static long base64_decode_neon(unsigned char *out, const unsigned char *in, long inlen) {
+	const uint8x16x4_t lut_lo = { { vld1q_u8(neon_decode_lut), vld1q_u8(neon_decode_lut + 16), vld1q_u8(neon_decode_lut + 32), vld1q_u8(neon_decode_lut + 48) } };
+	const uint8x16x4_t lut_hi = { { vld1q_u8(neon_decode_lut + 64), vld1q_u8(neon_decode_lut + 80), vld1q_u8(neon_decode_lut + 96), vld1q_u8(neon_decode_lut + 112) } };
+	const uint8x16_t offset = vdupq_n_u8(0x40);
+	long done = 0;
+	// last quad is always left to scalar code for padding
+	while (inlen - done >= 68) {
+		uint8x16x4_t src = vld4q_u8(in + done);
+		uint8x16_t error = vdupq_n_u8(0);
+		for (int i = 0; i < 4; i++) {
+			uint8x16_t c = src.val[i];
+			src.val[i] = vqtbx4q_u8(vqtbl4q_u8(lut_lo, c), lut_hi, veorq_u8(c, offset));
+			error = vorrq_u8(error, vorrq_u8(src.val[i], c));
+		}
+		if (vmaxvq_u8(error) & 0x80)
+			break;
+		uint8x16x3_t dst;
+		dst.val[0] = vorrq_u8(vshlq_n_u8(src.val[0], 2), vshrq_n_u8(src.val[1], 4));
+		dst.val[1] = vorrq_u8(vshlq_n_u8(src.val[1], 4), vshrq_n_u8(src.val[2], 2));
+		dst.val[2] = vorrq_u8(vshlq_n_u8(src.val[2], 6), src.val[3]);
+		vst3q_u8(out, dst);
+		out += 48;
+		done += 64;
+	}
+	return done;
+}
+
+#endif
+
+typedef long (*base64_kernel)(unsigned char *out, const unsigned char *in, long inlen);
+
+static base64_kernel encode_kernel = NULL;
+static base64_kernel decode_kernel = NULL;
+static pthread_once_t kernels_selected = PTHREAD_ONCE_INIT;
+
+// select once by CPU features
+static void init_kernels(void) {
+#if defined(BASE64_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		encode_kernel = base64_encode_avx2;
+		decode_kernel = base64_decode_avx2;
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		encode_kernel = base64_encode_sse;
+		decode_kernel = base64_decode_sse;
+	}
+#elif defined(BASE64_NEON)
+	encode_kernel = base64_encode_neon;
+	decode_kernel = base64_decode_neon;
+#endif
+}
+
+static void select_kernels(void) {
+	pthread_once(&kernels_selected, init_kernels);
+}
+
+/* out size should be at least 4*inlen/3 + 4.
+ * returns length of out (without trailing NULL).
+ */
+long base64_encode(unsigned char *out, const unsigned char *in, long inlen) {
+	select_kernels();
+	long done = encode_kernel ? encode_kernel(out, in, inlen) : 0;
+	return done / 3 * 4 + base64_encode_scalar(out + done / 3 * 4, in + done, inlen - done);
+}
+
+/* base64 should not contain whitespaces.*/
+long base64_decode_fast(unsigned char* out, const unsigned char* in, long inlen) {
+	select_kernels();
+	long done = decode_kernel ? decode_kernel(out, in, inlen) : 0;
+	return done / 4 * 3 + base64_decode_scalar(out + done / 4 * 3, in + done, inlen - done);
+}
+
+
 long base64_decode_fast_nl(unsigned char* out, const unsigned char* in, long inlen) {
 	long outlen = 0;
 	uint8_t b1, b2, b3;
@@ -54,13 +54,15 @@
 
 #define MAX_DEVICES 256
 #define MAX_CLIENTS 256
-#define MAX_BLOBS	32
+#define BLOB_HASH_SIZE	64
 
 #define BUFFER_SIZE	1024
 
+#define DEVICE_HASH_SIZE	512
+
 static indigo_device *devices[MAX_DEVICES];
 static indigo_client *clients[MAX_CLIENTS];
-static indigo_blob_entry *blobs[MAX_BLOBS];
+static indigo_blob_entry *blobs[BLOB_HASH_SIZE];
 
 static pthread_mutex_t bus_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER;
 #define client_mutex bus_mutex
@@ -72,6 +74,95 @@ static pthread_mutex_t blob_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static bool is_started = false;
 
+// BLOB cache is a hash table of entries keyed by item address, chained through entry->next; guarded by blob_mutex.
+
+#define blob_hash(item) ((((uintptr_t)(item)) / sizeof(indigo_item)) % BLOB_HASH_SIZE)
+
+static indigo_blob_entry *find_blob_entry(indigo_item *item) {
+	indigo_blob_entry *entry = blobs[blob_hash(item)];
+	while (entry != NULL && entry->item != item)
+		entry = entry->next;
+	return entry;
+}
+
+// Device registry used for routing of client requests. Local devices are indexed by name in a hash table
+// (chains of slot indexes into devices[], 0 = end of chain), remote protocol adapters ("@ host") are kept
+// in a separate list, because they are routed by suffix rather than by full name.
+
+static int device_hash_heads[DEVICE_HASH_SIZE];
+static int device_hash_next[MAX_DEVICES];
+static unsigned device_hash_keys[MAX_DEVICES];
+static int remote_adapters[MAX_DEVICES];
+static int remote_adapter_count = 0;
+
+static unsigned device_hash(const char *name) {
+	unsigned hash = 2166136261u;
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash & (DEVICE_HASH_SIZE - 1);
+}
+
+static void register_device(int slot) {
+	indigo_device *device = devices[slot];
+	if (*device->name == '@') {
+		remote_adapters[remote_adapter_count++] = slot;
+	} else {
+		unsigned hash = device_hash_keys[slot] = device_hash(device->name);
+		device_hash_next[slot] = device_hash_heads[hash];
+		device_hash_heads[hash] = slot + 1;
+	}
+}
+
+static void unregister_device(int slot) {
+	for (int i = 0; i < remote_adapter_count; i++) {
+		if (remote_adapters[i] == slot) {
+			remote_adapters[i] = remote_adapters[--remote_adapter_count];
+			return;
+		}
+	}
+	int *link = &device_hash_heads[device_hash_keys[slot]];
+	while (*link) {
+		if (*link == slot + 1) {
+			*link = device_hash_next[slot];
+			device_hash_next[slot] = 0;
+			return;
+		}
+		link = &device_hash_next[*link - 1];
+	}
+}
+
+static int route_request(indigo_property *property, int *slots) {
+	int count = 0;
+	if (*property->device == 0) {
+		for (int i = 0; i < MAX_DEVICES; i++)
+			if (devices[i] != NULL)
+				slots[count++] = i;
+		return count;
+	}
+	for (int link = device_hash_heads[device_hash(property->device)]; link; link = device_hash_next[link - 1]) {
+		indigo_device *device = devices[link - 1];
+		if (device != NULL && !strcmp(property->device, device->name))
+			slots[count++] = link - 1;
+	}
+	for (int i = 0; i < remote_adapter_count; i++) {
+		indigo_device *device = devices[remote_adapters[i]];
+		if (!indigo_use_host_suffix || strstr(property->device, device->name))
+			slots[count++] = remote_adapters[i];
+	}
+	// keep attach order, devices are notified in the same order as on broadcast
+	for (int i = 1; i < count; i++) {
+		int slot = slots[i], j = i;
+		while (j > 0 && slots[j - 1] > slot) {
+			slots[j] = slots[j - 1];
+			j--;
+		}
+		slots[j] = slot;
+	}
+	return count;
+}
+
 char *indigo_property_type_text[] = {
 	"UNDEFINED",
 	"TEXT",
@@ -331,7 +422,10 @@ indigo_result indigo_start() {
 	if (!is_started) {
 		memset(devices, 0, MAX_DEVICES * sizeof(indigo_device *));
 		memset(clients, 0, MAX_CLIENTS * sizeof(indigo_client *));
-		memset(blobs, 0, MAX_BLOBS * sizeof(indigo_property *));
+		memset(blobs, 0, sizeof(blobs));
+		memset(device_hash_heads, 0, sizeof(device_hash_heads));
+		memset(device_hash_next, 0, sizeof(device_hash_next));
+		remote_adapter_count = 0;
 		memset(&INDIGO_ALL_PROPERTIES, 0, sizeof(INDIGO_ALL_PROPERTIES));
 		is_started = true;
 	}
@@ -352,6 +446,7 @@ indigo_result indigo_attach_device(indigo_device *device) {
 	for (int i = 0; i < MAX_DEVICES; i++) {
 		if (devices[i] == NULL) {
 			devices[i] = device;
+			register_device(i);
 			pthread_mutex_unlock(&device_mutex);
 			if (device->attach != NULL)
 				device->last_result = device->attach(device);
@@ -393,6 +488,7 @@ indigo_result indigo_detach_device(indigo_device *device) {
 		if (devices[i] == device) {
 			if (device->detach != NULL)
 				device->last_result = device->detach(device);
+			unregister_device(i);
 			devices[i] = NULL;
 			pthread_mutex_unlock(&device_mutex);
 			return INDIGO_OK;
@@ -425,16 +521,12 @@ indigo_result indigo_enumerate_properties(indigo_client *client, indigo_property
 	if (indigo_use_strict_locking)
 		pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace_property("INDIGO Bus: property enumeration request", property, false, true));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		indigo_device *device = devices[i];
-		if (device != NULL && device->enumerate_properties != NULL) {
-			bool route = *property->device == 0;
-			route = route || !strcmp(property->device, device->name);
-			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
-			route = route || (!indigo_use_host_suffix && *device->name == '@');
-			if (route)
-				device->last_result = device->enumerate_properties(device, client, property);
-		}
+	int slots[MAX_DEVICES];
+	int count = route_request(property, slots);
+	for (int i = 0; i < count; i++) {
+		indigo_device *device = devices[slots[i]];
+		if (device != NULL && device->enumerate_properties != NULL)
+			device->last_result = device->enumerate_properties(device, client, property);
 	}
 	if (indigo_use_strict_locking)
 		pthread_mutex_unlock(&device_mutex);
@@ -447,16 +539,12 @@ indigo_result indigo_change_property(indigo_client *client, indigo_property *pro
 	if (indigo_use_strict_locking)
 		pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace_property("INDIGO Bus: property change request", property, false, true));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		indigo_device *device = devices[i];
-		if (device != NULL && device->change_property != NULL) {
-			bool route = *property->device == 0;
-			route = route || !strcmp(property->device, device->name);
-			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
-			route = route || (!indigo_use_host_suffix && *device->name == '@');
-			if (route)
-				device->last_result = device->change_property(device, client, property);
-		}
+	int slots[MAX_DEVICES];
+	int count = route_request(property, slots);
+	for (int i = 0; i < count; i++) {
+		indigo_device *device = devices[slots[i]];
+		if (device != NULL && device->change_property != NULL)
+			device->last_result = device->change_property(device, client, property);
 	}
 	if (indigo_use_strict_locking)
 		pthread_mutex_unlock(&device_mutex);
@@ -469,16 +557,12 @@ indigo_result indigo_enable_blob(indigo_client *client, indigo_property *propert
 	if (indigo_use_strict_locking)
 		pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace_property("INDIGO Bus: enable BLOB mode change request", property, false, true));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		indigo_device *device = devices[i];
-		if (device != NULL && device->enable_blob != NULL) {
-			bool route = *property->device == 0;
-			route = route || !strcmp(property->device, device->name);
-			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
-			route = route || (!indigo_use_host_suffix && *device->name == '@');
-			if (route)
-				device->last_result = device->enable_blob(device, client, property, mode);
-		}
+	int slots[MAX_DEVICES];
+	int count = route_request(property, slots);
+	for (int i = 0; i < count; i++) {
+		indigo_device *device = devices[slots[i]];
+		if (device != NULL && device->enable_blob != NULL)
+			device->last_result = device->enable_blob(device, client, property, mode);
 	}
 	if (indigo_use_strict_locking)
 		pthread_mutex_unlock(&device_mutex);
@@ -527,37 +611,52 @@ indigo_result indigo_update_property(indigo_device *device, indigo_property *pro
 			vsnprintf(message, INDIGO_VALUE_SIZE, format, args);
 			va_end(args);
 		}
+		if (property->type == INDIGO_BLOB_VECTOR) {
+			for (int i = 0; i < property->count; i++) {
+				indigo_item *item = property->items + i;
+				if (item->blob.buffer != NULL && !indigo_blob_buffer_contains(item->blob.buffer, item->blob.value, item->blob.size)) {
+					// value was repointed without updating shared buffer, it must be copied instead
+					indigo_error("%s.%s.%s: BLOB value is outside of its shared buffer, buffer detached", property->device, property->name, item->name);
+					indigo_release_blob_buffer(item->blob.buffer);
+					item->blob.buffer = NULL;
+				}
+			}
+		}
 		if (indigo_use_blob_caching && property->type == INDIGO_BLOB_VECTOR && property->state == INDIGO_OK_STATE) {
 			pthread_mutex_lock(&blob_mutex);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = property->items + i;
-				indigo_blob_entry *entry = NULL;
-				int free_index = -1;
-				for (int j = 0; j < MAX_BLOBS; j++) {
-					entry = blobs[j];
-					if (entry && entry->item == item) {
-						break;
-					}
-					if (entry == NULL && free_index == -1)
-						free_index = j;
-					entry = NULL;
-				}
-				if (entry == NULL && free_index >= 0) {
-					blobs[free_index] = entry = malloc(sizeof(indigo_blob_entry));
+				indigo_blob_entry *entry = find_blob_entry(item);
+				if (entry == NULL) {
+					entry = malloc(sizeof(indigo_blob_entry));
+					assert(entry != NULL);
 					memset(entry, 0, sizeof(indigo_blob_entry));
 					entry->item = item;
 					pthread_mutex_init(&entry->mutext, NULL);
+					entry->next = blobs[blob_hash(item)];
+					blobs[blob_hash(item)] = entry;
 				}
-				if (entry) {
-					entry->content = realloc(entry->content, entry->size = item->blob.size);
-					memcpy(entry->content, item->blob.value, entry->size);
-					strcpy(entry->format, item->blob.format);
+				pthread_mutex_lock(&entry->mutext);
+				indigo_blob_buffer *buffer = entry->buffer;
+				if (item->blob.buffer != NULL) {
+					entry->buffer = indigo_retain_blob_buffer(item->blob.buffer);
+					entry->content = item->blob.value;
 				} else {
-					pthread_mutex_unlock(&blob_mutex);
-					if (indigo_use_strict_locking)
-						pthread_mutex_unlock(&client_mutex);
-					return INDIGO_TOO_MANY_ELEMENTS;
+					// driver owns value and may overwrite it, keep a private copy (reuse previous one if nobody else reads it)
+					if (buffer != NULL && buffer->reference_count == 1 && buffer->size >= item->blob.size) {
+						entry->buffer = buffer;
+						buffer = NULL;
+					} else {
+						entry->buffer = indigo_alloc_shared_blob_buffer(item->blob.size);
+					}
+					memcpy(entry->buffer->content, item->blob.value, item->blob.size);
+					entry->content = entry->buffer->content;
 				}
+				entry->size = item->blob.size;
+				strcpy(entry->format, item->blob.format);
+				if (buffer != NULL)
+					indigo_release_blob_buffer(buffer);
+				pthread_mutex_unlock(&entry->mutext);
 			}
 			pthread_mutex_unlock(&blob_mutex);
 		}
@@ -765,19 +864,20 @@ void indigo_release_property(indigo_property *property) {
 		pthread_mutex_lock(&blob_mutex);
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = property->items + i;
-			for (int j = 0; j < MAX_BLOBS; j++) {
-				indigo_blob_entry *entry = blobs[j];
-				if (entry && entry->item == item) {
+			indigo_blob_entry **link = &blobs[blob_hash(item)];
+			while (*link != NULL) {
+				indigo_blob_entry *entry = *link;
+				if (entry->item == item) {
+					*link = entry->next;
 					pthread_mutex_lock(&entry->mutext);
-					if (entry->content) {
-						free(entry->content);
-					}
+					if (entry->buffer != NULL)
+						indigo_release_blob_buffer(entry->buffer);
 					pthread_mutex_unlock(&entry->mutext);
 					pthread_mutex_destroy(&entry->mutext);
 					free(entry);
-					blobs[j] = NULL;
 					break;
 				}
+				link = &entry->next;
 			}
 		}
 		pthread_mutex_unlock(&blob_mutex);
@@ -785,13 +885,23 @@ void indigo_release_property(indigo_property *property) {
 	free(property);
 }
 
-indigo_blob_entry *indigo_validate_blob(indigo_item *item) {
-	for (int j = 0; j < MAX_BLOBS; j++) {
-		indigo_blob_entry *entry = blobs[j];
-		if (entry && entry->item == item)
-			return entry;
+bool indigo_retain_blob(indigo_item *item, indigo_blob_entry *entry) {
+	pthread_mutex_lock(&blob_mutex);
+	indigo_blob_entry *cached = find_blob_entry(item);
+	if (cached != NULL) {
+		*entry = *cached;
+		entry->next = NULL;
+		indigo_retain_blob_buffer(entry->buffer);
 	}
-	return NULL;
+	pthread_mutex_unlock(&blob_mutex);
+	return cached != NULL;
+}
+
+indigo_blob_entry *indigo_validate_blob(indigo_item *item) {
+	pthread_mutex_lock(&blob_mutex);
+	indigo_blob_entry *entry = find_blob_entry(item);
+	pthread_mutex_unlock(&blob_mutex);
+	return entry;
 }
 
 void indigo_init_text_item(indigo_item *item, const char *name, const char *label, const char *format, ...) {
@@ -853,6 +963,35 @@ void *indigo_alloc_blob_buffer(long size) {
 	return malloc(size);
 }
 
+indigo_blob_buffer *indigo_alloc_shared_blob_buffer(long size) {
+	indigo_blob_buffer *buffer = malloc(sizeof(indigo_blob_buffer));
+	assert(buffer != NULL);
+	buffer->content = indigo_alloc_blob_buffer(size);
+	assert(buffer->content != NULL);
+	buffer->size = size;
+	buffer->reference_count = 1;
+	return buffer;
+}
+
+indigo_blob_buffer *indigo_retain_blob_buffer(indigo_blob_buffer *buffer) {
+	assert(buffer != NULL);
+	__atomic_add_fetch(&buffer->reference_count, 1, __ATOMIC_RELAXED);
+	return buffer;
+}
+
+bool indigo_blob_buffer_contains(indigo_blob_buffer *buffer, const void *data, long size) {
+	const char *content = buffer->content;
+	return data != NULL && size >= 0 && (const char *)data >= content && size <= buffer->size - ((const char *)data - content);
+}
+
+void indigo_release_blob_buffer(indigo_blob_buffer *buffer) {
+	assert(buffer != NULL);
+	if (__atomic_sub_fetch(&buffer->reference_count, 1, __ATOMIC_ACQ_REL) == 0) {
+		free(buffer->content);
+		free(buffer);
+	}
+}
+
 bool indigo_populate_http_blob_item(indigo_item *blob_item) {
 	char host[BUFFER_SIZE] = {0};
 	int port = 80;
@@ -1160,6 +1299,109 @@ bool indigo_async(void *fun(void *data), void *data) {
 	return false;
 }
 
+// parallel jobs are queued and their chunks are claimed under pool_mutex by worker threads and by the caller
+
+#define PARALLEL_MAX_THREADS	16
+#define PARALLEL_MIN_CHUNK		4096
+
+typedef struct parallel_job {
+	void (*worker)(void *data, long from, long to);
+	void *data;
+	long count;
+	long chunk;
+	long next;
+	int pending;
+	struct parallel_job *next_job;
+} parallel_job;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done_cond = PTHREAD_COND_INITIALIZER;
+static parallel_job *pool_jobs = NULL;
+static int pool_size = -1;
+
+// call with pool_mutex locked, job must have unclaimed chunk
+static void run_chunk(parallel_job *job) {
+	long from = job->next;
+	long to = from + job->chunk < job->count ? from + job->chunk : job->count;
+	job->next = to;
+	if (to == job->count) {
+		for (parallel_job **link = &pool_jobs; *link; link = &(*link)->next_job) {
+			if (*link == job) {
+				*link = job->next_job;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&pool_mutex);
+	job->worker(job->data, from, to);
+	pthread_mutex_lock(&pool_mutex);
+	if (--job->pending == 0)
+		pthread_cond_broadcast(&pool_done_cond);
+}
+
+static void *pool_thread(void *data) {
+	pthread_mutex_lock(&pool_mutex);
+	while (true) {
+		while (pool_jobs == NULL)
+			pthread_cond_wait(&pool_cond, &pool_mutex);
+		run_chunk(pool_jobs);
+	}
+	return NULL;
+}
+
+// call with pool_mutex locked
+static void start_pool(void) {
+	long cores = 1;
+#if defined(INDIGO_WINDOWS)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	cores = info.dwNumberOfProcessors;
+#else
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	pool_size = 0;
+	for (long i = 1; i < cores && i < PARALLEL_MAX_THREADS; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, pool_thread, NULL) == 0) {
+			pthread_detach(thread);
+			pool_size++;
+		}
+	}
+	INDIGO_TRACE(indigo_trace("Parallel pool with %d threads started", pool_size));
+}
+
+void indigo_parallel(void (*worker)(void *data, long from, long to), void *data, long count) {
+	if (count <= PARALLEL_MIN_CHUNK) {
+		if (count > 0)
+			worker(data, 0, count);
+		return;
+	}
+	pthread_mutex_lock(&pool_mutex);
+	if (pool_size == -1)
+		start_pool();
+	if (pool_size == 0) {
+		pthread_mutex_unlock(&pool_mutex);
+		worker(data, 0, count);
+		return;
+	}
+	// few chunks per thread to balance uneven load
+	long chunk = (count + 4 * (pool_size + 1) - 1) / (4 * (pool_size + 1));
+	if (chunk < PARALLEL_MIN_CHUNK)
+		chunk = PARALLEL_MIN_CHUNK;
+	parallel_job job = { worker, data, count, chunk, 0, (int)((count + chunk - 1) / chunk), NULL };
+	parallel_job **tail = &pool_jobs;
+	while (*tail)
+		tail = &(*tail)->next_job;
+	*tail = &job;
+	pthread_cond_broadcast(&pool_cond);
+	while (job.next < job.count)
+		run_chunk(&job);
+	while (job.pending)
+		pthread_cond_wait(&pool_done_cond, &pool_mutex);
+	pthread_mutex_unlock(&pool_mutex);
+}
+
 double indigo_stod(char *string) {
 	char copy[128];
 	strncpy(copy, string, 128);
@@ -23,8 +23,13 @@
  \file indigo_ccd_driver.c
  */
 
+#if defined(INDIGO_LINUX)
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <assert.h>
 #include <string.h>
@@ -33,9 +38,17 @@
 #include <time.h>
 #include <math.h>
 #include <fcntl.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <limits.h>
+#include <dirent.h>
 #include <sys/stat.h>
 #include <jpeglib.h>
 
+#if defined(INDIGO_LIBJPEG_TURBO) && !defined(LIBJPEG_TURBO_VERSION)
+#error "LIBJPEG=turbo, but jpeglib.h is not from libjpeg-turbo (stale bundled headers in BUILD_INCLUDE?)"
+#endif
+
 #include <indigo/indigo_ccd_driver.h>
 #include <indigo/indigo_io.h>
 
@@ -64,12 +77,646 @@ void indigo_use_shortest_exposure_if_bias(indigo_device *device) {
 	}
 }
 
+// Frame buffer pool, frames are processed by a per device thread in the order they were queued.
+// Buffers are shared BLOB buffers, the last published one is held by CCD_IMAGE item (and BLOB cache),
+// so it is reused only after it is replaced by the next frame (one frame published, one processed, one read out)
+
+#define FRAME_POOL_SIZE			3
+
+typedef struct {
+	char name[16];
+	char string[80];
+	char comment[80];
+} indigo_ccd_frame_keyword_text;
+
+typedef struct indigo_ccd_frame {
+	indigo_blob_buffer *buffer;
+	bool in_use;
+	int frame_width, frame_height, bpp;
+	bool little_endian, byte_order_rgb;
+	indigo_fits_keyword *keywords;
+	indigo_ccd_frame_keyword_text *keyword_text;
+	int keyword_capacity;
+	struct indigo_ccd_frame *next;
+} indigo_ccd_frame;
+
+struct indigo_ccd_frame_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t thread;
+	bool thread_running;
+	bool stop;
+	int pending;
+	indigo_ccd_frame *queue_head, *queue_tail;
+	indigo_ccd_frame frames[FRAME_POOL_SIZE];
+};
+
+static indigo_ccd_frame_pool *frame_pool(indigo_device *device) {
+	if (CCD_CONTEXT->frame_pool == NULL) {
+		indigo_ccd_frame_pool *pool = malloc(sizeof(indigo_ccd_frame_pool));
+		assert(pool != NULL);
+		memset(pool, 0, sizeof(indigo_ccd_frame_pool));
+		pthread_mutex_init(&pool->mutex, NULL);
+		pthread_cond_init(&pool->cond, NULL);
+		CCD_CONTEXT->frame_pool = pool;
+	}
+	return CCD_CONTEXT->frame_pool;
+}
+
+static indigo_ccd_frame *find_frame(indigo_ccd_frame_pool *pool, void *buffer) {
+	for (int i = 0; i < FRAME_POOL_SIZE; i++) {
+		if (pool->frames[i].in_use && pool->frames[i].buffer->content == buffer)
+			return pool->frames + i;
+	}
+	return NULL;
+}
+
+// shared buffer of acquired frame the value points into, NULL if it is not a frame pool buffer
+
+static indigo_blob_buffer *frame_pool_buffer(indigo_device *device, void *value) {
+	indigo_ccd_frame_pool *pool = CCD_CONTEXT->frame_pool;
+	indigo_blob_buffer *buffer = NULL;
+	if (pool == NULL)
+		return NULL;
+	pthread_mutex_lock(&pool->mutex);
+	for (int i = 0; i < FRAME_POOL_SIZE; i++) {
+		indigo_ccd_frame *frame = pool->frames + i;
+		if (frame->in_use && (char *)value >= (char *)frame->buffer->content && (char *)value < (char *)frame->buffer->content + frame->buffer->size) {
+			buffer = frame->buffer;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return buffer;
+}
+
+// BLOB item holds reference to shared buffer its value points into, so it is not reused or freed while published
+
+static void set_blob_buffer(indigo_item *item, indigo_blob_buffer *buffer) {
+	if (item->blob.buffer != NULL)
+		indigo_release_blob_buffer(item->blob.buffer);
+	item->blob.buffer = buffer ? indigo_retain_blob_buffer(buffer) : NULL;
+}
+
+// 2 = buffer can be reused, 1 = buffer is missing or too small, 0 = buffer is still held by a client
+
+static inline int frame_score(indigo_ccd_frame *frame, long size) {
+	if (frame->buffer == NULL)
+		return 1;
+	if (__atomic_load_n(&frame->buffer->reference_count, __ATOMIC_ACQUIRE) > 1)
+		return 0;
+	return frame->buffer->size >= size ? 2 : 1;
+}
+
+static void *frame_pool_thread(indigo_device *device) {
+	indigo_ccd_frame_pool *pool = CCD_CONTEXT->frame_pool;
+	pthread_mutex_lock(&pool->mutex);
+	while (true) {
+		while (pool->queue_head == NULL && !pool->stop)
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+		indigo_ccd_frame *frame = pool->queue_head;
+		if (frame == NULL)
+			break;
+		if ((pool->queue_head = frame->next) == NULL)
+			pool->queue_tail = NULL;
+		pthread_mutex_unlock(&pool->mutex);
+		indigo_process_image(device, frame->buffer->content, frame->frame_width, frame->frame_height, frame->bpp, frame->little_endian, frame->byte_order_rgb, frame->keywords && frame->keywords->type ? frame->keywords : NULL);
+		pthread_mutex_lock(&pool->mutex);
+		frame->in_use = false;
+		pool->pending--;
+		pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+void *indigo_ccd_acquire_frame_buffer(indigo_device *device, long size) {
+	assert(device != NULL);
+	indigo_ccd_frame_pool *pool = frame_pool(device);
+	pthread_mutex_lock(&pool->mutex);
+	indigo_ccd_frame *frame = NULL;
+	int score = -1;
+	while (true) {
+		for (int i = 0; i < FRAME_POOL_SIZE; i++) {
+			indigo_ccd_frame *candidate = pool->frames + i;
+			if (!candidate->in_use && frame_score(candidate, size) > score) {
+				frame = candidate;
+				score = frame_score(candidate, size);
+			}
+		}
+		// published buffer is released when queued frame is processed, so it is worth to wait for it
+		if (score > 0 || (frame && pool->pending == 0))
+			break;
+		frame = NULL;
+		score = -1;
+		pthread_cond_wait(&pool->cond, &pool->mutex);
+	}
+	// buffer still referenced by a client or too small is left to its holders and replaced
+	if (score < 2) {
+		if (frame->buffer)
+			indigo_release_blob_buffer(frame->buffer);
+		frame->buffer = indigo_alloc_shared_blob_buffer(size);
+	}
+	frame->in_use = true;
+	pthread_mutex_unlock(&pool->mutex);
+	return frame->buffer->content;
+}
+
+void indigo_ccd_release_frame_buffer(indigo_device *device, void *buffer) {
+	assert(device != NULL);
+	indigo_ccd_frame_pool *pool = frame_pool(device);
+	pthread_mutex_lock(&pool->mutex);
+	indigo_ccd_frame *frame = find_frame(pool, buffer);
+	if (frame) {
+		frame->in_use = false;
+		pthread_cond_broadcast(&pool->cond);
+	} else {
+		indigo_error("%s: %p is not acquired frame buffer", device->name, buffer);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void indigo_ccd_process_frame_buffer(indigo_device *device, void *buffer, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords) {
+	assert(device != NULL);
+	indigo_ccd_frame_pool *pool = frame_pool(device);
+	pthread_mutex_lock(&pool->mutex);
+	indigo_ccd_frame *frame = find_frame(pool, buffer);
+	if (frame == NULL) {
+		pthread_mutex_unlock(&pool->mutex);
+		indigo_error("%s: %p is not acquired frame buffer", device->name, buffer);
+		return;
+	}
+	frame->frame_width = frame_width;
+	frame->frame_height = frame_height;
+	frame->bpp = bpp;
+	frame->little_endian = little_endian;
+	frame->byte_order_rgb = byte_order_rgb;
+	// keywords usually live on caller's stack, so both array and strings are copied (storage grows with the longest list)
+	int count = 0;
+	while (keywords && keywords[count].type)
+		count++;
+	if (count + 1 > frame->keyword_capacity) {
+		frame->keywords = realloc(frame->keywords, (count + 1) * sizeof(indigo_fits_keyword));
+		frame->keyword_text = realloc(frame->keyword_text, (count + 1) * sizeof(indigo_ccd_frame_keyword_text));
+		assert(frame->keywords != NULL && frame->keyword_text != NULL);
+		frame->keyword_capacity = count + 1;
+	}
+	for (int i = 0; i < count; i++) {
+		indigo_fits_keyword *keyword = frame->keywords + i;
+		indigo_ccd_frame_keyword_text *text = frame->keyword_text + i;
+		*keyword = keywords[i];
+		snprintf(text->name, sizeof(text->name), "%s", keywords[i].name);
+		keyword->name = text->name;
+		if (keyword->comment) {
+			snprintf(text->comment, sizeof(text->comment), "%s", keywords[i].comment);
+			keyword->comment = text->comment;
+		}
+		if (keyword->type == INDIGO_FITS_STRING) {
+			snprintf(text->string, sizeof(text->string), "%s", keywords[i].string);
+			keyword->string = text->string;
+		}
+	}
+	frame->keywords[count].type = 0;
+	if (!pool->thread_running) {
+		if (pthread_create(&pool->thread, NULL, (void *(*)(void *))frame_pool_thread, device) == 0) {
+			pool->thread_running = true;
+		} else {
+			pthread_mutex_unlock(&pool->mutex);
+			indigo_error("%s: failed to start frame processing thread", device->name);
+			indigo_process_image(device, buffer, frame_width, frame_height, bpp, little_endian, byte_order_rgb, keywords);
+			indigo_ccd_release_frame_buffer(device, buffer);
+			return;
+		}
+	}
+	frame->next = NULL;
+	if (pool->queue_tail)
+		pool->queue_tail->next = frame;
+	else
+		pool->queue_head = frame;
+	pool->queue_tail = frame;
+	pool->pending++;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void indigo_ccd_flush_frame_buffers(indigo_device *device) {
+	assert(device != NULL);
+	if (CCD_CONTEXT->frame_pool == NULL)
+		return;
+	indigo_ccd_frame_pool *pool = CCD_CONTEXT->frame_pool;
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending > 0)
+		pthread_cond_wait(&pool->cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+static void release_frame_pool(indigo_device *device) {
+	indigo_ccd_frame_pool *pool = CCD_CONTEXT->frame_pool;
+	if (pool == NULL)
+		return;
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+	if (pool->thread_running)
+		pthread_join(pool->thread, NULL);
+	for (int i = 0; i < FRAME_POOL_SIZE; i++) {
+		if (pool->frames[i].buffer)
+			indigo_release_blob_buffer(pool->frames[i].buffer);
+		free(pool->frames[i].keywords);
+		free(pool->frames[i].keyword_text);
+	}
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool);
+	CCD_CONTEXT->frame_pool = NULL;
+}
+
+// FITS keyword registry, keywords are formatted to FITS cards when set, so they are just copied to each image header
+
+#define FITS_CARD_SIZE		80
+#define FITS_BLOCK_SIZE		2880
+
+typedef struct {
+	char name[9];
+	char card[FITS_CARD_SIZE];
+} indigo_ccd_fits_card;
+
+struct indigo_ccd_fits_keywords {
+	pthread_mutex_t mutex;
+	indigo_ccd_fits_card *cards;
+	int count;
+	int capacity;
+};
+
+static void format_fits_card(char *card, const char *name, const char *value, const char *comment) {
+	char line[FITS_CARD_SIZE + 1];
+	int length;
+	if (comment && *comment)
+		length = snprintf(line, sizeof(line), "%-8.8s= %s / %s", name, value, comment);
+	else
+		length = snprintf(line, sizeof(line), "%-8.8s= %s", name, value);
+	if (length > FITS_CARD_SIZE)
+		length = FITS_CARD_SIZE;
+	memcpy(card, line, length);
+	memset(card + length, ' ', FITS_CARD_SIZE - length);
+}
+
+static void format_fits_number(char *card, const char *name, double number, int precision, const char *comment) {
+	char value[32];
+	if (precision < 0)
+		snprintf(value, sizeof(value), "%20f", number);
+	else
+		snprintf(value, sizeof(value), "%20.*f", precision, number);
+	indigo_fix_locale(value);
+	format_fits_card(card, name, value, comment);
+}
+
+static void format_fits_string(char *card, const char *name, const char *string, const char *comment) {
+	// quotes are doubled, value is padded to 20 characters like numbers
+	char value[FITS_CARD_SIZE + 1], *pnt = value;
+	*pnt++ = '\'';
+	while (*string && pnt - value < FITS_CARD_SIZE - 12) {
+		if (*string == '\'')
+			*pnt++ = '\'';
+		*pnt++ = *string++;
+	}
+	*pnt++ = '\'';
+	while (pnt - value < 20)
+		*pnt++ = ' ';
+	*pnt = 0;
+	format_fits_card(card, name, value, comment);
+}
+
+static void format_fits_logical(char *card, const char *name, bool logical, const char *comment) {
+	format_fits_card(card, name, logical ? "                   T" : "                   F", comment);
+}
+
+static void format_fits_text(char *card, const char *text) {
+	long length = strlen(text);
+	if (length > FITS_CARD_SIZE)
+		length = FITS_CARD_SIZE;
+	memcpy(card, text, length);
+	memset(card + length, ' ', FITS_CARD_SIZE - length);
+}
+
+static void format_fits_keyword(char *card, indigo_fits_keyword *keyword) {
+	switch (keyword->type) {
+		case INDIGO_FITS_NUMBER:
+			format_fits_number(card, keyword->name, keyword->number, -1, keyword->comment);
+			break;
+		case INDIGO_FITS_STRING:
+			format_fits_string(card, keyword->name, keyword->string, keyword->comment);
+			break;
+		case INDIGO_FITS_LOGICAL:
+			format_fits_logical(card, keyword->name, keyword->logical, keyword->comment);
+			break;
+	}
+}
+
+static indigo_ccd_fits_keywords *fits_keywords(indigo_device *device) {
+	if (CCD_CONTEXT->fits_keywords == NULL) {
+		indigo_ccd_fits_keywords *keywords = malloc(sizeof(indigo_ccd_fits_keywords));
+		assert(keywords != NULL);
+		memset(keywords, 0, sizeof(indigo_ccd_fits_keywords));
+		pthread_mutex_init(&keywords->mutex, NULL);
+		CCD_CONTEXT->fits_keywords = keywords;
+	}
+	return CCD_CONTEXT->fits_keywords;
+}
+
+void indigo_ccd_set_fits_keyword(indigo_device *device, indigo_fits_keyword *keyword) {
+	assert(device != NULL);
+	assert(keyword != NULL && keyword->name != NULL);
+	indigo_ccd_fits_keywords *keywords = fits_keywords(device);
+	pthread_mutex_lock(&keywords->mutex);
+	indigo_ccd_fits_card *card = NULL;
+	for (int i = 0; i < keywords->count; i++) {
+		if (!strncmp(keywords->cards[i].name, keyword->name, 8)) {
+			card = keywords->cards + i;
+			break;
+		}
+	}
+	if (card == NULL) {
+		if (keywords->count == keywords->capacity) {
+			keywords->capacity = keywords->capacity ? 2 * keywords->capacity : 16;
+			keywords->cards = realloc(keywords->cards, keywords->capacity * sizeof(indigo_ccd_fits_card));
+			assert(keywords->cards != NULL);
+		}
+		card = keywords->cards + keywords->count++;
+		strncpy(card->name, keyword->name, 8);
+		card->name[8] = 0;
+	}
+	format_fits_keyword(card->card, keyword);
+	pthread_mutex_unlock(&keywords->mutex);
+}
+
+void indigo_ccd_remove_fits_keyword(indigo_device *device, const char *name) {
+	assert(device != NULL);
+	if (CCD_CONTEXT->fits_keywords == NULL)
+		return;
+	indigo_ccd_fits_keywords *keywords = CCD_CONTEXT->fits_keywords;
+	pthread_mutex_lock(&keywords->mutex);
+	for (int i = 0; i < keywords->count; i++) {
+		if (!strncmp(keywords->cards[i].name, name, 8)) {
+			memmove(keywords->cards + i, keywords->cards + i + 1, (keywords->count - i - 1) * sizeof(indigo_ccd_fits_card));
+			keywords->count--;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&keywords->mutex);
+}
+
+void indigo_ccd_clear_fits_keywords(indigo_device *device) {
+	assert(device != NULL);
+	if (CCD_CONTEXT->fits_keywords == NULL)
+		return;
+	pthread_mutex_lock(&CCD_CONTEXT->fits_keywords->mutex);
+	CCD_CONTEXT->fits_keywords->count = 0;
+	pthread_mutex_unlock(&CCD_CONTEXT->fits_keywords->mutex);
+}
+
+static void release_fits_keywords(indigo_device *device) {
+	indigo_ccd_fits_keywords *keywords = CCD_CONTEXT->fits_keywords;
+	if (keywords == NULL)
+		return;
+	pthread_mutex_destroy(&keywords->mutex);
+	free(keywords->cards);
+	free(keywords);
+	CCD_CONTEXT->fits_keywords = NULL;
+}
+
+// Local image writer, files are written by a single background thread, so slow media doesn't block exposure loop
+
+#define IMAGE_WRITER_QUEUE_LIMIT	(256L * 1024 * 1024)
+#define IMAGE_WRITER_ALIGNMENT		4096
+
+indigo_ccd_write_policy indigo_ccd_local_write_policy = INDIGO_CCD_WRITE_BUFFERED;
+
+typedef struct image_write_job {
+	indigo_device *device;
+	int handle;
+	bool direct;
+	char file_name[INDIGO_VALUE_SIZE];
+	void *content;
+	long size;
+	struct image_write_job *next;
+} image_write_job;
+
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+static image_write_job *writer_head = NULL, *writer_tail = NULL;
+static indigo_device *writer_device = NULL;
+static long writer_queued = 0;
+static bool writer_running = false;
+
+static void write_image_file(image_write_job *job) {
+	indigo_device *device = job->device;
+	INDIGO_DEBUG(clock_t start = clock());
+	char *message = NULL;
+	long length = job->size;
+	if (job->direct)
+		length = (length + IMAGE_WRITER_ALIGNMENT - 1) / IMAGE_WRITER_ALIGNMENT * IMAGE_WRITER_ALIGNMENT;
+#ifdef INDIGO_LINUX
+	// preallocation is just a hint for the filesystem, not supported everywhere
+	posix_fallocate(job->handle, 0, length);
+#endif
+	if (!indigo_write(job->handle, job->content, length)) {
+		message = strerror(errno);
+	} else if (length != job->size && ftruncate(job->handle, job->size)) {
+		message = strerror(errno);
+	} else if (indigo_ccd_local_write_policy != INDIGO_CCD_WRITE_BUFFERED) {
+#ifdef INDIGO_LINUX
+		if (fdatasync(job->handle))
+			message = strerror(errno);
+#else
+		if (fsync(job->handle))
+			message = strerror(errno);
+#endif
+	}
+	close(job->handle);
+	strncpy(CCD_IMAGE_FILE_ITEM->text.value, job->file_name, INDIGO_VALUE_SIZE);
+	CCD_IMAGE_FILE_PROPERTY->state = message ? INDIGO_ALERT_STATE : INDIGO_OK_STATE;
+	indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
+	INDIGO_DEBUG(indigo_debug("Local save of %s in %gs", job->file_name, (clock() - start) / (double)CLOCKS_PER_SEC));
+}
+
+static void *image_writer_thread(void *arg) {
+	pthread_mutex_lock(&writer_mutex);
+	while (true) {
+		while (writer_head == NULL)
+			pthread_cond_wait(&writer_cond, &writer_mutex);
+		image_write_job *job = writer_head;
+		if ((writer_head = job->next) == NULL)
+			writer_tail = NULL;
+		writer_device = job->device;
+		pthread_mutex_unlock(&writer_mutex);
+		write_image_file(job);
+		pthread_mutex_lock(&writer_mutex);
+		writer_device = NULL;
+		writer_queued -= job->size;
+		pthread_cond_broadcast(&writer_cond);
+		free(job->content);
+		free(job);
+	}
+	return NULL;
+}
+
+static int open_image_file(const char *file_name, bool exclusive, bool *direct) {
+	*direct = false;
+	int handle = open(file_name, O_WRONLY | O_CREAT | (exclusive ? O_EXCL : O_TRUNC), 0644);
+	if (handle >= 0 && indigo_ccd_local_write_policy == INDIGO_CCD_WRITE_DIRECT) {
+#ifdef O_DIRECT
+		// O_DIRECT is set after open, so file is not left behind if filesystem doesn't support it
+		int flags = fcntl(handle, F_GETFL);
+		*direct = flags >= 0 && fcntl(handle, F_SETFL, flags | O_DIRECT) == 0;
+#endif
+#ifdef F_NOCACHE
+		fcntl(handle, F_NOCACHE, 1);
+#endif
+	}
+	return handle;
+}
+
+// Sequential file names, directory is scanned once for the highest used index, then index is cached in device context
+
+static int scan_file_index(const char *head, const char *tail) {
+	char dir_name[INDIGO_VALUE_SIZE];
+	strncpy(dir_name, head, INDIGO_VALUE_SIZE);
+	char *separator = strrchr(dir_name, '/');
+	const char *name = head;
+	if (separator) {
+		name = head + (separator - dir_name) + 1;
+		separator[1] = 0;
+	} else {
+		strcpy(dir_name, ".");
+	}
+	int index = 0;
+	DIR *dir = opendir(dir_name);
+	if (dir) {
+		size_t name_length = strlen(name);
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			if (strncmp(entry->d_name, name, name_length) || !isdigit(entry->d_name[name_length]))
+				continue;
+			char *end;
+			long i = strtol(entry->d_name + name_length, &end, 10);
+			if (!strcmp(end, tail) && i > index && i < INT_MAX)
+				index = (int)i;
+		}
+		closedir(dir);
+	}
+	return index;
+}
+
+static int open_sequential_image_file(indigo_device *device, const char *head, int digits, const char *tail, char *file_name, bool *direct) {
+	char pattern[INDIGO_VALUE_SIZE];
+	if (snprintf(pattern, sizeof(pattern), "%s%%0%dd%s", head, digits, tail) >= (int)sizeof(pattern)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	if (strcmp(pattern, CCD_CONTEXT->file_name_pattern)) {
+		strcpy(CCD_CONTEXT->file_name_pattern, pattern);
+		CCD_CONTEXT->file_name_index = scan_file_index(head, tail);
+	}
+	while (true) {
+		int index = ++CCD_CONTEXT->file_name_index;
+		if (snprintf(file_name, INDIGO_VALUE_SIZE, "%s%0*d%s", head, digits, index, tail) >= INDIGO_VALUE_SIZE) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		// O_EXCL keeps it safe if some file was created behind our back
+		int handle = open_image_file(file_name, true, direct);
+		if (handle >= 0 || errno != EEXIST)
+			return handle;
+	}
+}
+
+static int open_local_image_file(indigo_device *device, const char *suffix, char *file_name, bool *direct) {
+	char *dir = CCD_LOCAL_MODE_DIR_ITEM->text.value;
+	char *prefix = CCD_LOCAL_MODE_PREFIX_ITEM->text.value;
+	char *placeholder = strstr(prefix, "XXX");
+	if (placeholder == NULL) {
+		if (snprintf(file_name, INDIGO_VALUE_SIZE, "%s%s%s", dir, prefix, suffix) >= INDIGO_VALUE_SIZE) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		return open_image_file(file_name, false, direct);
+	}
+	char head[INDIGO_VALUE_SIZE], tail[INDIGO_VALUE_SIZE];
+	int digits = strncmp(placeholder, "XXXX", 4) ? 3 : 4;
+	int head_length = snprintf(head, sizeof(head), "%s%.*s", dir, (int)(placeholder - prefix), prefix);
+	int tail_length = snprintf(tail, sizeof(tail), "%s%s", placeholder + digits, suffix);
+	if (head_length >= (int)sizeof(head) || tail_length >= (int)sizeof(tail)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return open_sequential_image_file(device, head, digits, tail, file_name, direct);
+}
+
+static void queue_image_file(indigo_device *device, int handle, bool direct, const char *file_name, void *content, long size) {
+	image_write_job *job = malloc(sizeof(image_write_job));
+	assert(job != NULL);
+	job->device = device;
+	job->handle = handle;
+	job->direct = direct;
+	snprintf(job->file_name, sizeof(job->file_name), "%s", file_name);
+	long allocated = (size + IMAGE_WRITER_ALIGNMENT - 1) / IMAGE_WRITER_ALIGNMENT * IMAGE_WRITER_ALIGNMENT;
+	if (posix_memalign(&job->content, IMAGE_WRITER_ALIGNMENT, allocated))
+		job->content = NULL;
+	assert(job->content != NULL);
+	memcpy(job->content, content, size);
+	memset(job->content + size, 0, allocated - size);
+	job->size = size;
+	job->next = NULL;
+	pthread_mutex_lock(&writer_mutex);
+	if (!writer_running) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, image_writer_thread, NULL) == 0) {
+			pthread_detach(thread);
+			writer_running = true;
+		} else {
+			pthread_mutex_unlock(&writer_mutex);
+			indigo_error("%s: failed to start image writer thread", device->name);
+			write_image_file(job);
+			free(job->content);
+			free(job);
+			return;
+		}
+	}
+	// memory is bounded, if media can't keep up, exposure loop is slowed down
+	while (writer_head != NULL && writer_queued + size > IMAGE_WRITER_QUEUE_LIMIT)
+		pthread_cond_wait(&writer_cond, &writer_mutex);
+	if (writer_tail)
+		writer_tail->next = job;
+	else
+		writer_head = job;
+	writer_tail = job;
+	writer_queued += size;
+	pthread_cond_broadcast(&writer_cond);
+	pthread_mutex_unlock(&writer_mutex);
+}
+
+static void flush_image_writer(indigo_device *device) {
+	pthread_mutex_lock(&writer_mutex);
+	while (true) {
+		bool pending = writer_device == device;
+		for (image_write_job *job = writer_head; job && !pending; job = job->next)
+			pending = job->device == device;
+		if (!pending)
+			break;
+		pthread_cond_wait(&writer_cond, &writer_mutex);
+	}
+	pthread_mutex_unlock(&writer_mutex);
+}
+
 indigo_result indigo_ccd_attach(indigo_device *device, unsigned version) {
 	assert(device != NULL);
 	if (CCD_CONTEXT == NULL) {
 		device->device_context = malloc(sizeof(indigo_ccd_context));
 		assert(DEVICE_CONTEXT != NULL);
 		memset(device->device_context, 0, sizeof(indigo_ccd_context));
+		pthread_mutex_init(&CCD_CONTEXT->image_mutex, NULL);
 	}
 	if (CCD_CONTEXT != NULL) {
 		if (indigo_device_attach(device, version, INDIGO_INTERFACE_CCD) == INDIGO_OK) {
@@ -180,13 +827,15 @@ indigo_result indigo_ccd_attach(indigo_device *device, unsigned version) {
 			indigo_init_switch_item(CCD_FRAME_TYPE_DARK_ITEM, CCD_FRAME_TYPE_DARK_ITEM_NAME, "Dark", false);
 			indigo_init_switch_item(CCD_FRAME_TYPE_FLAT_ITEM, CCD_FRAME_TYPE_FLAT_ITEM_NAME, "Flat", false);
 			// -------------------------------------------------------------------------------- CCD_IMAGE_FORMAT
-			CCD_IMAGE_FORMAT_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_IMAGE_FORMAT_PROPERTY_NAME, CCD_IMAGE_GROUP, "Image format", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 4);
+			CCD_IMAGE_FORMAT_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_IMAGE_FORMAT_PROPERTY_NAME, CCD_IMAGE_GROUP, "Image format", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 6);
 			if (CCD_IMAGE_FORMAT_PROPERTY == NULL)
 				return INDIGO_FAILED;
 			indigo_init_switch_item(CCD_IMAGE_FORMAT_FITS_ITEM, CCD_IMAGE_FORMAT_FITS_ITEM_NAME, "FITS format", true);
 			indigo_init_switch_item(CCD_IMAGE_FORMAT_XISF_ITEM, CCD_IMAGE_FORMAT_XISF_ITEM_NAME, "XISF format", false);
 			indigo_init_switch_item(CCD_IMAGE_FORMAT_RAW_ITEM, CCD_IMAGE_FORMAT_RAW_ITEM_NAME, "Raw data", false);
 			indigo_init_switch_item(CCD_IMAGE_FORMAT_JPEG_ITEM, CCD_IMAGE_FORMAT_JPEG_ITEM_NAME, "JPEG format", false);
+			indigo_init_switch_item(CCD_IMAGE_FORMAT_FITS_RICE_ITEM, CCD_IMAGE_FORMAT_FITS_RICE_ITEM_NAME, "FITS Rice compressed", false);
+			indigo_init_switch_item(CCD_IMAGE_FORMAT_XISF_LZ4_ITEM, CCD_IMAGE_FORMAT_XISF_LZ4_ITEM_NAME, "XISF LZ4 compressed", false);
 			// -------------------------------------------------------------------------------- CCD_IMAGE
 			CCD_IMAGE_PROPERTY = indigo_init_blob_property(NULL, device->name, CCD_IMAGE_PROPERTY_NAME, CCD_IMAGE_GROUP, "Image data", INDIGO_OK_STATE, 1);
 			if (CCD_IMAGE_PROPERTY == NULL)
@@ -203,6 +852,22 @@ indigo_result indigo_ccd_attach(indigo_device *device, unsigned version) {
 			if (CCD_IMAGE_FILE_PROPERTY == NULL)
 				return INDIGO_FAILED;
 			indigo_init_text_item(CCD_IMAGE_FILE_ITEM, CCD_IMAGE_FILE_ITEM_NAME, "Filename", "None");
+			// -------------------------------------------------------------------------------- CCD_IMAGE_STATS
+			CCD_IMAGE_STATS_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_IMAGE_STATS_PROPERTY_NAME, CCD_IMAGE_GROUP, "Image statistics", INDIGO_IDLE_STATE, INDIGO_RO_PERM, 6);
+			if (CCD_IMAGE_STATS_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_number_item(CCD_IMAGE_STATS_MIN_ITEM, CCD_IMAGE_STATS_MIN_ITEM_NAME, "Minimum", 0, 65535, 0, 0);
+			indigo_init_number_item(CCD_IMAGE_STATS_MAX_ITEM, CCD_IMAGE_STATS_MAX_ITEM_NAME, "Maximum", 0, 65535, 0, 0);
+			indigo_init_number_item(CCD_IMAGE_STATS_MEAN_ITEM, CCD_IMAGE_STATS_MEAN_ITEM_NAME, "Mean", 0, 65535, 0, 0);
+			indigo_init_number_item(CCD_IMAGE_STATS_MEDIAN_ITEM, CCD_IMAGE_STATS_MEDIAN_ITEM_NAME, "Median", 0, 65535, 0, 0);
+			indigo_init_number_item(CCD_IMAGE_STATS_NOISE_ITEM, CCD_IMAGE_STATS_NOISE_ITEM_NAME, "Noise (1.4826 MAD)", 0, 65535, 0, 0);
+			indigo_init_number_item(CCD_IMAGE_STATS_SATURATED_ITEM, CCD_IMAGE_STATS_SATURATED_ITEM_NAME, "Saturated samples", 0, 1e10, 0, 0);
+			// -------------------------------------------------------------------------------- CCD_IMAGE_STATS_ENABLE
+			CCD_IMAGE_STATS_ENABLE_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_IMAGE_STATS_ENABLE_PROPERTY_NAME, CCD_IMAGE_GROUP, "Compute image statistics", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 2);
+			if (CCD_IMAGE_STATS_ENABLE_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_switch_item(CCD_IMAGE_STATS_ENABLED_ITEM, CCD_IMAGE_STATS_ENABLED_ITEM_NAME, "Enabled", false);
+			indigo_init_switch_item(CCD_IMAGE_STATS_DISABLED_ITEM, CCD_IMAGE_STATS_DISABLED_ITEM_NAME, "Disabled", true);
 			// -------------------------------------------------------------------------------- CCD_COOLER
 			CCD_COOLER_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_COOLER_PROPERTY_NAME, CCD_COOLER_GROUP, "Cooler status", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 2);
 			if (CCD_COOLER_PROPERTY == NULL)
@@ -233,7 +898,7 @@ indigo_result indigo_ccd_attach(indigo_device *device, unsigned version) {
 				indigo_init_text_item(CCD_FITS_HEADERS_PROPERTY->items + i, name, label, "");
 			}
 			// -------------------------------------------------------------------------------- CCD_JPEG_SETTINGS
-			CCD_JPEG_SETTINGS_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_JPEG_SETTINGS_PROPERTY_NAME, CCD_IMAGE_GROUP, "JPEG Settings", INDIGO_OK_STATE, INDIGO_RW_PERM, 5);
+			CCD_JPEG_SETTINGS_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_JPEG_SETTINGS_PROPERTY_NAME, CCD_IMAGE_GROUP, "JPEG Settings", INDIGO_OK_STATE, INDIGO_RW_PERM, 7);
 			if (CCD_JPEG_SETTINGS_PROPERTY == NULL)
 				return INDIGO_FAILED;
 			CCD_JPEG_SETTINGS_PROPERTY->hidden = true;
@@ -242,6 +907,8 @@ indigo_result indigo_ccd_attach(indigo_device *device, unsigned version) {
 			indigo_init_number_item(CCD_JPEG_SETTINGS_WHITE_ITEM, CCD_JPEG_SETTINGS_WHITE_ITEM_NAME, "White point", -1, 255, 0, -1);
 			indigo_init_number_item(CCD_JPEG_SETTINGS_BLACK_TRESHOLD_ITEM, CCD_JPEG_SETTINGS_BLACK_TRESHOLD_ITEM_NAME, "Black point treshold", 0, 1, 0, 0.005);
 			indigo_init_number_item(CCD_JPEG_SETTINGS_WHITE_TRESHOLD_ITEM, CCD_JPEG_SETTINGS_WHITE_TRESHOLD_ITEM_NAME, "White point treshold", 0, 1, 0, 0.002);
+			indigo_init_number_item(CCD_JPEG_SETTINGS_PREVIEW_WIDTH_ITEM, CCD_JPEG_SETTINGS_PREVIEW_WIDTH_ITEM_NAME, "Preview max width (0 = full)", 0, 65535, 1, 0);
+			indigo_init_number_item(CCD_JPEG_SETTINGS_PREVIEW_QUALITY_ITEM, CCD_JPEG_SETTINGS_PREVIEW_QUALITY_ITEM_NAME, "Preview quality", 10, 100, 5, 75);
 			// -------------------------------------------------------------------------------- CCD_RBI_FLUSH_ENABLE
 			CCD_RBI_FLUSH_ENABLE_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_RBI_FLUSH_ENABLE_PROPERTY_NAME, CCD_MAIN_GROUP, "RBI flush", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 2);
 			if (CCD_RBI_FLUSH_ENABLE_PROPERTY == NULL)
@@ -273,6 +940,10 @@ indigo_result indigo_ccd_enumerate_properties(indigo_device *device, indigo_clie
 			indigo_define_property(device, CCD_LOCAL_MODE_PROPERTY, NULL);
 		if (indigo_property_match(CCD_IMAGE_FILE_PROPERTY, property))
 			indigo_define_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+		if (indigo_property_match(CCD_IMAGE_STATS_PROPERTY, property))
+			indigo_define_property(device, CCD_IMAGE_STATS_PROPERTY, NULL);
+		if (indigo_property_match(CCD_IMAGE_STATS_ENABLE_PROPERTY, property))
+			indigo_define_property(device, CCD_IMAGE_STATS_ENABLE_PROPERTY, NULL);
 		if (indigo_property_match(CCD_MODE_PROPERTY, property))
 			indigo_define_property(device, CCD_MODE_PROPERTY, NULL);
 		if (indigo_property_match(CCD_READ_MODE_PROPERTY, property))
@@ -347,6 +1018,8 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_define_property(device, CCD_FRAME_TYPE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_IMAGE_FORMAT_PROPERTY, NULL);
 			indigo_define_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_define_property(device, CCD_IMAGE_STATS_PROPERTY, NULL);
+			indigo_define_property(device, CCD_IMAGE_STATS_ENABLE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_IMAGE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_COOLER_PROPERTY, NULL);
@@ -374,6 +1047,8 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_delete_property(device, CCD_FRAME_TYPE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_IMAGE_FORMAT_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_IMAGE_STATS_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_IMAGE_STATS_ENABLE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_IMAGE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_COOLER_PROPERTY, NULL);
@@ -399,6 +1074,7 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_save_property(device, NULL, CCD_FRAME_TYPE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_FITS_HEADERS_PROPERTY);
 			indigo_save_property(device, NULL, CCD_JPEG_SETTINGS_PROPERTY);
+			indigo_save_property(device, NULL, CCD_IMAGE_STATS_ENABLE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_RBI_FLUSH_ENABLE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_RBI_FLUSH_PROPERTY);
 		}
@@ -690,6 +1366,18 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 		if (IS_CONNECTED)
 			indigo_update_property(device, CCD_JPEG_SETTINGS_PROPERTY, NULL);
 		return INDIGO_OK;
+		// -------------------------------------------------------------------------------- CCD_IMAGE_STATS_ENABLE
+	} else if (indigo_property_match(CCD_IMAGE_STATS_ENABLE_PROPERTY, property)) {
+		indigo_property_copy_values(CCD_IMAGE_STATS_ENABLE_PROPERTY, property, false);
+		CCD_IMAGE_STATS_ENABLE_PROPERTY->state = INDIGO_OK_STATE;
+		if (CCD_IMAGE_STATS_DISABLED_ITEM->sw.value && CCD_IMAGE_STATS_PROPERTY->state != INDIGO_IDLE_STATE) {
+			CCD_IMAGE_STATS_PROPERTY->state = INDIGO_IDLE_STATE;
+			if (IS_CONNECTED)
+				indigo_update_property(device, CCD_IMAGE_STATS_PROPERTY, NULL);
+		}
+		if (IS_CONNECTED)
+			indigo_update_property(device, CCD_IMAGE_STATS_ENABLE_PROPERTY, NULL);
+		return INDIGO_OK;
 		// -------------------------------------------------------------------------------- CCD_RBI_FLUSH_ENABLE
 	} else if (indigo_property_match(CCD_RBI_FLUSH_ENABLE_PROPERTY, property)) {
 		if (CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE) {
@@ -723,6 +1411,12 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 
 indigo_result indigo_ccd_detach(indigo_device *device) {
 	assert(device != NULL);
+	release_frame_pool(device);
+	flush_image_writer(device);
+	if (CCD_IMAGE_PROPERTY)
+		set_blob_buffer(CCD_IMAGE_ITEM, NULL);
+	if (CCD_PREVIEW_IMAGE_PROPERTY)
+		set_blob_buffer(CCD_PREVIEW_IMAGE_ITEM, NULL);
 	indigo_release_property(CCD_INFO_PROPERTY);
 	indigo_release_property(CCD_UPLOAD_MODE_PROPERTY);
 	indigo_release_property(CCD_PREVIEW_PROPERTY);
@@ -740,6 +1434,8 @@ indigo_result indigo_ccd_detach(indigo_device *device) {
 	indigo_release_property(CCD_FRAME_TYPE_PROPERTY);
 	indigo_release_property(CCD_IMAGE_FORMAT_PROPERTY);
 	indigo_release_property(CCD_IMAGE_FILE_PROPERTY);
+	indigo_release_property(CCD_IMAGE_STATS_PROPERTY);
+	indigo_release_property(CCD_IMAGE_STATS_ENABLE_PROPERTY);
 	indigo_release_property(CCD_IMAGE_PROPERTY);
 	indigo_release_property(CCD_PREVIEW_IMAGE_PROPERTY);
 	indigo_release_property(CCD_TEMPERATURE_PROPERTY);
@@ -749,8 +1445,10 @@ indigo_result indigo_ccd_detach(indigo_device *device) {
 	indigo_release_property(CCD_JPEG_SETTINGS_PROPERTY);
 	indigo_release_property(CCD_RBI_FLUSH_ENABLE_PROPERTY);
 	indigo_release_property(CCD_RBI_FLUSH_PROPERTY);
-	if (CCD_CONTEXT->preview_image)
-		free(CCD_CONTEXT->preview_image);
+	if (CCD_CONTEXT->image_buffer)
+		free(CCD_CONTEXT->image_buffer);
+	pthread_mutex_destroy(&CCD_CONTEXT->image_mutex);
+	release_fits_keywords(device);
 	return indigo_device_detach(device);
 }
 
@@ -793,11 +1491,332 @@ static void set_black_white(indigo_device *device, long *histo, long count) {
 	}
 }
 
-static void raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, void **data_out, unsigned long *size_out) {
+// Pixel kernels are simple loops over [from, to) ranges, split among worker threads by indigo_parallel() and left for
+// the compiler to vectorize (see INDIGO_IMAGE_KERNEL).
+
+typedef struct {
+	void *in;
+	void *out;
+	unsigned long size;
+	int components;
+	bool little_endian;
+	bool byte_order_rgb;
+	unsigned char *lut;
+	long *histo;
+	pthread_mutex_t mutex;
+	int in_width;
+	int out_width;
+	int factor;
+	uint32_t **spare_histo;
+	int spare_count;
+} image_job;
+
+static inline uint16_t swap16(uint16_t value) {
+	return (uint16_t)(value << 8 | value >> 8);
+}
+
+INDIGO_IMAGE_KERNEL static void fits_mono16_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint16_t *raw = job->in;
+	if (job->little_endian) {
+		for (long i = from; i < to; i++)
+			raw[i] = swap16(raw[i] ^ 0x8000);
+	} else {
+		for (long i = from; i < to; i++)
+			raw[i] ^= 0x0080;
+	}
+}
+
+INDIGO_IMAGE_KERNEL static void fits_rgb24_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint8_t *tmp = job->in;
+	uint8_t *first = (uint8_t *)job->out + (job->byte_order_rgb ? 0 : 2 * job->size);
+	uint8_t *green = (uint8_t *)job->out + job->size;
+	uint8_t *last = (uint8_t *)job->out + (job->byte_order_rgb ? 2 * job->size : 0);
+	for (long i = from; i < to; i++) {
+		first[i] = tmp[3 * i];
+		green[i] = tmp[3 * i + 1];
+		last[i] = tmp[3 * i + 2];
+	}
+}
+
+INDIGO_IMAGE_KERNEL static void fits_rgb48_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint16_t *tmp = job->in;
+	uint16_t *first = (uint16_t *)job->out + (job->byte_order_rgb ? 0 : 2 * job->size);
+	uint16_t *green = (uint16_t *)job->out + job->size;
+	uint16_t *last = (uint16_t *)job->out + (job->byte_order_rgb ? 2 * job->size : 0);
+	if (job->little_endian) {
+		for (long i = from; i < to; i++) {
+			first[i] = swap16(tmp[3 * i] ^ 0x8000);
+			green[i] = swap16(tmp[3 * i + 1] ^ 0x8000);
+			last[i] = swap16(tmp[3 * i + 2] ^ 0x8000);
+		}
+	} else {
+		for (long i = from; i < to; i++) {
+			first[i] = tmp[3 * i];
+			green[i] = tmp[3 * i + 1];
+			last[i] = tmp[3 * i + 2];
+		}
+	}
+}
+
+INDIGO_IMAGE_KERNEL static void swap16_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint16_t *raw = job->in;
+	for (long i = from; i < to; i++)
+		raw[i] = swap16(raw[i]);
+}
+
+INDIGO_IMAGE_KERNEL static void swap_rb24_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint8_t *raw = job->in;
+	for (long i = from; i < to; i++) {
+		uint8_t b = raw[3 * i];
+		raw[3 * i] = raw[3 * i + 2];
+		raw[3 * i + 2] = b;
+	}
+}
+
+static void merge_histo(image_job *job, uint32_t *histo, int bins) {
+	pthread_mutex_lock(&job->mutex);
+	for (int i = 0; i < bins; i++)
+		job->histo[i] += histo[i];
+	pthread_mutex_unlock(&job->mutex);
+}
+
+static void histo8_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint8_t *raw = job->in;
+	uint32_t histo[256] = { 0 };
+	for (long i = from; i < to; i++)
+		histo[raw[i]]++;
+	merge_histo(job, histo, 256);
+}
+
+// 256 bin histogram of high bytes, it is enough for JPEG stretch
+
+static void histo16_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint16_t *raw = job->in;
+	uint32_t histo[256] = { 0 };
+	if (job->little_endian) {
+		for (long i = from; i < to; i++)
+			histo[raw[i] >> 8]++;
+	} else {
+		for (long i = from; i < to; i++)
+			histo[raw[i] & 0xff]++;
+	}
+	merge_histo(job, histo, 256);
+}
+
+// full 16 bit histogram of native values, too large for stack of worker thread, so buffers are cleared on merge
+// and reused by following chunks of the same job (at most one buffer per concurrently running chunk is allocated)
+
+#define SPARE_HISTO_COUNT	64
+
+static void full_histo16_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint16_t *raw = job->in;
+	uint32_t *histo = NULL;
+	pthread_mutex_lock(&job->mutex);
+	if (job->spare_count > 0)
+		histo = job->spare_histo[--job->spare_count];
+	pthread_mutex_unlock(&job->mutex);
+	if (histo == NULL) {
+		histo = calloc(65536, sizeof(uint32_t));
+		assert(histo != NULL);
+	}
+	if (job->little_endian) {
+		for (long i = from; i < to; i++)
+			histo[raw[i]]++;
+	} else {
+		for (long i = from; i < to; i++)
+			histo[swap16(raw[i])]++;
+	}
+	pthread_mutex_lock(&job->mutex);
+	for (int i = 0; i < 65536; i++) {
+		job->histo[i] += histo[i];
+		histo[i] = 0;
+	}
+	if (job->spare_count < SPARE_HISTO_COUNT)
+		job->spare_histo[job->spare_count++] = histo;
+	else
+		free(histo);
+	pthread_mutex_unlock(&job->mutex);
+}
+
+// stretch kernels work on pixels, for RGB images with BGR byte order red and blue are swapped on the fly
+
+INDIGO_IMAGE_KERNEL static void stretch8_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint8_t *in = job->in;
+	uint8_t *out = job->out;
+	uint8_t *lut = job->lut;
+	if (job->components == 1 || job->byte_order_rgb) {
+		for (long i = from * job->components; i < to * job->components; i++)
+			out[i] = lut[in[i]];
+	} else {
+		for (long i = from; i < to; i++) {
+			out[3 * i] = lut[in[3 * i + 2]];
+			out[3 * i + 1] = lut[in[3 * i + 1]];
+			out[3 * i + 2] = lut[in[3 * i]];
+		}
+	}
+}
+
+INDIGO_IMAGE_KERNEL static void stretch16_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint16_t *in = job->in;
+	uint8_t *out = job->out;
+	uint8_t *lut = job->lut;
+	if (job->components == 1 || job->byte_order_rgb) {
+		if (job->little_endian) {
+			for (long i = from * job->components; i < to * job->components; i++)
+				out[i] = lut[in[i]];
+		} else {
+			for (long i = from * job->components; i < to * job->components; i++)
+				out[i] = lut[swap16(in[i])];
+		}
+	} else {
+		if (job->little_endian) {
+			for (long i = from; i < to; i++) {
+				out[3 * i] = lut[in[3 * i + 2]];
+				out[3 * i + 1] = lut[in[3 * i + 1]];
+				out[3 * i + 2] = lut[in[3 * i]];
+			}
+		} else {
+			for (long i = from; i < to; i++) {
+				out[3 * i] = lut[swap16(in[3 * i + 2])];
+				out[3 * i + 1] = lut[swap16(in[3 * i + 1])];
+				out[3 * i + 2] = lut[swap16(in[3 * i])];
+			}
+		}
+	}
+}
+
+// preview kernels, for reduction factor > 1 they work on output pixels, histogram is sampled and stretch is fused with averaging of factor x factor input blocks
+
+static inline long block_offset(image_job *job, long i) {
+	return ((i / job->out_width) * job->factor * job->in_width + (i % job->out_width) * job->factor) * job->components;
+}
+
+INDIGO_IMAGE_KERNEL static void bin8_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint8_t *out = job->out;
+	uint8_t *lut = job->lut;
+	int components = job->components, factor = job->factor;
+	int swap = (components == 3 && !job->byte_order_rgb) ? 2 : 0;
+	long stride = (long)job->in_width * components;
+	uint32_t area = factor * factor;
+	for (long i = from; i < to; i++) {
+		uint8_t *block = (uint8_t *)job->in + block_offset(job, i);
+		for (int c = 0; c < components; c++) {
+			uint32_t sum = 0;
+			for (int y = 0; y < factor; y++)
+				for (int x = 0; x < factor; x++)
+					sum += block[y * stride + x * components + c];
+			out[i * components + abs(swap - c)] = lut[sum / area];
+		}
+	}
+}
+
+INDIGO_IMAGE_KERNEL static void bin16_kernel(void *data, long from, long to) {
+	image_job *job = data;
+	uint8_t *out = job->out;
+	uint8_t *lut = job->lut;
+	int components = job->components, factor = job->factor;
+	int swap = (components == 3 && !job->byte_order_rgb) ? 2 : 0;
+	long stride = (long)job->in_width * components;
+	uint64_t area = factor * factor;
+	for (long i = from; i < to; i++) {
+		uint16_t *block = (uint16_t *)job->in + block_offset(job, i);
+		for (int c = 0; c < components; c++) {
+			uint64_t sum = 0;
+			if (job->little_endian) {
+				for (int y = 0; y < factor; y++)
+					for (int x = 0; x < factor; x++)
+						sum += block[y * stride + x * components + c];
+			} else {
+				for (int y = 0; y < factor; y++)
+					for (int x = 0; x < factor; x++)
+						sum += swap16(block[y * stride + x * components + c]);
+			}
+			out[i * components + abs(swap - c)] = lut[sum / area];
+		}
+	}
+}
+
+// image is stretched and compressed in strips of about JPEG_STRIP_PIXELS output pixels, so no full size copy is needed
+
+#define JPEG_STRIP_PIXELS	(256L * 1024)
+
+// 256 bin histogram (by high byte) of all samples for JPEG stretch, used if statistics are not computed
+
+static void compute_stretch_histo(void *data, long count, bool wide, bool little_endian, long *histo) {
+	image_job job = { .in = data + FITS_HEADER_SIZE, .size = count, .components = 1, .little_endian = little_endian, .byte_order_rgb = true, .histo = histo, .mutex = PTHREAD_MUTEX_INITIALIZER };
+	indigo_parallel(wide ? histo16_kernel : histo8_kernel, &job, count);
+}
+
+// Frame statistics are derived from full resolution histogram of native sample values (all color channels together),
+// it is computed in a single parallel pass and reduced to 256 bins (by high byte) for JPEG stretch
+
+static void update_image_stats(indigo_device *device, void *data, long count, bool wide, bool little_endian, long *stretch_histo) {
 	INDIGO_DEBUG(clock_t start = clock());
-	int size_in = frame_width * frame_height;
-	void *copy = malloc(size_in * bpp / 8);
-	memcpy(copy, data_in + FITS_HEADER_SIZE, size_in * bpp / 8);
+	int bins = wide ? 65536 : 256;
+	long *histo = calloc(bins, sizeof(long));
+	assert(histo != NULL);
+	uint32_t *spare_histo[SPARE_HISTO_COUNT];
+	image_job job = { .in = data + FITS_HEADER_SIZE, .size = count, .components = 1, .little_endian = little_endian, .byte_order_rgb = true, .histo = histo, .mutex = PTHREAD_MUTEX_INITIALIZER, .spare_histo = spare_histo };
+	indigo_parallel(wide ? full_histo16_kernel : histo8_kernel, &job, count);
+	while (job.spare_count > 0)
+		free(spare_histo[--job.spare_count]);
+	int min = 0, max = bins - 1, median = 0;
+	double sum = 0;
+	long total = 0, half = (count + 1) / 2;
+	while (min < max && histo[min] == 0)
+		min++;
+	while (max > min && histo[max] == 0)
+		max--;
+	for (int i = min; i <= max; i++) {
+		sum += (double)i * histo[i];
+		if (total < half && total + histo[i] >= half)
+			median = i;
+		total += histo[i];
+		stretch_histo[wide ? i >> 8 : i] += histo[i];
+	}
+	// median absolute deviation, distances from median are collected from both sides of histogram
+	int mad = 0;
+	total = histo[median];
+	while (total < half && (median - mad > min || median + mad < max)) {
+		mad++;
+		if (median - mad >= min)
+			total += histo[median - mad];
+		if (median + mad <= max)
+			total += histo[median + mad];
+	}
+	CCD_IMAGE_STATS_MIN_ITEM->number.value = min;
+	CCD_IMAGE_STATS_MAX_ITEM->number.value = max;
+	CCD_IMAGE_STATS_MEAN_ITEM->number.value = count ? sum / count : 0;
+	CCD_IMAGE_STATS_MEDIAN_ITEM->number.value = median;
+	CCD_IMAGE_STATS_NOISE_ITEM->number.value = 1.4826 * mad;
+	CCD_IMAGE_STATS_SATURATED_ITEM->number.value = histo[bins - 1];
+	CCD_IMAGE_STATS_PROPERTY->state = INDIGO_OK_STATE;
+	indigo_update_property(device, CCD_IMAGE_STATS_PROPERTY, NULL);
+	free(histo);
+	INDIGO_DEBUG(indigo_debug("Image statistics in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+}
+
+static void raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, long *histo, int max_width, bool preview, void **data_out, unsigned long *size_out) {
+	INDIGO_DEBUG(clock_t start = clock());
+	int factor = 1;
+	if (max_width > 0 && frame_width > max_width)
+		factor = (frame_width + max_width - 1) / max_width;
+	int width = frame_width / factor;
+	int height = frame_height / factor;
+	int components = (bpp == 24 || bpp == 48) ? 3 : 1;
+	bool wide = bpp == 16 || bpp == 48;
+	long size = (long)width * height;
 	unsigned char *mem = NULL;
 	unsigned long mem_size = 0;
 	struct jpeg_compress_struct cinfo;
@@ -805,98 +1824,737 @@ static void raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, i
 	cinfo.err = jpeg_std_error(&jerr);
 	jpeg_create_compress(&cinfo);
 	jpeg_mem_dest(&cinfo, &mem, &mem_size);
-	cinfo.image_width = frame_width;
-	cinfo.image_height = frame_height;
-	long histo[256] = { 0 };
-	if (bpp == 8 || bpp == 24) {
-		unsigned char *b8 = copy;
-		int count = size_in * (bpp == 8 ? 1 : 3);
-		for (int i = 0; i < count; i++) {
-			histo[*b8++]++;
-		}
-		set_black_white(device, histo, count);
-		double scale = (CCD_JPEG_SETTINGS_WHITE_ITEM->number.value - CCD_JPEG_SETTINGS_BLACK_ITEM->number.value) / 255;
+	cinfo.image_width = width;
+	cinfo.image_height = height;
+	image_job job = { .in = data_in + FITS_HEADER_SIZE, .size = size, .components = components, .little_endian = little_endian, .byte_order_rgb = byte_order_rgb, .mutex = PTHREAD_MUTEX_INITIALIZER, .in_width = frame_width, .out_width = width, .factor = factor };
+	set_black_white(device, histo, (long)frame_width * frame_height * components);
+	unsigned char *lut = malloc(wide ? 65536 : 256);
+	if (wide) {
+		double scale = (CCD_JPEG_SETTINGS_WHITE_ITEM->number.value - CCD_JPEG_SETTINGS_BLACK_ITEM->number.value);
 		int offset = CCD_JPEG_SETTINGS_BLACK_ITEM->number.value;
-		b8 = copy;
-		for (int i = 0; i < count; i++) {
-			int value = (*b8 - offset) / scale;
+		for (int i = 0; i < 65536; i++) {
+			int value = (i - offset) / scale;
 			if (value < 0)
 				value = 0;
 			else if (value > 255)
 				value = 255;
-			*b8++ = value;
+			lut[i] = value;
 		}
-	}
-	if (bpp == 16 || bpp == 48) {
-		unsigned short *b16 = copy;
-		int count = size_in * (bpp == 16 ? 1 : 3);
-		if (little_endian) {
-			for (int i = 0; i < count; i++) {
-				histo[*b16++ >> 8]++;
-			}
-		} else {
-			for (int i = 0; i < count; i++) {
-				int value = *b16;
-				value = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				*b16++ = value;
-				histo[value >> 8]++;
-			}
-		}
-		set_black_white(device, histo, count);
-		double scale = (CCD_JPEG_SETTINGS_WHITE_ITEM->number.value - CCD_JPEG_SETTINGS_BLACK_ITEM->number.value);
+	} else {
+		double scale = (CCD_JPEG_SETTINGS_WHITE_ITEM->number.value - CCD_JPEG_SETTINGS_BLACK_ITEM->number.value) / 255;
 		int offset = CCD_JPEG_SETTINGS_BLACK_ITEM->number.value;
-		unsigned char *b8 = copy;
-		b16 = copy;
-		for (int i = 0; i < count; i++) {
-			int value = (*b16++ - offset) / scale;
+		for (int i = 0; i < 256; i++) {
+			int value = (i - offset) / scale;
 			if (value < 0)
 				value = 0;
 			else if (value > 255)
 				value = 255;
-			*b8++ = value;
+			lut[i] = value;
 		}
 	}
-	if (bpp == 8 || bpp == 16) {
+	job.lut = lut;
+	void (*kernel)(void *data, long from, long to);
+	if (factor == 1)
+		kernel = wide ? stretch16_kernel : stretch8_kernel;
+	else
+		kernel = wide ? bin16_kernel : bin8_kernel;
+	if (components == 1) {
 		cinfo.input_components = 1;
 		cinfo.in_color_space = JCS_GRAYSCALE;
-	}
-	if (bpp == 24 || bpp == 48) {
-		if (!byte_order_rgb) {
-			unsigned char *b8 = copy;
-			for (int i = 0; i < size_in; i++) {
-				unsigned char b = *b8;
-				unsigned char r = *(b8 + 2);
-				*b8 = r;
-				*(b8 + 2) = b;
-				b8 += 3;
-			}
-		}
+	} else {
 		cinfo.input_components = 3;
 		cinfo.in_color_space = JCS_RGB;
 	}
 	jpeg_set_defaults(&cinfo);
-	jpeg_set_quality(&cinfo, CCD_JPEG_SETTINGS_QUALITY_ITEM->number.target, true);
-	JSAMPROW row_pointer[1];
-	jpeg_start_compress( &cinfo, TRUE);
-	while( cinfo.next_scanline < cinfo.image_height ) {
-		row_pointer[0] = &((JSAMPROW)copy)[cinfo.next_scanline * cinfo.image_width *  cinfo.input_components];
-		jpeg_write_scanlines(&cinfo, row_pointer, 1);
+	// JPEG used only as a preview is encoded with fast DCT (SIMD accelerated with libjpeg-turbo) and its own, lower default quality
+	if (preview)
+		cinfo.dct_method = JDCT_IFAST;
+	jpeg_set_quality(&cinfo, preview ? CCD_JPEG_SETTINGS_PREVIEW_QUALITY_ITEM->number.target : CCD_JPEG_SETTINGS_QUALITY_ITEM->number.target, true);
+	int strip_height = (int)((JPEG_STRIP_PIXELS + width - 1) / width);
+	if (strip_height > height)
+		strip_height = height;
+	unsigned char *strip = malloc((long)strip_height * width * components);
+	long in_strip_row = (long)frame_width * factor * (bpp / 8);
+	job.out = strip;
+	jpeg_start_compress(&cinfo, TRUE);
+	while (cinfo.next_scanline < cinfo.image_height) {
+		int rows = cinfo.image_height - cinfo.next_scanline;
+		if (rows > strip_height)
+			rows = strip_height;
+		job.in = data_in + FITS_HEADER_SIZE + cinfo.next_scanline * in_strip_row;
+		indigo_parallel(kernel, &job, (long)rows * width);
+		for (int row = 0; row < rows; row++) {
+			JSAMPROW row_pointer = (JSAMPROW)strip + (long)row * width * components;
+			jpeg_write_scanlines(&cinfo, &row_pointer, 1);
+		}
 	}
 	jpeg_finish_compress(&cinfo);
 	jpeg_destroy_compress(&cinfo);
+	pthread_mutex_destroy(&job.mutex);
+	free(strip);
+	free(lut);
 	*data_out = mem;
 	*size_out = mem_size;
-	free(copy);
-	INDIGO_DEBUG(indigo_debug("RAW to preview conversion in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+	INDIGO_DEBUG(indigo_debug("RAW to preview conversion (%dx%d, factor %d) in %gs", width, height, factor, (clock() - start) / (double)CLOCKS_PER_SEC));
+}
+
+// Image header builder, header grows in FITS blocks, it contains 80 character cards for FITS and XML for XISF
+
+typedef struct {
+	char *buffer;
+	long size;
+	long length;
+} image_header;
+
+#define FITS_BLOCKS(length)	(((length) + FITS_BLOCK_SIZE - 1) / FITS_BLOCK_SIZE * FITS_BLOCK_SIZE)
+
+static void header_reserve(image_header *header, long length) {
+	if (header->length + length > header->size) {
+		header->size = FITS_BLOCKS(header->length + length);
+		header->buffer = realloc(header->buffer, header->size);
+		assert(header->buffer != NULL);
+	}
+}
+
+static char *header_card(image_header *header) {
+	header_reserve(header, FITS_CARD_SIZE);
+	char *card = header->buffer + header->length;
+	header->length += FITS_CARD_SIZE;
+	return card;
+}
+
+static void header_printf(image_header *header, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	header_reserve(header, length + 1);
+	va_start(args, format);
+	vsnprintf(header->buffer + header->length, length + 1, format, args);
+	va_end(args);
+	header->length += length;
+}
+
+static void header_xml_text(image_header *header, const char *text) {
+	for (; *text; text++) {
+		switch (*text) {
+			case '&':
+				header_printf(header, "&amp;");
+				break;
+			case '<':
+				header_printf(header, "&lt;");
+				break;
+			case '>':
+				header_printf(header, "&gt;");
+				break;
+			case '\'':
+				header_printf(header, "&apos;");
+				break;
+			case '"':
+				header_printf(header, "&quot;");
+				break;
+			default:
+				header_reserve(header, 1);
+				header->buffer[header->length++] = *text;
+		}
+	}
+}
+
+static void header_pad(image_header *header, long size, char fill) {
+	header_reserve(header, size - header->length);
+	memset(header->buffer + header->length, fill, size - header->length);
+	header->length = size;
+}
+
+// header is copied to FITS_HEADER_SIZE prefix of image buffer, if it is larger, image is moved to device image buffer
+
+static void *place_image_header(indigo_device *device, void *data, image_header *header, unsigned long *blobsize) {
+	if (header->length <= FITS_HEADER_SIZE) {
+		memcpy(data, header->buffer, header->length);
+		return data;
+	}
+	unsigned long size = header->length + *blobsize;
+	if (CCD_CONTEXT->image_buffer_size < size) {
+		CCD_CONTEXT->image_buffer = realloc(CCD_CONTEXT->image_buffer, CCD_CONTEXT->image_buffer_size = size);
+		assert(CCD_CONTEXT->image_buffer != NULL);
+	}
+	memcpy(CCD_CONTEXT->image_buffer, header->buffer, header->length);
+	memcpy(CCD_CONTEXT->image_buffer + header->length, data + FITS_HEADER_SIZE, *blobsize);
+	*blobsize += header->length - FITS_HEADER_SIZE;
+	return CCD_CONTEXT->image_buffer;
+}
+
+// cards shared by FITS and XISF headers, generated from device state, keywords passed by driver, keyword registry and CCD_FITS_HEADERS
+
+static void add_image_cards(indigo_device *device, image_header *header, const char *date_obs, indigo_fits_keyword *keywords) {
+	int horizontal_bin = CCD_BIN_HORIZONTAL_ITEM->number.value;
+	int vertical_bin = CCD_BIN_VERTICAL_ITEM->number.value;
+	format_fits_number(header_card(header), "XBINNING", horizontal_bin, 0, "horizontal binning [pixels]");
+	format_fits_number(header_card(header), "YBINNING", vertical_bin, 0, "vertical binning [pixels]");
+	if (CCD_INFO_PIXEL_WIDTH_ITEM->number.value > 0 && CCD_INFO_PIXEL_HEIGHT_ITEM->number.value) {
+		format_fits_number(header_card(header), "XPIXSZ", CCD_INFO_PIXEL_WIDTH_ITEM->number.value * horizontal_bin, 2, "pixel width [microns]");
+		format_fits_number(header_card(header), "YPIXSZ", CCD_INFO_PIXEL_HEIGHT_ITEM->number.value * vertical_bin, 2, "pixel height [microns]");
+	}
+	format_fits_number(header_card(header), "EXPTIME", CCD_EXPOSURE_ITEM->number.target, 2, "exposure time [s]");
+	if (!CCD_TEMPERATURE_PROPERTY->hidden)
+		format_fits_number(header_card(header), "CCD-TEMP", CCD_TEMPERATURE_ITEM->number.value, 2, "CCD temperature [C]");
+	if (CCD_FRAME_TYPE_LIGHT_ITEM->sw.value)
+		format_fits_string(header_card(header), "IMAGETYP", "Light", "frame type");
+	else if (CCD_FRAME_TYPE_FLAT_ITEM->sw.value)
+		format_fits_string(header_card(header), "IMAGETYP", "Flat", "frame type");
+	else if (CCD_FRAME_TYPE_BIAS_ITEM->sw.value)
+		format_fits_string(header_card(header), "IMAGETYP", "Bias", "frame type");
+	else if (CCD_FRAME_TYPE_DARK_ITEM->sw.value)
+		format_fits_string(header_card(header), "IMAGETYP", "Dark", "frame type");
+	if (!CCD_GAIN_PROPERTY->hidden)
+		format_fits_number(header_card(header), "GAIN", CCD_GAIN_ITEM->number.value, 2, "Gain");
+	if (!CCD_OFFSET_PROPERTY->hidden)
+		format_fits_number(header_card(header), "OFFSET", CCD_OFFSET_ITEM->number.value, 2, "Offset");
+	if (!CCD_GAMMA_PROPERTY->hidden)
+		format_fits_number(header_card(header), "GAMMA", CCD_GAMMA_ITEM->number.value, 2, "Gamma");
+	format_fits_string(header_card(header), "DATE-OBS", date_obs, "UTC date that FITS file was created");
+	format_fits_string(header_card(header), "INSTRUME", device->name, "instrument name");
+	while (keywords && keywords->type) {
+		format_fits_keyword(header_card(header), keywords);
+		keywords++;
+	}
+	if (CCD_CONTEXT->fits_keywords) {
+		indigo_ccd_fits_keywords *registry = CCD_CONTEXT->fits_keywords;
+		pthread_mutex_lock(&registry->mutex);
+		for (int i = 0; i < registry->count; i++)
+			memcpy(header_card(header), registry->cards[i].card, FITS_CARD_SIZE);
+		pthread_mutex_unlock(&registry->mutex);
+	}
+	for (int i = 0; i < CCD_FITS_HEADERS_PROPERTY->count; i++) {
+		indigo_item *item = CCD_FITS_HEADERS_PROPERTY->items + i;
+		if (*item->text.value)
+			format_fits_text(header_card(header), item->text.value);
+	}
+}
+
+// split FITS card to name, value (with quotes for strings) and comment, returns false for commentary cards
+
+static bool parse_fits_card(const char *card, char *name, char *value, char *comment) {
+	const char *end = card + FITS_CARD_SIZE, *pnt;
+	int length = 8;
+	while (length > 0 && card[length - 1] == ' ')
+		length--;
+	memcpy(name, card, length);
+	name[length] = 0;
+	char *out = value;
+	bool has_value = card[8] == '=';
+	if (has_value) {
+		for (pnt = card + 9; pnt < end && *pnt == ' '; pnt++)
+			;
+		if (pnt < end && *pnt == '\'') {
+			*out++ = *pnt++;
+			while (pnt < end) {
+				if (*pnt == '\'') {
+					*out++ = *pnt++;
+					if (pnt < end && *pnt == '\'') {
+						*out++ = *pnt++;
+						continue;
+					}
+					break;
+				}
+				*out++ = *pnt++;
+			}
+		}
+		while (pnt < end && *pnt != '/')
+			*out++ = *pnt++;
+		if (pnt < end)
+			pnt++;
+	} else {
+		pnt = card + 8;
+	}
+	while (out > value && out[-1] == ' ')
+		out--;
+	*out = 0;
+	while (pnt < end && *pnt == ' ')
+		pnt++;
+	out = comment;
+	while (pnt < end)
+		*out++ = *pnt++;
+	while (out > comment && out[-1] == ' ')
+		out--;
+	*out = 0;
+	return has_value;
+}
+
+static char *unquote_fits_value(char *value) {
+	if (*value == '\'') {
+		value++;
+		char *end = value + strlen(value);
+		if (end > value && end[-1] == '\'')
+			end--;
+		while (end > value && end[-1] == ' ')
+			end--;
+		*end = 0;
+	}
+	return value;
+}
+
+static void build_xisf_header(indigo_device *device, image_header *header, image_header *cards, int frame_width, int frame_height, int naxis, int byte_per_pixel, unsigned long blobsize, long offset, const char *compression, const char *date_time_start, const char *date_time_end) {
+	header->length = 0;
+	header_reserve(header, 16);
+	memcpy(header->buffer, "XISF0100\0\0\0\0\0\0\0\0", 16);
+	header->length = 16;
+	header_printf(header, "<?xml version='1.0' encoding='UTF-8'?><xisf xmlns='http://www.pixinsight.com/xisf' xmlns:xsi='http://www.w3.org/2001/XMLSchema-instance' version='1.0' xsi:schemaLocation='http://www.pixinsight.com/xisf http://pixinsight.com/xisf/xisf-1.0.xsd'>");
+	char *frame_type = "Light";
+	char b1[32], b2[32];
+	if (CCD_FRAME_TYPE_FLAT_ITEM->sw.value)
+		frame_type ="Flat";
+	else if (CCD_FRAME_TYPE_BIAS_ITEM->sw.value)
+		frame_type ="Bias";
+	else if (CCD_FRAME_TYPE_DARK_ITEM->sw.value)
+		frame_type ="Dark";
+	if (naxis == 2 && byte_per_pixel == 1) {
+		header_printf(header, "<Image geometry='%d:%d:1' imageType='%s' sampleFormat='UInt8' colorSpace='Gray' location='attachment:%ld:%lu'%s>", frame_width, frame_height, frame_type, offset, blobsize, compression);
+	} else if (naxis == 2 && byte_per_pixel == 2) {
+		header_printf(header, "<Image geometry='%d:%d:1' imageType='%s' sampleFormat='UInt16' colorSpace='Gray' location='attachment:%ld:%lu'%s>", frame_width, frame_height, frame_type, offset, blobsize, compression);
+	} else if (naxis == 3 && byte_per_pixel == 1) {
+		header_printf(header, "<Image geometry='%d:%d:3' imageType='%s' pixelStorage='Normal' sampleFormat='UInt8' colorSpace='RGB' location='attachment:%ld:%lu'%s>", frame_width, frame_height, frame_type, offset, blobsize, compression);
+	} else if (naxis == 3 && byte_per_pixel == 2) {
+		header_printf(header, "<Image geometry='%d:%d:3' imageType='%s' pixelStorage='Normal' sampleFormat='UInt16' colorSpace='RGB' location='attachment:%ld:%lu'%s>", frame_width, frame_height, frame_type, offset, blobsize, compression);
+	}
+	int horizontal_bin = CCD_BIN_HORIZONTAL_ITEM->number.value;
+	int vertical_bin = CCD_BIN_VERTICAL_ITEM->number.value;
+	header_printf(header, "<Property id='Observation:Time:Start' type='TimePoint' value='%s'/><Property id='Observation:Time:End' type='TimePoint' value='%s'/>", date_time_start ,date_time_end);
+	header_printf(header, "<Property id='Instrument:Camera:Name' type='String'>%s</Property>", device->name);
+	header_printf(header, "<Property id='Instrument:Camera:XBinning' type='Int32' value='%d'/><Property id='Instrument:Camera:YBinning' type='Int32' value='%d'/>", horizontal_bin, vertical_bin);
+	header_printf(header, "<Property id='Instrument:ExposureTime' type='Float32' value='%s'/>", indigo_dtoa(CCD_EXPOSURE_ITEM->number.target, b1));
+	header_printf(header, "<Property id='Instrument:Sensor:XPixelSize' type='Float32' value='%s'/><Property id='Instrument:Sensor:YPixelSize' type='Float32' value='%s'/>", indigo_dtoa(CCD_INFO_PIXEL_WIDTH_ITEM->number.value * horizontal_bin, b1), indigo_dtoa(CCD_INFO_PIXEL_HEIGHT_ITEM->number.value * vertical_bin, b2));
+	if (!CCD_TEMPERATURE_PROPERTY->hidden)
+		header_printf(header, "<Property id='Instrument:Sensor:Temperature' type='Float32' value='%s'/><Property id='Instrument:Sensor:TargetTemperature' type='Float32' value='%s'/>", indigo_dtoa(CCD_TEMPERATURE_ITEM->number.value, b1), indigo_dtoa(CCD_TEMPERATURE_ITEM->number.target, b2));
+	if (!CCD_GAIN_PROPERTY->hidden)
+		header_printf(header, "<Property id='Instrument:Camera:Gain' type='Float32' value='%s'/>", indigo_dtoa(CCD_GAIN_ITEM->number.value, b1));
+	for (long i = 0; i < cards->length; i += FITS_CARD_SIZE) {
+		char name[9], value[FITS_CARD_SIZE + 1], comment[FITS_CARD_SIZE + 1];
+		if (!parse_fits_card(cards->buffer + i, name, value, comment) && *comment == 0)
+			continue;
+		header_printf(header, "<FITSKeyword name='");
+		header_xml_text(header, name);
+		header_printf(header, "' value='");
+		header_xml_text(header, value);
+		header_printf(header, "' comment='");
+		header_xml_text(header, comment);
+		header_printf(header, "'/>");
+		if (!strcmp(name, "FILTER")) {
+			header_printf(header, "<Property id='Instrument:Filter:Name' type='String' value='");
+			header_xml_text(header, unquote_fits_value(value));
+			header_printf(header, "'/>");
+		} else if (!strcmp(name, "FOCUSPOS")) {
+			header_printf(header, "<Property id='Instrument:Focuser:Position' type='String' value='");
+			header_xml_text(header, unquote_fits_value(value));
+			header_printf(header, "'/>");
+		} else if (!strcmp(name, "BAYERPAT")) {
+			header_printf(header, "<ColorFilterArray pattern='");
+			header_xml_text(header, unquote_fits_value(value));
+			header_printf(header, "' width='2' height='2'/>");
+		}
+	}
+	header_printf(header, "</Image><Metadata><Property id='XISF:CreationTime' type='String'>%s</Property><Property id='XISF:CreatorApplication' type='String'>INDIGO 2.0-%s</Property>", date_time_end, INDIGO_BUILD);
+#ifdef INDIGO_LINUX
+	header_printf(header, "<Property id='XISF:CreatorOS' type='String'>Linux</Property>");
+#endif
+#ifdef INDIGO_MACOS
+	header_printf(header, "<Property id='XISF:CreatorOS' type='String'>macOS</Property>");
+#endif
+#ifdef INDIGO_WINDOWS
+	header_printf(header, "<Property id='XISF:CreatorOS' type='String'>Windows</Property>");
+#endif
+	header_printf(header, "<Property id='XISF:BlockAlignmentSize' type='UInt16' value='2880'/></Metadata></xisf>");
+	*(uint32_t *)(header->buffer + 8) = (uint32_t)(header->length - 16);
+}
+
+// Tile compressed FITS (RICE_1 algorithm of FITS tiled image convention), every image row of every color plane is a tile,
+// tiles are compressed in parallel into worst case sized slots and then compacted into binary table heap
+
+#define RICE_BLOCK_SIZE	32
+
+typedef struct {
+	uint8_t *out;
+	uint64_t buffer;
+	int bits;
+} rice_writer;
+
+static inline void rice_put(rice_writer *writer, uint32_t value, int bits) {
+	writer->buffer = (writer->buffer << bits) | (value & (uint32_t)((1ULL << bits) - 1));
+	writer->bits += bits;
+	while (writer->bits >= 8) {
+		writer->bits -= 8;
+		*writer->out++ = (uint8_t)(writer->buffer >> writer->bits);
+	}
+}
+
+static inline void rice_put_zeros(rice_writer *writer, uint32_t count) {
+	for (; count > 24; count -= 24)
+		rice_put(writer, 0, 24);
+	rice_put(writer, 0, count);
+}
+
+// pixels are signed 16 bit values (bytepix 2) or unsigned bytes (bytepix 1), differences are wrapped to the same width
+
+static long rice_compress(const int32_t *pixels, int count, int bytepix, uint8_t *out) {
+	int fsbits = bytepix == 1 ? 3 : 4;
+	int fsmax = bytepix == 1 ? 6 : 14;
+	int bbits = bytepix * 8;
+	uint32_t diff[RICE_BLOCK_SIZE];
+	rice_writer writer = { out, 0, 0 };
+	rice_put(&writer, (uint32_t)pixels[0], bbits);
+	int32_t last = pixels[0];
+	for (int i = 0; i < count; i += RICE_BLOCK_SIZE) {
+		int block = count - i < RICE_BLOCK_SIZE ? count - i : RICE_BLOCK_SIZE;
+		double sum = 0;
+		for (int j = 0; j < block; j++) {
+			int32_t next = pixels[i + j];
+			int32_t delta = bytepix == 1 ? (int8_t)(next - last) : (int16_t)(next - last);
+			diff[j] = delta < 0 ? (uint32_t)(-2 * delta - 1) : (uint32_t)(2 * delta);
+			sum += diff[j];
+			last = next;
+		}
+		double mean = (sum - block / 2 - 1) / block;
+		if (mean < 0)
+			mean = 0;
+		uint32_t psum = ((uint32_t)mean & (bytepix == 1 ? 0xFF : 0xFFFF)) >> 1;
+		int fs = 0;
+		for (; psum > 0; fs++)
+			psum >>= 1;
+		if (fs >= fsmax) {
+			rice_put(&writer, fsmax + 1, fsbits);
+			for (int j = 0; j < block; j++)
+				rice_put(&writer, diff[j], bbits);
+		} else if (fs == 0 && sum == 0) {
+			rice_put(&writer, 0, fsbits);
+		} else {
+			rice_put(&writer, fs + 1, fsbits);
+			uint32_t mask = (1U << fs) - 1;
+			for (int j = 0; j < block; j++) {
+				// unary coded high part (zeros and terminating one) and fs low bits, in a single write if it fits
+				uint32_t top = diff[j] >> fs;
+				if (top + fs < 24) {
+					rice_put(&writer, (1U << fs) | (diff[j] & mask), top + 1 + fs);
+				} else {
+					rice_put_zeros(&writer, top);
+					rice_put(&writer, 1, 1);
+					if (fs)
+						rice_put(&writer, diff[j], fs);
+				}
+			}
+		}
+	}
+	if (writer.bits > 0)
+		*writer.out++ = (uint8_t)(writer.buffer << (8 - writer.bits));
+	return writer.out - out;
+}
+
+static inline void store_be32(uint8_t *out, uint32_t value) {
+	out[0] = (uint8_t)(value >> 24);
+	out[1] = (uint8_t)(value >> 16);
+	out[2] = (uint8_t)(value >> 8);
+	out[3] = (uint8_t)value;
+}
+
+typedef struct {
+	void *in;
+	uint8_t *out;
+	long *sizes;
+	long capacity;
+	int width;
+	int height;
+	int components;
+	int bytepix;
+	bool little_endian;
+	bool byte_order_rgb;
+} rice_job;
+
+// work is split by pixels to get useful chunk sizes from indigo_parallel(), tile is compressed by the chunk containing its first pixel
+
+static void rice_tile_kernel(void *data, long from, long to) {
+	rice_job *job = data;
+	int32_t *pixels = malloc(job->width * sizeof(int32_t));
+	assert(pixels != NULL);
+	for (long tile = (from + job->width - 1) / job->width; tile * job->width < to; tile++) {
+		int plane = (int)(tile / job->height);
+		long row = tile % job->height;
+		int component = job->components == 3 && !job->byte_order_rgb ? 2 - plane : plane;
+		long base = row * job->width * job->components + component;
+		if (job->bytepix == 1) {
+			uint8_t *in = job->in;
+			for (int i = 0; i < job->width; i++)
+				pixels[i] = in[base + (long)i * job->components];
+		} else {
+			uint16_t *in = job->in;
+			for (int i = 0; i < job->width; i++) {
+				uint16_t value = in[base + (long)i * job->components];
+				pixels[i] = (int16_t)((job->little_endian ? value : swap16(value)) ^ 0x8000);
+			}
+		}
+		job->sizes[tile] = rice_compress(pixels, job->width, job->bytepix, job->out + tile * job->capacity);
+	}
+	free(pixels);
+}
+
+static void *build_rice_fits(indigo_device *device, void *data, int frame_width, int frame_height, int naxis, int byte_per_pixel, bool little_endian, bool byte_order_rgb, const char *date_obs, indigo_fits_keyword *keywords, unsigned long *blobsize) {
+	int planes = naxis == 3 ? 3 : 1;
+	long tiles = (long)planes * frame_height;
+	// split coded block can be few bits longer than verbatim one, so reserve an extra bit per pixel
+	long capacity = byte_per_pixel + ((frame_width + RICE_BLOCK_SIZE - 1) / RICE_BLOCK_SIZE) * (1 + RICE_BLOCK_SIZE * byte_per_pixel + RICE_BLOCK_SIZE / 8) + 1;
+	rice_job job = { data + FITS_HEADER_SIZE, malloc(tiles * capacity), malloc(tiles * sizeof(long)), capacity, frame_width, frame_height, planes, byte_per_pixel, little_endian, byte_order_rgb };
+	assert(job.out != NULL && job.sizes != NULL);
+	indigo_parallel(rice_tile_kernel, &job, tiles * frame_width);
+	long heap_size = 0, max_size = 0;
+	for (long i = 0; i < tiles; i++) {
+		heap_size += job.sizes[i];
+		if (job.sizes[i] > max_size)
+			max_size = job.sizes[i];
+	}
+	image_header header = { NULL, 0, 0 };
+	format_fits_logical(header_card(&header), "SIMPLE", true, "file conforms to FITS standard");
+	format_fits_number(header_card(&header), "BITPIX", byte_per_pixel * 8, 0, "number of bits per data pixel");
+	format_fits_number(header_card(&header), "NAXIS", 0, 0, "no data in primary array");
+	format_fits_logical(header_card(&header), "EXTEND", true, "FITS dataset may contain extensions");
+	format_fits_text(header_card(&header), "END");
+	header_pad(&header, FITS_BLOCK_SIZE, ' ');
+	char value[FITS_CARD_SIZE];
+	format_fits_string(header_card(&header), "XTENSION", "BINTABLE", "binary table extension");
+	format_fits_number(header_card(&header), "BITPIX", 8, 0, "8-bit bytes");
+	format_fits_number(header_card(&header), "NAXIS", 2, 0, "2-dimensional binary table");
+	format_fits_number(header_card(&header), "NAXIS1", 8, 0, "width of table in bytes");
+	format_fits_number(header_card(&header), "NAXIS2", tiles, 0, "number of rows in table");
+	format_fits_number(header_card(&header), "PCOUNT", heap_size, 0, "size of special data area");
+	format_fits_number(header_card(&header), "GCOUNT", 1, 0, "one data group");
+	format_fits_number(header_card(&header), "TFIELDS", 1, 0, "number of fields in each row");
+	format_fits_string(header_card(&header), "TTYPE1", "COMPRESSED_DATA", "label for field 1");
+	snprintf(value, sizeof(value), "1PB(%ld)", max_size);
+	format_fits_string(header_card(&header), "TFORM1", value, "data format of field: variable length array");
+	format_fits_logical(header_card(&header), "ZIMAGE", true, "extension contains compressed image");
+	format_fits_number(header_card(&header), "ZBITPIX", byte_per_pixel * 8, 0, "data type of original image");
+	format_fits_number(header_card(&header), "ZNAXIS", naxis, 0, "dimension of original image");
+	format_fits_number(header_card(&header), "ZNAXIS1", frame_width, 0, "length of original image axis");
+	format_fits_number(header_card(&header), "ZNAXIS2", frame_height, 0, "length of original image axis");
+	if (naxis == 3)
+		format_fits_number(header_card(&header), "ZNAXIS3", 3, 0, "length of original image axis");
+	format_fits_number(header_card(&header), "ZTILE1", frame_width, 0, "size of tiles to be compressed");
+	format_fits_number(header_card(&header), "ZTILE2", 1, 0, "size of tiles to be compressed");
+	if (naxis == 3)
+		format_fits_number(header_card(&header), "ZTILE3", 1, 0, "size of tiles to be compressed");
+	format_fits_string(header_card(&header), "ZCMPTYPE", "RICE_1", "compression algorithm");
+	format_fits_string(header_card(&header), "ZNAME1", "BLOCKSIZE", "compression block size");
+	format_fits_number(header_card(&header), "ZVAL1", RICE_BLOCK_SIZE, 0, "pixels per block");
+	format_fits_string(header_card(&header), "ZNAME2", "BYTEPIX", "bytes per pixel (1, 2, 4, or 8)");
+	format_fits_number(header_card(&header), "ZVAL2", byte_per_pixel, 0, "bytes per pixel (1, 2, 4, or 8)");
+	format_fits_string(header_card(&header), "EXTNAME", "COMPRESSED_IMAGE", "name of this binary table extension");
+	char comment[FITS_CARD_SIZE + 1];
+	snprintf(comment, sizeof(comment), "COMMENT   Created by INDIGO %d.%d framework, see www.indigo-astronomy.org", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
+	format_fits_text(header_card(&header), comment);
+	if (byte_per_pixel == 2) {
+		format_fits_number(header_card(&header), "BZERO", 32768, 0, "offset data range to that of unsigned short");
+		format_fits_number(header_card(&header), "BSCALE", 1, 0, "default scaling factor");
+	}
+	add_image_cards(device, &header, date_obs, keywords);
+	format_fits_text(header_card(&header), "END");
+	header_pad(&header, FITS_BLOCKS(header.length), ' ');
+	unsigned long size = FITS_BLOCKS(header.length + tiles * 8 + heap_size);
+	if (CCD_CONTEXT->image_buffer_size < size) {
+		CCD_CONTEXT->image_buffer = realloc(CCD_CONTEXT->image_buffer, CCD_CONTEXT->image_buffer_size = size);
+		assert(CCD_CONTEXT->image_buffer != NULL);
+	}
+	uint8_t *out = CCD_CONTEXT->image_buffer;
+	memcpy(out, header.buffer, header.length);
+	uint8_t *table = out + header.length;
+	uint8_t *heap = table + 8 * tiles;
+	long offset = 0;
+	for (long i = 0; i < tiles; i++) {
+		store_be32(table + 8 * i, (uint32_t)job.sizes[i]);
+		store_be32(table + 8 * i + 4, (uint32_t)offset);
+		memcpy(heap + offset, job.out + i * capacity, job.sizes[i]);
+		offset += job.sizes[i];
+	}
+	memset(heap + offset, 0, out + size - (heap + offset));
+	*blobsize = size - FITS_HEADER_SIZE;
+	free(header.buffer);
+	free(job.out);
+	free(job.sizes);
+	return out;
+}
+
+// XISF data block compression, block is byte shuffled (for 16 bit samples) and split into subblocks compressed in parallel
+// by simple greedy LZ4 block format compressor (no external dependency, any LZ4 decoder can read it)
+
+#define XISF_SUBBLOCK_SIZE	(1024 * 1024)
+#define LZ4_HASH_BITS	14
+#define LZ4_MIN_MATCH	4
+#define LZ4_LAST_LITERALS	5
+#define LZ4_MATCH_LIMIT	12
+#define LZ4_BOUND(size)	((size) + (size) / 255 + 16)
+
+static inline uint32_t lz4_read32(const uint8_t *pnt) {
+	uint32_t value;
+	memcpy(&value, pnt, sizeof(value));
+	return value;
+}
+
+static inline uint8_t *lz4_put_length(uint8_t *out, long length) {
+	for (; length >= 255; length -= 255)
+		*out++ = 255;
+	*out++ = (uint8_t)length;
+	return out;
+}
+
+static long lz4_compress(const uint8_t *in, long size, uint8_t *out, uint32_t *table) {
+	const uint8_t *ip = in, *anchor = in, *end = in + size;
+	const uint8_t *match_limit = end - LZ4_LAST_LITERALS;
+	uint8_t *op = out;
+	memset(table, 0, sizeof(uint32_t) << LZ4_HASH_BITS);
+	if (size > LZ4_MATCH_LIMIT) {
+		const uint8_t *search_limit = end - LZ4_MATCH_LIMIT;
+		while (ip < search_limit) {
+			uint32_t sequence = lz4_read32(ip);
+			uint32_t hash = (sequence * 2654435761U) >> (32 - LZ4_HASH_BITS);
+			const uint8_t *ref = in + table[hash];
+			table[hash] = (uint32_t)(ip - in);
+			if (ref >= ip || ip - ref > 65535 || lz4_read32(ref) != sequence) {
+				// skip faster through data which doesn't compress
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+			while (ip > anchor && ref > in && ip[-1] == ref[-1]) {
+				ip--;
+				ref--;
+			}
+			const uint8_t *pnt = ip + LZ4_MIN_MATCH, *ref_pnt = ref + LZ4_MIN_MATCH;
+			while (pnt < match_limit && *pnt == *ref_pnt) {
+				pnt++;
+				ref_pnt++;
+			}
+			long literals = ip - anchor, match = pnt - ip - LZ4_MIN_MATCH;
+			uint8_t *token = op++;
+			*token = (uint8_t)((literals < 15 ? literals : 15) << 4 | (match < 15 ? match : 15));
+			if (literals >= 15)
+				op = lz4_put_length(op, literals - 15);
+			memcpy(op, anchor, literals);
+			op += literals;
+			*op++ = (uint8_t)(ip - ref);
+			*op++ = (uint8_t)((ip - ref) >> 8);
+			if (match >= 15)
+				op = lz4_put_length(op, match - 15);
+			anchor = ip = pnt;
+		}
+	}
+	long literals = end - anchor;
+	*op++ = (uint8_t)((literals < 15 ? literals : 15) << 4);
+	if (literals >= 15)
+		op = lz4_put_length(op, literals - 15);
+	memcpy(op, anchor, literals);
+	op += literals;
+	return op - out;
+}
+
+typedef struct {
+	uint8_t *in;
+	uint8_t *out;
+	unsigned long size;
+	int item_size;
+	long *sizes;
+} xisf_job;
+
+static void xisf_shuffle_kernel(void *data, long from, long to) {
+	xisf_job *job = data;
+	unsigned long items = job->size / job->item_size;
+	for (long i = from; i < to; i++)
+		for (int j = 0; j < job->item_size; j++)
+			job->out[j * items + i] = job->in[i * job->item_size + j];
+}
+
+// work is split by bytes, subblock is compressed by the chunk containing its first byte
+
+static void xisf_compress_kernel(void *data, long from, long to) {
+	xisf_job *job = data;
+	uint32_t *table = malloc(sizeof(uint32_t) << LZ4_HASH_BITS);
+	assert(table != NULL);
+	for (long block = (from + XISF_SUBBLOCK_SIZE - 1) / XISF_SUBBLOCK_SIZE; block * XISF_SUBBLOCK_SIZE < to; block++) {
+		long offset = block * XISF_SUBBLOCK_SIZE;
+		long size = job->size - offset < XISF_SUBBLOCK_SIZE ? job->size - offset : XISF_SUBBLOCK_SIZE;
+		job->sizes[block] = lz4_compress(job->in + offset, size, job->out + block * LZ4_BOUND(XISF_SUBBLOCK_SIZE), table);
+	}
+	free(table);
+}
+
+// block is compressed in place, if it doesn't get smaller, it is left intact and false is returned
+
+static bool compress_xisf_block(uint8_t *block, unsigned long *size, int item_size, image_header *attributes) {
+	unsigned long subblocks = (*size + XISF_SUBBLOCK_SIZE - 1) / XISF_SUBBLOCK_SIZE;
+	xisf_job job = { block, NULL, *size, item_size, NULL };
+	uint8_t *shuffled = NULL;
+	if (item_size > 1 && *size % item_size == 0) {
+		shuffled = malloc(*size);
+		assert(shuffled != NULL);
+		job.out = shuffled;
+		indigo_parallel(xisf_shuffle_kernel, &job, *size / item_size);
+		job.in = shuffled;
+	} else {
+		item_size = 1;
+	}
+	job.out = malloc(subblocks * LZ4_BOUND(XISF_SUBBLOCK_SIZE));
+	job.sizes = malloc(subblocks * sizeof(long));
+	assert(job.out != NULL && job.sizes != NULL);
+	indigo_parallel(xisf_compress_kernel, &job, *size);
+	unsigned long compressed_size = 0;
+	for (unsigned long i = 0; i < subblocks; i++)
+		compressed_size += job.sizes[i];
+	bool result = compressed_size < *size;
+	if (result) {
+		attributes->length = 0;
+		if (item_size > 1)
+			header_printf(attributes, " compression='lz4+sh:%lu:%d'", *size, item_size);
+		else
+			header_printf(attributes, " compression='lz4:%lu'", *size);
+		if (subblocks > 1) {
+			header_printf(attributes, " subblocks='");
+			for (unsigned long i = 0; i < subblocks; i++) {
+				unsigned long uncompressed_size = i < subblocks - 1 ? XISF_SUBBLOCK_SIZE : *size - i * XISF_SUBBLOCK_SIZE;
+				header_printf(attributes, "%s%ld,%lu", i ? ":" : "", job.sizes[i], uncompressed_size);
+			}
+			header_printf(attributes, "'");
+		}
+		uint8_t *out = block;
+		for (unsigned long i = 0; i < subblocks; i++) {
+			memcpy(out, job.out + i * LZ4_BOUND(XISF_SUBBLOCK_SIZE), job.sizes[i]);
+			out += job.sizes[i];
+		}
+		*size = compressed_size;
+	}
+	free(shuffled);
+	free(job.out);
+	free(job.sizes);
+	return result;
+}
+
+// preview is copied to shared buffer held by CCD_PREVIEW_IMAGE item, so BLOB cache retains it instead of making another copy,
+// the buffer is reused only if nobody else holds it
+
+static void publish_preview(indigo_device *device, void *data, unsigned long size) {
+	indigo_blob_buffer *buffer = CCD_PREVIEW_IMAGE_ITEM->blob.buffer;
+	if (buffer == NULL || buffer->size < (long)size || __atomic_load_n(&buffer->reference_count, __ATOMIC_ACQUIRE) > 1) {
+		buffer = indigo_alloc_shared_blob_buffer(size);
+		set_blob_buffer(CCD_PREVIEW_IMAGE_ITEM, buffer);
+		indigo_release_blob_buffer(buffer);
+	}
+	memcpy(buffer->content, data, size);
+	CCD_PREVIEW_IMAGE_ITEM->blob.value = buffer->content;
+	CCD_PREVIEW_IMAGE_ITEM->blob.size = size;
+	strcpy(CCD_PREVIEW_IMAGE_ITEM->blob.format, ".jpeg");
+	CCD_PREVIEW_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
+	indigo_update_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
 }
 
 void indigo_process_image(indigo_device *device, void *data, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords) {
 	assert(device != NULL);
 	assert(data != NULL);
+	pthread_mutex_lock(&CCD_CONTEXT->image_mutex);
 	INDIGO_DEBUG(clock_t start = clock());
 
-	int horizontal_bin = CCD_BIN_HORIZONTAL_ITEM->number.value;
-	int vertical_bin = CCD_BIN_VERTICAL_ITEM->number.value;
 	int byte_per_pixel = bpp / 8;
 	int naxis = 2;
 	unsigned long size = frame_width * frame_height;
@@ -911,24 +2569,28 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 
 	void *jpeg_data = NULL;
 	unsigned long jpeg_size = 0;
-	if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value || CCD_PREVIEW_ENABLED_ITEM->sw.value) {
-		raw_to_jpeg(device, data, frame_width, frame_height, bpp, little_endian, byte_order_rgb, &jpeg_data, &jpeg_size);
-		if (CCD_PREVIEW_ENABLED_ITEM->sw.value) {
-			if (jpeg_data) {
-				if (CCD_CONTEXT->preview_image) {
-					if (CCD_CONTEXT->preview_image_size < jpeg_size) {
-						CCD_CONTEXT->preview_image = realloc(CCD_CONTEXT->preview_image, CCD_CONTEXT->preview_image_size = jpeg_size);
-					}
-				} else {
-					CCD_CONTEXT->preview_image = malloc(CCD_CONTEXT->preview_image_size = jpeg_size);
-				}
-				memcpy(CCD_CONTEXT->preview_image, jpeg_data, jpeg_size);
-				CCD_PREVIEW_IMAGE_ITEM->blob.value = CCD_CONTEXT->preview_image;
-				CCD_PREVIEW_IMAGE_ITEM->blob.size = jpeg_size;
-				strcpy(CCD_PREVIEW_IMAGE_ITEM->blob.format, ".jpeg");
-				CCD_PREVIEW_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
-				indigo_update_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
-			}
+	// preview can be reduced to CCD_JPEG_SETTINGS.PREVIEW_WIDTH, then it is converted separately from JPEG image
+	int preview_width = CCD_JPEG_SETTINGS_PREVIEW_WIDTH_ITEM->number.value;
+	bool reduced_preview = preview_width > 0 && preview_width < frame_width;
+	// statistics are computed on request only, stretch histogram is taken from them if available
+	long histo[256] = { 0 };
+	long count = size * (naxis == 3 ? 3 : 1);
+	if (CCD_IMAGE_STATS_ENABLED_ITEM->sw.value)
+		update_image_stats(device, data, count, byte_per_pixel == 2, little_endian, histo);
+	else if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value || CCD_PREVIEW_ENABLED_ITEM->sw.value)
+		compute_stretch_histo(data, count, byte_per_pixel == 2, little_endian, histo);
+	if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value || (CCD_PREVIEW_ENABLED_ITEM->sw.value && !reduced_preview)) {
+		raw_to_jpeg(device, data, frame_width, frame_height, bpp, little_endian, byte_order_rgb, histo, 0, !CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value, &jpeg_data, &jpeg_size);
+	}
+	if (CCD_PREVIEW_ENABLED_ITEM->sw.value) {
+		void *preview_data = jpeg_data;
+		unsigned long preview_size = jpeg_size;
+		if (reduced_preview)
+			raw_to_jpeg(device, data, frame_width, frame_height, bpp, little_endian, byte_order_rgb, histo, preview_width, true, &preview_data, &preview_size);
+		if (preview_data) {
+			publish_preview(device, preview_data, preview_size);
+			if (preview_data != jpeg_data)
+				free(preview_data);
 		}
 	}
 
@@ -941,194 +2603,40 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		timer -= CCD_EXPOSURE_ITEM->number.target;
 		tm_info = gmtime(&timer);
 		strftime(date_time_end, 20, "%Y-%m-%dT%H:%M:%S", tm_info);
-		char *header = data;
-		memset(header, ' ', FITS_HEADER_SIZE);
-		int t = sprintf(header, "SIMPLE  =                    T / file conforms to FITS standard");
-		header[t] = ' ';
-		t = sprintf(header += 80, "BITPIX  = %20d / number of bits per data pixel", byte_per_pixel * 8);
-		header[t] = ' ';
-		t = sprintf(header += 80, "NAXIS   =                    %d / number of data axes", naxis);
-		header[t] = ' ';
-		t = sprintf(header += 80, "NAXIS1  = %20d / length of data axis 1 [pixels]", frame_width);
-		header[t] = ' ';
-		t = sprintf(header += 80, "NAXIS2  = %20d / length of data axis 2 [pixels]", frame_height);
-		header[t] = ' ';
-		if (naxis == 3) {
-			t = sprintf(header += 80, "NAXIS3  = %20d / length of data axis 3 [RGB]", 3);
-			header[t] = ' ';
-		}
-		t = sprintf(header += 80, "EXTEND  =                    T / FITS dataset may contain extensions");
-		header[t] = ' ';
-		t = sprintf(header += 80, "COMMENT   FITS (Flexible Image Transport System) format is defined in 'Astronomy");
-		header[t] = ' ';
-		t = sprintf(header += 80, "COMMENT   and Astrophysics', volume 376, page 359; bibcode: 2001A&A...376..359H");
-		header[t] = ' ';
-		t = sprintf(header += 80, "COMMENT   Created by INDIGO %d.%d framework, see www.indigo-astronomy.org", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
-		header[t] = ' ';
+		image_header header = { NULL, 0, 0 };
+		format_fits_logical(header_card(&header), "SIMPLE", true, "file conforms to FITS standard");
+		format_fits_number(header_card(&header), "BITPIX", byte_per_pixel * 8, 0, "number of bits per data pixel");
+		format_fits_number(header_card(&header), "NAXIS", naxis, 0, "number of data axes");
+		format_fits_number(header_card(&header), "NAXIS1", frame_width, 0, "length of data axis 1 [pixels]");
+		format_fits_number(header_card(&header), "NAXIS2", frame_height, 0, "length of data axis 2 [pixels]");
+		if (naxis == 3)
+			format_fits_number(header_card(&header), "NAXIS3", 3, 0, "length of data axis 3 [RGB]");
+		format_fits_logical(header_card(&header), "EXTEND", true, "FITS dataset may contain extensions");
+		format_fits_text(header_card(&header), "COMMENT   FITS (Flexible Image Transport System) format is defined in 'Astronomy");
+		format_fits_text(header_card(&header), "COMMENT   and Astrophysics', volume 376, page 359; bibcode: 2001A&A...376..359H");
+		char comment[FITS_CARD_SIZE + 1];
+		snprintf(comment, sizeof(comment), "COMMENT   Created by INDIGO %d.%d framework, see www.indigo-astronomy.org", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
+		format_fits_text(header_card(&header), comment);
 		if (byte_per_pixel == 2) {
-			t = sprintf(header += 80, "BZERO   =                32768 / offset data range to that of unsigned short");
-			header[t] = ' ';
-			t = sprintf(header += 80, "BSCALE  =                    1 / default scaling factor");
-			header[t] = ' ';
-		} else {
-		//	t = sprintf(header += 80, "BZERO   =                    0 / offset data range to that of unsigned short");
-		//	header[t] = ' ';
-		//	t = sprintf(header += 80, "BSCALE  =                  256 / default scaling factor");
-		//	header[t] = ' ';
-		}
-		t = sprintf(header += 80, "XBINNING= %20d / horizontal binning [pixels]", horizontal_bin);
-		header[t] = ' ';
-		t = sprintf(header += 80, "YBINNING= %20d / vertical binning [pixels]", vertical_bin);
-		header[t] = ' ';
-		if (CCD_INFO_PIXEL_WIDTH_ITEM->number.value > 0 && CCD_INFO_PIXEL_HEIGHT_ITEM->number.value) {
-			t = sprintf(header += 80, "XPIXSZ  = %20.2f / pixel width [microns]", CCD_INFO_PIXEL_WIDTH_ITEM->number.value * horizontal_bin);
-			indigo_fix_locale(header - 80);
-			header[t] = ' ';
-			t = sprintf(header += 80, "YPIXSZ  = %20.2f / pixel height [microns]", CCD_INFO_PIXEL_HEIGHT_ITEM->number.value * vertical_bin);
-			indigo_fix_locale(header - 80);
-			header[t] = ' ';
-		}
-		t = sprintf(header += 80, "EXPTIME = %20.2f / exposure time [s]", CCD_EXPOSURE_ITEM->number.target);
-		indigo_fix_locale(header - 80);
-		header[t] = ' ';
-		if (!CCD_TEMPERATURE_PROPERTY->hidden) {
-			t = sprintf(header += 80, "CCD-TEMP= %20.2f / CCD temperature [C]", CCD_TEMPERATURE_ITEM->number.value);
-			indigo_fix_locale(header - 80);
-			header[t] = ' ';
-		}
-		if (CCD_FRAME_TYPE_LIGHT_ITEM->sw.value)
-			t = sprintf(header += 80, "IMAGETYP= 'Light'               / frame type");
-		else if (CCD_FRAME_TYPE_FLAT_ITEM->sw.value)
-			t = sprintf(header += 80, "IMAGETYP= 'Flat'                / frame type");
-		else if (CCD_FRAME_TYPE_BIAS_ITEM->sw.value)
-			t = sprintf(header += 80, "IMAGETYP= 'Bias'                / frame type");
-		else if (CCD_FRAME_TYPE_DARK_ITEM->sw.value)
-			t = sprintf(header += 80, "IMAGETYP= 'Dark'                / frame type");
-		header[t] = ' ';
-		if (!CCD_GAIN_PROPERTY->hidden) {
-			t = sprintf(header += 80, "GAIN    = %20.2f / Gain", CCD_GAIN_ITEM->number.value);
-			indigo_fix_locale(header - 80);
-			header[t] = ' ';
-		}
-		if (!CCD_OFFSET_PROPERTY->hidden) {
-			t = sprintf(header += 80, "OFFSET  = %20.2f / Offset", CCD_OFFSET_ITEM->number.value);
-			indigo_fix_locale(header - 80);
-			header[t] = ' ';
-		}
-		if (!CCD_GAMMA_PROPERTY->hidden) {
-			t = sprintf(header += 80, "GAMMA   = %20.2f / Gamma", CCD_GAMMA_ITEM->number.value);
-			indigo_fix_locale(header - 80);
-			header[t] = ' ';
-		}
-		t = sprintf(header += 80, "DATE-OBS= '%s' / UTC date that FITS file was created", date_time_end);
-		header[t] = ' ';
-		t = sprintf(header += 80, "INSTRUME= '%s'%*c / instrument name", device->name, (int)(19 - strlen(device->name)), ' ');
-		header[t] = ' ';
-		if (keywords) {
-			while (keywords->type && (header - (char *)data) < (FITS_HEADER_SIZE - 80)) {
-				switch (keywords->type) {
-					case INDIGO_FITS_NUMBER:
-						t = sprintf(header += 80, "%7s= %20f / %s", keywords->name, keywords->number, keywords->comment);
-						indigo_fix_locale(header - 80);
-						break;
-					case INDIGO_FITS_STRING:
-						t = sprintf(header += 80, "%7s= '%s'%*c / %s", keywords->name, keywords->string, (int)(18 - strlen(keywords->string)), ' ', keywords->comment);
-						break;
-					case INDIGO_FITS_LOGICAL:
-						t = sprintf(header += 80, "%7s=                    %c / %s", keywords->name, keywords->logical ? 'T' : 'F', keywords->comment);
-						break;
-				}
-				header[t] = ' ';
-				keywords++;
-			}
-		}
-		for (int i = 0; i < CCD_FITS_HEADERS_PROPERTY->count; i++) {
-			indigo_item *item = CCD_FITS_HEADERS_PROPERTY->items + i;
-			if (*item->text.value && (header - (char *)data) < (FITS_HEADER_SIZE - 80)) {
-				t = sprintf(header += 80, "%s", item->text.value);
-				header[t] = ' ';
-			}
+			format_fits_number(header_card(&header), "BZERO", 32768, 0, "offset data range to that of unsigned short");
+			format_fits_number(header_card(&header), "BSCALE", 1, 0, "default scaling factor");
 		}
-		t = sprintf(header += 80, "END");
-		header[t] = ' ';
+		add_image_cards(device, &header, date_time_end, keywords);
+		format_fits_text(header_card(&header), "END");
+		header_pad(&header, FITS_BLOCKS(header.length), ' ');
+		image_job job = { .in = data + FITS_HEADER_SIZE, .size = size, .components = 3, .little_endian = little_endian, .byte_order_rgb = byte_order_rgb };
 		if (byte_per_pixel == 2 && naxis == 2) {
-			short *raw = (short *)(data + FITS_HEADER_SIZE);
-			if (little_endian) {
-				for (int i = 0; i < size; i++) {
-					int value = *raw - 32768;
-					*raw++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				}
-			} else {
-				for (int i = 0; i < size; i++) {
-					int value = *raw;
-					value = ((value & 0xff) << 8 | (value & 0xff00) >> 8 ) - 32768;
-					*raw++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				}
-			}
+			indigo_parallel(fits_mono16_kernel, &job, size);
 		} else if (byte_per_pixel == 1 && naxis == 3) {
-			unsigned char *raw = malloc(3 * size);
-			unsigned char *red = raw;
-			unsigned char *green = raw + size;
-			unsigned char *blue = raw + 2 * size;
-			unsigned char *tmp = data + FITS_HEADER_SIZE;
-			if (byte_order_rgb) {
-				for (int i = 0; i < size; i++) {
-					*red++ = *tmp++;
-					*green++ = *tmp++;
-					*blue++ = *tmp++;
-				}
-			} else {
-				for (int i = 0; i < size; i++) {
-					*blue++ = *tmp++;
-					*green++ = *tmp++;
-					*red++ = *tmp++;
-				}
-			}
-			memcpy(data + FITS_HEADER_SIZE, raw, 3 * size);
-			free(raw);
+			job.out = malloc(3 * size);
+			indigo_parallel(fits_rgb24_kernel, &job, size);
+			memcpy(data + FITS_HEADER_SIZE, job.out, 3 * size);
+			free(job.out);
 		} else if (byte_per_pixel == 2 && naxis == 3) {
-			unsigned short *raw = malloc(6 * size);
-			unsigned short *red = raw;
-			unsigned short *green = raw + size;
-			unsigned short *blue = raw + 2 * size;
-			unsigned short *tmp = (unsigned short *)(data + FITS_HEADER_SIZE);
-			if (little_endian) {
-				if (byte_order_rgb) {
-					for (int i = 0; i < size; i++) {
-						int value = *tmp++ - 32768;
-						*red++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *tmp++ - 32768;
-						*green++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *tmp++ - 32768;
-						*blue++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-					}
-				} else {
-					for (int i = 0; i < size; i++) {
-						int value = *tmp++ - 32768;
-						*blue++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *tmp++ - 32768;
-						*green++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *tmp++ - 32768;
-						*red++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-					}
-				}
-			} else {
-				if (byte_order_rgb) {
-					for (int i = 0; i < size; i++) {
-						*red++ = *tmp++;
-						*green++ = *tmp++;
-						*blue++ = *tmp++;
-					}
-				} else {
-					for (int i = 0; i < size; i++) {
-						*blue++ = *tmp++;
-						*green++ = *tmp++;
-						*red++ = *tmp++;
-					}
-				}
-			}
-			memcpy(data + FITS_HEADER_SIZE, raw, 6 * size);
-			free(raw);
+			job.out = malloc(6 * size);
+			indigo_parallel(fits_rgb48_kernel, &job, size);
+			memcpy(data + FITS_HEADER_SIZE, job.out, 6 * size);
+			free(job.out);
 		}
 		int mod2880 = blobsize % 2880;
 		if (mod2880) {
@@ -1138,8 +2646,21 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 				blobsize += padding;
 			}
 		}
+		data = place_image_header(device, data, &header, &blobsize);
+		free(header.buffer);
 		INDIGO_DEBUG(indigo_debug("RAW to FITS conversion in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
-	} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value) {
+	} else if (CCD_IMAGE_FORMAT_FITS_RICE_ITEM->sw.value) {
+		INDIGO_DEBUG(clock_t start = clock());
+		time_t timer;
+		struct tm* tm_info;
+		char date_time_end[20];
+		time(&timer);
+		timer -= CCD_EXPOSURE_ITEM->number.target;
+		tm_info = gmtime(&timer);
+		strftime(date_time_end, 20, "%Y-%m-%dT%H:%M:%S", tm_info);
+		data = build_rice_fits(device, data, frame_width, frame_height, naxis, byte_per_pixel, little_endian, byte_order_rgb, date_time_end, keywords, &blobsize);
+		INDIGO_DEBUG(indigo_debug("RAW to FITS (Rice) conversion in %gs, %lu bytes", (clock() - start) / (double)CLOCKS_PER_SEC, FITS_HEADER_SIZE + blobsize));
+	} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value || CCD_IMAGE_FORMAT_XISF_LZ4_ITEM->sw.value) {
 		INDIGO_DEBUG(clock_t start = clock());
 		time_t timer;
 		struct tm* tm_info;
@@ -1151,118 +2672,15 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		tm_info = gmtime(&timer);
 		strftime(date_time_start, 21, "%Y-%m-%dT%H:%M:%SZ", tm_info);
 		strftime(fits_date_obs, 21, "%Y-%m-%dT%H:%M:%S", tm_info);
-		char *header = data;
-		strcpy(header, "XISF0100");
-		header += 16;
-		memset(header, 0, FITS_HEADER_SIZE);
-		sprintf(header, "<?xml version='1.0' encoding='UTF-8'?><xisf xmlns='http://www.pixinsight.com/xisf' xmlns:xsi='http://www.w3.org/2001/XMLSchema-instance' version='1.0' xsi:schemaLocation='http://www.pixinsight.com/xisf http://pixinsight.com/xisf/xisf-1.0.xsd'>");
-		header += strlen(header);
-		char *frame_type = "Light";
-		char b1[32], b2[32];
-		if (CCD_FRAME_TYPE_FLAT_ITEM->sw.value)
-			frame_type ="Flat";
-		else if (CCD_FRAME_TYPE_BIAS_ITEM->sw.value)
-			frame_type ="Bias";
-		else if (CCD_FRAME_TYPE_DARK_ITEM->sw.value)
-			frame_type ="Dark";
-		if (naxis == 2 && byte_per_pixel == 1) {
-			sprintf(header, "<Image geometry='%d:%d:1' imageType='%s' sampleFormat='UInt8' colorSpace='Gray' location='attachment:%d:%lu'>", frame_width, frame_height, frame_type, FITS_HEADER_SIZE, blobsize);
-		} else if (naxis == 2 && byte_per_pixel == 2) {
-			sprintf(header, "<Image geometry='%d:%d:1' imageType='%s' sampleFormat='UInt16' colorSpace='Gray' location='attachment:%d:%lu'>", frame_width, frame_height, frame_type, FITS_HEADER_SIZE, blobsize);
-		} else if (naxis == 3 && byte_per_pixel == 1) {
-			sprintf(header, "<Image geometry='%d:%d:3' imageType='%s' pixelStorage='Normal' sampleFormat='UInt8' colorSpace='RGB' location='attachment:%d:%lu'>", frame_width, frame_height, frame_type, FITS_HEADER_SIZE, blobsize);
-		} else if (naxis == 3 && byte_per_pixel == 2) {
-			sprintf(header, "<Image geometry='%d:%d:3' imageType='%s' pixelStorage='Normal' sampleFormat='UInt16' colorSpace='RGB' location='attachment:%d:%lu'>", frame_width, frame_height, frame_type, FITS_HEADER_SIZE, blobsize);
-		}
-		header += strlen(header);
-		sprintf(header, "<Property id='Observation:Time:Start' type='TimePoint' value='%s'/><Property id='Observation:Time:End' type='TimePoint' value='%s'/>", date_time_start ,date_time_end);
-		header += strlen(header);
-		sprintf(header, "<FITSKeyword name='DATE-OBS' value='%s' comment='Observation start time, UT'/>", fits_date_obs );
-		header += strlen(header);
-		sprintf(header, "<Property id='Instrument:Camera:Name' type='String'>%s</Property>", device->name);
-		header += strlen(header);
-		sprintf(header, "<FITSKeyword name='INSTRUME' value='%s' comment='Instrument'/>", device->name);
-		header += strlen(header);
-		sprintf(header, "<Property id='Instrument:Camera:XBinning' type='Int32' value='%d'/><Property id='Instrument:Camera:YBinning' type='Int32' value='%d'/>", horizontal_bin, vertical_bin);
-		header += strlen(header);
-		sprintf(header, "<FITSKeyword name='XBINNING' value='%d' comment='Binning factor, X-axis'/><FITSKeyword name='YBINNING' value='%d' comment='Binning factor, Y-axis'/>", horizontal_bin, vertical_bin);
-		header += strlen(header);
-		sprintf(header, "<Property id='Instrument:ExposureTime' type='Float32' value='%s'/>", indigo_dtoa(CCD_EXPOSURE_ITEM->number.target, b1));
-		header += strlen(header);
-		sprintf(header, "<FITSKeyword name='EXPTIME'  value='%20.2f' comment='Exposure time in seconds'/>", CCD_EXPOSURE_ITEM->number.target);
-		header += strlen(header);
-		sprintf(header, "<Property id='Instrument:Sensor:XPixelSize' type='Float32' value='%s'/><Property id='Instrument:Sensor:YPixelSize' type='Float32' value='%s'/>", indigo_dtoa(CCD_INFO_PIXEL_WIDTH_ITEM->number.value * horizontal_bin, b1), indigo_dtoa(CCD_INFO_PIXEL_HEIGHT_ITEM->number.value * vertical_bin, b2));
-		header += strlen(header);
-		sprintf(header, "<FITSKeyword name='XPIXSZ'  value='%20.2f' comment='Pixel horizontal width in microns'/><FITSKeyword name='YPIXSZ' value='%20.2f' comment='Pixel vertical width in microns'/>", CCD_INFO_PIXEL_WIDTH_ITEM->number.value * horizontal_bin, CCD_INFO_PIXEL_HEIGHT_ITEM->number.value * vertical_bin);
-		header += strlen(header);
-
-		if (!CCD_TEMPERATURE_PROPERTY->hidden) {
-			sprintf(header, "<Property id='Instrument:Sensor:Temperature' type='Float32' value='%s'/><Property id='Instrument:Sensor:TargetTemperature' type='Float32' value='%s'/>", indigo_dtoa(CCD_TEMPERATURE_ITEM->number.value, b1), indigo_dtoa(CCD_TEMPERATURE_ITEM->number.target, b2));
-			header += strlen(header);
-			sprintf(header, "<FITSKeyword name='CCD-TEMP' value='%20.2f' comment='CCD chip temperature in celsius'/>", CCD_TEMPERATURE_ITEM->number.value );
-			header += strlen(header);
-
-		}
-		if (!CCD_GAIN_PROPERTY->hidden) {
-			sprintf(header, "<Property id='Instrument:Camera:Gain' type='Float32' value='%s'/>", indigo_dtoa(CCD_GAIN_ITEM->number.value, b1));
-			header += strlen(header);
-			sprintf(header, "<FITSKeyword name='GAIN' value='%20.2f' comment='Gain'/>", CCD_GAIN_ITEM->number.value);
-			header += strlen(header);
-		}
-		for (int i = 0; i < CCD_FITS_HEADERS_PROPERTY->count; i++) {
-			indigo_item *item = CCD_FITS_HEADERS_PROPERTY->items + i;
-			if (!strncmp(item->text.value, "FILTER=", 7)) {
-				sprintf(header, "<Property id='Instrument:Filter:Name' type='String' value='%s'/>", item->text.value + 7);
-				header += strlen(header);
-				sprintf(header, "<FITSKeyword name='FILTER' value='%s'/>", item->text.value + 7);
-				header += strlen(header);
-			} else if (!strncmp(item->text.value, "FOCUS=", 6)) {
-				sprintf(header, "<Property id='Instrument:Focuser:Position' type='String' value='%s'/>", item->text.value + 6);
-				header += strlen(header);
-			}
-		}
-		if (keywords) {
-			while (keywords->type) {
-				if (!strcmp(keywords->name, "BAYERPAT")) {
-					sprintf(header, "<ColorFilterArray pattern='%s' width='2' height='2'/>", keywords->string);
-					header += strlen(header);
-				}
-				keywords++;
-			}
-		}
-		sprintf(header, "</Image><Metadata><Property id='XISF:CreationTime' type='String'>%s</Property><Property id='XISF:CreatorApplication' type='String'>INDIGO 2.0-%s</Property>", date_time_end, INDIGO_BUILD);
-		header += strlen(header);
-#ifdef INDIGO_LINUX
-		sprintf(header, "<Property id='XISF:CreatorOS' type='String'>Linux</Property>");
-#endif
-#ifdef INDIGO_MACOS
-		sprintf(header, "<Property id='XISF:CreatorOS' type='String'>macOS</Property>");
-#endif
-#ifdef INDIGO_WINDOWS
-		sprintf(header, "<Property id='XISF:CreatorOS' type='String'>Windows</Property>");
-#endif
-		header += strlen(header);
-		sprintf(header, "<Property id='XISF:BlockAlignmentSize' type='UInt16' value='2880'/></Metadata></xisf>");
-		header += strlen(header);
-		*(uint32_t *)(data + 8) = (uint32_t)(header - (char *)data) - 16;
 		if (naxis == 2 && byte_per_pixel == 2) {
 			if (!little_endian) {
-				short *b16 = (short *)(data + FITS_HEADER_SIZE);
-				for (int i = 0; i < size; i++) {
-					int value = *b16;
-					*b16++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				}
+				image_job job = { .in = data + FITS_HEADER_SIZE };
+				indigo_parallel(swap16_kernel, &job, size);
 			}
 		} else if (naxis == 3 && byte_per_pixel == 1) {
 			if (!byte_order_rgb) {
-				unsigned char *b8 = data + FITS_HEADER_SIZE;
-				for (int i = 0; i < size; i++) {
-					unsigned char b = *b8;
-					unsigned char r = *(b8 + 2);
-					*b8 = r;
-					*(b8 + 2) = b;
-					b8 += 3;
-				}
+				image_job job = { .in = data + FITS_HEADER_SIZE };
+				indigo_parallel(swap_rb24_kernel, &job, size);
 			}
 		} else if (naxis == 3 && byte_per_pixel == 2) {
 			unsigned char *b16 = data + FITS_HEADER_SIZE;
@@ -1298,7 +2716,26 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 				}
 			}
 		}
-		INDIGO_DEBUG(indigo_debug("RAW to XISF conversion in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+		image_header compression = { NULL, 0, 0 };
+		if (CCD_IMAGE_FORMAT_XISF_LZ4_ITEM->sw.value)
+			compress_xisf_block(data + FITS_HEADER_SIZE, &blobsize, byte_per_pixel, &compression);
+		image_header cards = { NULL, 0, 0 };
+		add_image_cards(device, &cards, fits_date_obs, keywords);
+		// attachment offset is part of XML, so it is generated again if it doesn't fit FITS_HEADER_SIZE
+		image_header header = { NULL, 0, 0 };
+		long offset = FITS_HEADER_SIZE;
+		while (true) {
+			build_xisf_header(device, &header, &cards, frame_width, frame_height, naxis, byte_per_pixel, blobsize, offset, compression.length ? compression.buffer : "", date_time_start, date_time_end);
+			if (header.length <= offset)
+				break;
+			offset = FITS_BLOCKS(header.length);
+		}
+		header_pad(&header, offset, 0);
+		free(cards.buffer);
+		free(compression.buffer);
+		data = place_image_header(device, data, &header, &blobsize);
+		free(header.buffer);
+		INDIGO_DEBUG(indigo_debug("RAW to XISF conversion in %gs, %lu bytes", (clock() - start) / (double)CLOCKS_PER_SEC, FITS_HEADER_SIZE + blobsize));
 	} else if (CCD_IMAGE_FORMAT_RAW_ITEM->sw.value) {
 		indigo_raw_header *header = (indigo_raw_header *)(data + FITS_HEADER_SIZE - sizeof(indigo_raw_header));
 		if (naxis == 2 && byte_per_pixel == 1)
@@ -1306,23 +2743,14 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		else if (naxis == 2 && byte_per_pixel == 2) {
 			header->signature = INDIGO_RAW_MONO16;
 			if (!little_endian) {
-				short *b16 = (short *)(data + FITS_HEADER_SIZE);
-				for (int i = 0; i < size; i++) {
-					int value = *b16;
-					*b16++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				}
+				image_job job = { .in = data + FITS_HEADER_SIZE };
+				indigo_parallel(swap16_kernel, &job, size);
 			}
 		} else if (naxis == 3 && byte_per_pixel == 1) {
 			header->signature = INDIGO_RAW_RGB24;
 			if (!byte_order_rgb) {
-				unsigned char *b8 = data + FITS_HEADER_SIZE;
-				for (int i = 0; i < size; i++) {
-					unsigned char b = *b8;
-					unsigned char r = *(b8 + 2);
-					*b8 = r;
-					*(b8 + 2) = b;
-					b8 += 3;
-				}
+				image_job job = { .in = data + FITS_HEADER_SIZE };
+				indigo_parallel(swap_rb24_kernel, &job, size);
 			}
 		} else if (naxis == 3 && byte_per_pixel == 2) {
 			header->signature = INDIGO_RAW_RGB48;
@@ -1373,7 +2801,9 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		char *suffix = "";
 		if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value) {
 			suffix = ".fits";
-		} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value) {
+		} else if (CCD_IMAGE_FORMAT_FITS_RICE_ITEM->sw.value) {
+			suffix = ".fits.fz";
+		} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value || CCD_IMAGE_FORMAT_XISF_LZ4_ITEM->sw.value) {
 			suffix = ".xisf";
 		} else if (CCD_IMAGE_FORMAT_RAW_ITEM->sw.value) {
 			suffix = ".raw";
@@ -1384,68 +2814,28 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		char *message = NULL;
 		if (strlen(dir) + strlen(prefix) + strlen(suffix) < INDIGO_VALUE_SIZE) {
 			char file_name[INDIGO_VALUE_SIZE];
-			char *placeholder = strstr(prefix, "XXX");
-			if (placeholder == NULL) {
-				strncpy(file_name, dir, INDIGO_VALUE_SIZE);
-				strcat(file_name, prefix);
-				strcat(file_name, suffix);
-			} else {
-				char format[INDIGO_VALUE_SIZE];
-				strcpy(format, dir);
-				strncat(format, prefix, placeholder - prefix);
-				if (!strncmp(placeholder, "XXXX", 4)) {
-					strcat(format, "%04d");
-					strcat(format, placeholder + 4);
-				} else {
-					strcat(format, "%03d");
-					strcat(format, placeholder + 3);
-				}
-				strcat(format, suffix);
-				struct stat sb;
-				int i = 1;
-				while (i < 10000) {
-					snprintf(file_name, sizeof(file_name), format, i);
-					if (stat(file_name, &sb) == 0 && S_ISREG(sb.st_mode))
-						i++;
-					else
-						break;
-				}
-			}
-			strncpy(CCD_IMAGE_FILE_ITEM->text.value, file_name, INDIGO_VALUE_SIZE);
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
-			handle = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-			if (handle) {
-				if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value) {
-					if (!indigo_write(handle, data, FITS_HEADER_SIZE + blobsize)) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-						message = strerror(errno);
-					}
-				} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value) {
-					if (!indigo_write(handle, data, FITS_HEADER_SIZE + blobsize)) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-						message = strerror(errno);
-					}
+			bool direct;
+			handle = open_local_image_file(device, suffix, file_name, &direct);
+			if (handle >= 0) {
+				if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value || CCD_IMAGE_FORMAT_FITS_RICE_ITEM->sw.value || CCD_IMAGE_FORMAT_XISF_ITEM->sw.value || CCD_IMAGE_FORMAT_XISF_LZ4_ITEM->sw.value) {
+					queue_image_file(device, handle, direct, file_name, data, FITS_HEADER_SIZE + blobsize);
 				} else if (CCD_IMAGE_FORMAT_RAW_ITEM->sw.value) {
-					if (!indigo_write(handle, data + FITS_HEADER_SIZE - sizeof(indigo_raw_header), blobsize + sizeof(indigo_raw_header))) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-						message = strerror(errno);
-					}
+					queue_image_file(device, handle, direct, file_name, data + FITS_HEADER_SIZE - sizeof(indigo_raw_header), blobsize + sizeof(indigo_raw_header));
 				} else if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value) {
-					if (!indigo_write(handle, data, blobsize)) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-						message = strerror(errno);
-					}
+					queue_image_file(device, handle, direct, file_name, data, blobsize);
+				} else {
+					close(handle);
 				}
-				close(handle);
 			} else {
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
 				message = strerror(errno);
 			}
 		} else {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
 			message = "dir + prefix + suffix is too long";
 		}
-		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
+		if (message) {
+			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
+		}
 		INDIGO_DEBUG(indigo_debug("Local save in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
 	}
 	if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
@@ -1454,7 +2844,11 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 			CCD_IMAGE_ITEM->blob.value = data;
 			CCD_IMAGE_ITEM->blob.size = FITS_HEADER_SIZE + blobsize;
 			strcpy(CCD_IMAGE_ITEM->blob.format, ".fits");
-		} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value) {
+		} else if (CCD_IMAGE_FORMAT_FITS_RICE_ITEM->sw.value) {
+			CCD_IMAGE_ITEM->blob.value = data;
+			CCD_IMAGE_ITEM->blob.size = FITS_HEADER_SIZE + blobsize;
+			strcpy(CCD_IMAGE_ITEM->blob.format, ".fits.fz");
+		} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value || CCD_IMAGE_FORMAT_XISF_LZ4_ITEM->sw.value) {
 			CCD_IMAGE_ITEM->blob.value = data;
 			CCD_IMAGE_ITEM->blob.size = FITS_HEADER_SIZE + blobsize;
 			strcpy(CCD_IMAGE_ITEM->blob.format, ".xisf");
@@ -1467,12 +2861,14 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 			CCD_IMAGE_ITEM->blob.size = blobsize;
 			strcpy(CCD_IMAGE_ITEM->blob.format, ".jpeg");
 		}
+		set_blob_buffer(CCD_IMAGE_ITEM, frame_pool_buffer(device, CCD_IMAGE_ITEM->blob.value));
 		CCD_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
 		indigo_update_property(device, CCD_IMAGE_PROPERTY, NULL);
 		INDIGO_DEBUG(indigo_debug("Client upload in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
 	}
 	if (jpeg_data)
 		free(jpeg_data);
+	pthread_mutex_unlock(&CCD_CONTEXT->image_mutex);
 }
 
 void indigo_process_dslr_image(indigo_device *device, void *data, int blobsize, const char *suffix) {
@@ -1492,71 +2888,38 @@ void indigo_process_dslr_image(indigo_device *device, void *data, int blobsize,
 		char *message = NULL;
 		if (strlen(dir) + strlen(prefix) + strlen(standard_suffix) < INDIGO_VALUE_SIZE) {
 			char file_name[INDIGO_VALUE_SIZE];
-			char *xxx = strstr(prefix, "XXX");
-			if (xxx == NULL) {
-				strncpy(file_name, dir, INDIGO_VALUE_SIZE - strlen(prefix) - strlen(standard_suffix));
-				strcat(file_name, prefix);
-				strcat(file_name, standard_suffix);
+			bool direct;
+			handle = open_local_image_file(device, standard_suffix, file_name, &direct);
+			if (handle >= 0) {
+				queue_image_file(device, handle, direct, file_name, data, blobsize);
 			} else {
-				char format[INDIGO_VALUE_SIZE];
-				strncpy(format, dir, INDIGO_VALUE_SIZE);
-				strncat(format, prefix, xxx - prefix);
-				strcat(format, "%03d");
-				strcat(format, xxx+3);
-				strcat(format, standard_suffix);
-				struct stat sb;
-				int i = 1;
-				while (true) {
-					snprintf(file_name, sizeof(file_name), format, i);
-					if (stat(file_name, &sb) == 0 && S_ISREG(sb.st_mode))
-						i++;
-					else
-						break;
-				}
-			}
-			strncpy(CCD_IMAGE_FILE_ITEM->text.value, file_name, INDIGO_VALUE_SIZE);
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
-			handle = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-			if (handle) {
-				if (!indigo_write(handle, data, blobsize)) {
-					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-					message = strerror(errno);
-				}
-				close(handle);
-			} else {
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
 				message = strerror(errno);
 			}
 		} else {
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
 			message = "dir + prefix + suffix is too long";
 		}
-		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
+		if (message) {
+			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
+		}
 		INDIGO_DEBUG(indigo_debug("Local save in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
 	}
 	if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
+		pthread_mutex_lock(&CCD_CONTEXT->image_mutex);
 		*CCD_IMAGE_ITEM->blob.url = 0;
 		CCD_IMAGE_ITEM->blob.value = data;
 		CCD_IMAGE_ITEM->blob.size = blobsize;
 		strncpy(CCD_IMAGE_ITEM->blob.format, standard_suffix, INDIGO_NAME_SIZE);
+		set_blob_buffer(CCD_IMAGE_ITEM, NULL);
 		CCD_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
 		indigo_update_property(device, CCD_IMAGE_PROPERTY, NULL);
+		pthread_mutex_unlock(&CCD_CONTEXT->image_mutex);
 		INDIGO_DEBUG(indigo_debug("Client upload in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
 	}
 }
 
 void indigo_process_dslr_preview_image(indigo_device *device, void *data, int blobsize) {
-	if (CCD_CONTEXT->preview_image) {
-		if (CCD_CONTEXT->preview_image_size < blobsize) {
-			CCD_CONTEXT->preview_image = realloc(CCD_CONTEXT->preview_image, CCD_CONTEXT->preview_image_size = blobsize);
-		}
-	} else {
-		CCD_CONTEXT->preview_image = malloc(CCD_CONTEXT->preview_image_size = blobsize);
-	}
-	memcpy(CCD_CONTEXT->preview_image, data, blobsize);
-	CCD_PREVIEW_IMAGE_ITEM->blob.value = CCD_CONTEXT->preview_image;
-	CCD_PREVIEW_IMAGE_ITEM->blob.size = blobsize;
-	strcpy(CCD_PREVIEW_IMAGE_ITEM->blob.format, ".jpeg");
-	CCD_PREVIEW_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
-	indigo_update_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
+	pthread_mutex_lock(&CCD_CONTEXT->image_mutex);
+	publish_preview(device, data, blobsize);
+	pthread_mutex_unlock(&CCD_CONTEXT->image_mutex);
 }
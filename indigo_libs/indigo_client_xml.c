@@ -49,15 +49,13 @@
 #include <indigo/indigo_version.h>
 #include <indigo/indigo_client_xml.h>
 
-static pthread_mutex_t xml_mutex = PTHREAD_MUTEX_INITIALIZER;
-
 static indigo_result xml_client_parser_enumerate_properties(indigo_device *device, indigo_client *client, indigo_property *property) {
 	assert(device != NULL);
 	if (!indigo_reshare_remote_devices && client && client->is_remote)
 		return INDIGO_OK;
-	pthread_mutex_lock(&xml_mutex);
 	indigo_adapter_context *device_context = (indigo_adapter_context *)device->device_context;
 	assert(device_context != NULL);
+	pthread_mutex_lock(&device_context->mutex);
 	int handle = device_context->output;
 	char device_name[INDIGO_NAME_SIZE];
 	if (property != NULL && *property->device) {
@@ -84,7 +82,7 @@ static indigo_result xml_client_parser_enumerate_properties(indigo_device *devic
 	} else {
 		indigo_printf(handle, "<getProperties version='1.7' switch='%d.%d'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
 	}
-	pthread_mutex_unlock(&xml_mutex);
+	pthread_mutex_unlock(&device_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -93,9 +91,9 @@ static indigo_result xml_client_parser_change_property(indigo_device *device, in
 	assert(property != NULL);
 	if (!indigo_reshare_remote_devices && client && client->is_remote)
 		return INDIGO_OK;
-	pthread_mutex_lock(&xml_mutex);
 	indigo_adapter_context *device_context = (indigo_adapter_context *)device->device_context;
 	assert(device_context != NULL);
+	pthread_mutex_lock(&device_context->mutex);
 	int handle = device_context->output;
 	char device_name[INDIGO_NAME_SIZE];
 	char b1[32];
@@ -136,7 +134,7 @@ static indigo_result xml_client_parser_change_property(indigo_device *device, in
 	default:
 		break;
 	}
-	pthread_mutex_unlock(&xml_mutex);
+	pthread_mutex_unlock(&device_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -145,9 +143,9 @@ static indigo_result xml_client_parser_enable_blob(indigo_device *device, indigo
 	assert(property != NULL);
 	if (!indigo_reshare_remote_devices && client && client->is_remote)
 		return INDIGO_OK;
-	pthread_mutex_lock(&xml_mutex);
 	indigo_adapter_context *device_context = (indigo_adapter_context *)device->device_context;
 	assert(device_context != NULL);
+	pthread_mutex_lock(&device_context->mutex);
 	int handle = device_context->output;
 	char device_name[INDIGO_NAME_SIZE];
 	strncpy(device_name, property->device, INDIGO_NAME_SIZE);
@@ -164,11 +162,13 @@ static indigo_result xml_client_parser_enable_blob(indigo_device *device, indigo
 		mode_text = "Never";
 	else if (mode == INDIGO_ENABLE_BLOB_URL && device->version >= INDIGO_VERSION_2_0)
 		mode_text = "URL";
+	else if ((mode == INDIGO_ENABLE_BLOB_ALSO || mode == INDIGO_ENABLE_BLOB_BINARY) && device->version >= INDIGO_VERSION_2_0)
+		mode_text = "Binary"; // legacy INDIGO servers handle unknown mode as "Also"
 	if (*property->name)
 		indigo_printf(handle, "<enableBLOB device='%s' name='%s'>%s</enableBLOB>\n", indigo_xml_escape(device_name), indigo_property_name(device->version, property), mode_text);
 	else
 		indigo_printf(handle, "<enableBLOB device='%s'>%s</enableBLOB>\n", indigo_xml_escape(device_name), mode_text);
-	pthread_mutex_unlock(&xml_mutex);
+	pthread_mutex_unlock(&device_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -195,9 +195,11 @@ indigo_device *indigo_xml_client_adapter(char *name, char *url_prefix, int input
 	device->is_remote = input == output; // is socket, otherwise is pipe
 	indigo_adapter_context *device_context = malloc(sizeof(indigo_adapter_context));
 	assert(device_context != NULL);
+	memset(device_context, 0, sizeof(indigo_adapter_context));
 	device_context->input = input;
 	device_context->output = output;
 	strncpy(device_context->url_prefix, url_prefix, INDIGO_NAME_SIZE);
+	pthread_mutex_init(&device_context->mutex, NULL);
 	device->device_context = device_context;
 	return device;
 }
@@ -516,6 +516,7 @@ indigo_result indigo_load_properties(indigo_device *device, bool default_propert
 		memset(client, 0, sizeof(indigo_client));
 		strcpy(client->name, CONFIG_READER);
 		indigo_adapter_context *context = malloc(sizeof(indigo_adapter_context));
+		memset(context, 0, sizeof(indigo_adapter_context));
 		context->input = handle;
 		client->client_context = context;
 		client->version = INDIGO_VERSION_CURRENT;
@@ -41,32 +41,42 @@
 //#undef INDIGO_TRACE_PROTOCOL
 //#define INDIGO_TRACE_PROTOCOL(c) c
 
-static pthread_mutex_t json_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-static void ws_write(int handle, const char *buffer, long length) {
-	uint8_t header[10] = { 0x81 };
-	if (length <= 0x7D) {
-		header[1] = length;
-		indigo_write(handle, (char *)header, 2);
-	} else if (length <= 0xFFFF) {
-		header[1] = 0x7E;
-		uint16_t payloadLength = htons(length);
-		memcpy(header+2, &payloadLength, 2);
-		indigo_write(handle, (char *)header, 4);
-	} else {
-		header[1] = 0x7F;
-		uint64_t payloadLength = htonll(length);
-		memcpy(header+2, &payloadLength, 8);
-		indigo_write(handle, (char *)header, 10);
+static bool queue_message(indigo_adapter_context *client_context, indigo_property *property, indigo_queue_policy policy, const char *buffer, long length) {
+	indigo_message message = { 0 };
+	if (client_context->web_socket) {
+		uint8_t header[10] = { 0x81 };
+		if (length <= 0x7D) {
+			header[1] = length;
+			indigo_message_append(&message, (char *)header, 2);
+		} else if (length <= 0xFFFF) {
+			header[1] = 0x7E;
+			uint16_t payloadLength = htons(length);
+			memcpy(header+2, &payloadLength, 2);
+			indigo_message_append(&message, (char *)header, 4);
+		} else {
+			header[1] = 0x7F;
+			uint64_t payloadLength = htonll(length);
+			memcpy(header+2, &payloadLength, 8);
+			indigo_message_append(&message, (char *)header, 10);
+		}
+	}
+	indigo_message_append(&message, buffer, length);
+	if (client_context->output_queue) {
+		char key[2 * INDIGO_NAME_SIZE] = "";
+		if (property != NULL)
+			snprintf(key, sizeof(key), "%s.%s", property->device, property->name);
+		return indigo_queue_message(client_context->output_queue, key, policy, &message);
 	}
-	indigo_write(handle, buffer, length);
+	bool result = indigo_write(client_context->output, message.data, message.length);
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", client_context->output, buffer));
+	free(message.data);
+	return result;
 }
 
-static const char *escape(const char *s) {
+static const char *escape(const char *s, char *tmp) {
 	char *q = strchr(s, '"');
 	if (q == NULL)
 		return s;
-	static char tmp[INDIGO_VALUE_SIZE * 2];
 	char *t = tmp;
 	while (q) {
 		long l = q - s;
@@ -89,24 +99,24 @@ static indigo_result json_define_property(indigo_client *client, indigo_device *
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&json_mutex);
 	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
 	char output_buffer[JSON_BUFFER_SIZE];
+	char escaped[INDIGO_VALUE_SIZE * 2];
 	char *pnt = output_buffer;
 	int size;
 	char b1[32], b2[32], b3[32], b4[32], b5[32];
 	switch (property->type) {
 		case INDIGO_TEXT_VECTOR:
-			size = sprintf(pnt, "{ \"defTextVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state]);
+			size = sprintf(pnt, "{ \"defTextVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label, escaped), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state]);
 			pnt += size;
 			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
+				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints, escaped));
 				pnt += size;
 			}
 			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
+				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message, escaped));
 				pnt += size;
 			} else {
 				size = sprintf(pnt, ", \"items\": [ ");
@@ -114,21 +124,21 @@ static indigo_result json_define_property(indigo_client *client, indigo_device *
 			}
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, escape(item->label), item->text.value);
+				size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, escape(item->label, escaped), item->text.value);
 				pnt += size;
 			}
 			size = sprintf(pnt, " ] } }");
 			size += pnt - output_buffer;
 			break;
 		case INDIGO_NUMBER_VECTOR:
-			size = sprintf(pnt, "{ \"defNumberVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state]);
+			size = sprintf(pnt, "{ \"defNumberVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label, escaped), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state]);
 			pnt += size;
 			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
+				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints, escaped));
 				pnt += size;
 			}
 			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
+				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message, escaped));
 				pnt += size;
 			} else {
 				size = sprintf(pnt, ", \"items\": [ ");
@@ -137,23 +147,23 @@ static indigo_result json_define_property(indigo_client *client, indigo_device *
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
 				if (property->perm != INDIGO_RO_PERM)
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"min\": %s, \"max\": %s, \"step\": %s, \"format\": \"%s\", \"target\": %s, \"value\": %s }",  i > 0 ? "," : "", item->name, escape(item->label), indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), item->number.format, indigo_dtoa(item->number.target, b4), indigo_dtoa(item->number.value, b5));
+					size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"min\": %s, \"max\": %s, \"step\": %s, \"format\": \"%s\", \"target\": %s, \"value\": %s }",  i > 0 ? "," : "", item->name, escape(item->label, escaped), indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), item->number.format, indigo_dtoa(item->number.target, b4), indigo_dtoa(item->number.value, b5));
 				else
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"min\": %s, \"max\": %s, \"step\": %s, \"format\": \"%s\", \"value\": %s }",  i > 0 ? "," : "", item->name, escape(item->label), indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), item->number.format, indigo_dtoa(item->number.value, b4));
+					size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"min\": %s, \"max\": %s, \"step\": %s, \"format\": \"%s\", \"value\": %s }",  i > 0 ? "," : "", item->name, escape(item->label, escaped), indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), item->number.format, indigo_dtoa(item->number.value, b4));
 				pnt += size;
 			}
 			size = sprintf(pnt, " ] } }");
 			size += pnt - output_buffer;
 			break;
 		case INDIGO_SWITCH_VECTOR:
-			size = sprintf(pnt, "{ \"defSwitchVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\", \"rule\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], indigo_switch_rule_text[property->rule]);
+			size = sprintf(pnt, "{ \"defSwitchVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\", \"rule\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label, escaped), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], indigo_switch_rule_text[property->rule]);
 			pnt += size;
 			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
+				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints, escaped));
 				pnt += size;
 			}
 			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
+				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message, escaped));
 				pnt += size;
 			} else {
 				size = sprintf(pnt, ", \"items\": [ ");
@@ -161,21 +171,21 @@ static indigo_result json_define_property(indigo_client *client, indigo_device *
 			}
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"value\": %s }",  i > 0 ? "," : "", item->name, escape(item->label), item->sw.value ? "true" : "false");
+				size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"value\": %s }",  i > 0 ? "," : "", item->name, escape(item->label, escaped), item->sw.value ? "true" : "false");
 				pnt += size;
 			}
 			size = sprintf(pnt, " ] } }");
 			size += pnt - output_buffer;
 			break;
 		case INDIGO_LIGHT_VECTOR:
-			size = sprintf(pnt, "{ \"defLightVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_state_text[property->state]);
+			size = sprintf(pnt, "{ \"defLightVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label, escaped), indigo_property_state_text[property->state]);
 			pnt += size;
 			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
+				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints, escaped));
 				pnt += size;
 			}
 			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
+				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message, escaped));
 				pnt += size;
 			} else {
 				size = sprintf(pnt, ", \"items\": [ ");
@@ -183,21 +193,21 @@ static indigo_result json_define_property(indigo_client *client, indigo_device *
 			}
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, escape(item->label), indigo_property_state_text[item->light.value]);
+				size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, escape(item->label, escaped), indigo_property_state_text[item->light.value]);
 				pnt += size;
 			}
 			size = sprintf(pnt, " ] } }");
 			size += pnt - output_buffer;
 			break;
 		case INDIGO_BLOB_VECTOR:
-			size = sprintf(pnt, "{ \"defBLOBVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_state_text[property->state]);
+			size = sprintf(pnt, "{ \"defBLOBVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label, escaped), indigo_property_state_text[property->state]);
 			pnt += size;
 			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
+				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints, escaped));
 				pnt += size;
 			}
 			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
+				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message, escaped));
 				pnt += size;
 			} else {
 				size = sprintf(pnt, ", \"items\": [ ");
@@ -207,21 +217,17 @@ static indigo_result json_define_property(indigo_client *client, indigo_device *
 				indigo_item *item = &property->items[i];
 
 				if (property->state == INDIGO_OK_STATE && item->blob.value)
-					size = sprintf(pnt, "%s { \"name\": \"%s\",  \"label\": \"%s\", \"value\": \"/blob/%p%s\" }", i > 0 ? "," : "", item->name, escape(item->label), item, item->blob.format);
+					size = sprintf(pnt, "%s { \"name\": \"%s\",  \"label\": \"%s\", \"value\": \"/blob/%p%s\" }", i > 0 ? "," : "", item->name, escape(item->label, escaped), item, item->blob.format);
 				else
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\" }", i > 0 ? "," : "", item->name, escape(item->label));
+					size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\" }", i > 0 ? "," : "", item->name, escape(item->label, escaped));
 				pnt += size;
 			}
 			size = sprintf(pnt, " ] } }");
 			size += pnt - output_buffer;
 			break;
 	}
-	if (client_context->web_socket)
-		ws_write(handle, output_buffer, size);
-	else
-		indigo_write(handle, output_buffer, size);
-	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
-	pthread_mutex_unlock(&json_mutex);
+	queue_message(client_context, property, INDIGO_QUEUE_KEEP, output_buffer, size);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -233,10 +239,9 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&json_mutex);
 	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
 	char output_buffer[JSON_BUFFER_SIZE];
 	char *pnt = output_buffer;
 	int size;
@@ -339,12 +344,19 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 			size += pnt - output_buffer;
 			break;
 	}
-	if (client_context->web_socket)
-		ws_write(handle, output_buffer, size);
-	else
-		indigo_write(handle, output_buffer, size);
-	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
-	pthread_mutex_unlock(&json_mutex);
+	indigo_queue_policy policy = INDIGO_QUEUE_KEEP;
+	if (property->type == INDIGO_BLOB_VECTOR && property->state == INDIGO_OK_STATE)
+		policy = INDIGO_QUEUE_BLOB;
+	else if (property->type == INDIGO_BLOB_VECTOR)
+		policy = INDIGO_QUEUE_KEEP;
+	else if (message == NULL && property->type != INDIGO_TEXT_VECTOR)
+		policy = INDIGO_QUEUE_COALESCE;
+	if (!queue_message(client_context, property, policy, output_buffer, size) && policy == INDIGO_QUEUE_BLOB) {
+		// client didn't read previous data yet, BLOB is dropped but the client must know it
+		size = sprintf(output_buffer, "{ \"setBLOBVector\": { \"device\": \"%s\", \"name\": \"%s\", \"state\": \"Alert\", \"message\": \"BLOB dropped, client is not reading fast enough\", \"items\": [ ] } }", property->device, property->name);
+		queue_message(client_context, property, INDIGO_QUEUE_KEEP, output_buffer, size);
+	}
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -356,10 +368,9 @@ static indigo_result json_delete_property(indigo_client *client, indigo_device *
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&json_mutex);
 	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
 	char output_buffer[JSON_BUFFER_SIZE];
 	char *pnt = output_buffer;
 	int size;
@@ -374,12 +385,8 @@ static indigo_result json_delete_property(indigo_client *client, indigo_device *
 		size = sprintf(pnt, " } }");
 	}
 	size += pnt - output_buffer;
-	if (client_context->web_socket)
-		ws_write(handle, output_buffer, size);
-	else
-		indigo_write(handle, output_buffer, size);
-	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
-	pthread_mutex_unlock(&json_mutex);
+	queue_message(client_context, property, INDIGO_QUEUE_KEEP, output_buffer, size);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -388,25 +395,22 @@ static indigo_result json_message_property(indigo_client *client, indigo_device
 	assert(client != NULL);
 	if (!indigo_reshare_remote_devices && device->is_remote)
 		return INDIGO_OK;
-	pthread_mutex_lock(&json_mutex);
 	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
 	char output_buffer[JSON_BUFFER_SIZE];
 	char *pnt = output_buffer;
 	int size = sprintf(pnt, "{ \"message\": \"%s\" }", message);
-	if (client_context->web_socket)
-		ws_write(handle, output_buffer, size);
-	else
-		indigo_write(handle, output_buffer, size);
-	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
-	pthread_mutex_unlock(&json_mutex);
+	queue_message(client_context, NULL, INDIGO_QUEUE_KEEP, output_buffer, size);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
 static indigo_result json_detach(indigo_client *client) {
 	assert(client != NULL);
 	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	indigo_release_output_queue(client_context->output_queue);
+	client_context->output_queue = NULL;
 	close(client_context->input);
 	close(client_context->output);
 	return INDIGO_OK;
@@ -428,9 +432,12 @@ indigo_client *indigo_json_device_adapter(int input, int ouput, bool web_socket)
 	memcpy(client, &client_template, sizeof(indigo_client));
 	indigo_adapter_context *client_context = malloc(sizeof(indigo_adapter_context));
 	assert(client_context != NULL);
+	memset(client_context, 0, sizeof(indigo_adapter_context));
 	client_context->input = input;
 	client_context->output = ouput;
 	client_context->web_socket = web_socket;
+	client_context->output_queue = indigo_create_output_queue(ouput);
+	pthread_mutex_init(&client_context->mutex, NULL);
 	client->client_context = client_context;
 	client->is_remote = input == ouput;
 	indigo_enable_blob_mode_record *record = (indigo_enable_blob_mode_record *)malloc(sizeof(indigo_enable_blob_mode_record));
@@ -449,6 +456,9 @@ void indigo_release_json_device_adapter(indigo_client *client) {
 		record = record->next;
 		free(tmp);
 	}
-	free(client->client_context);
+	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	indigo_release_output_queue(client_context->output_queue);
+	pthread_mutex_destroy(&client_context->mutex);
+	free(client_context);
 	free(client);
 }
@@ -51,23 +51,28 @@
 #include <indigo/indigo_version.h>
 #include <indigo/indigo_driver_xml.h>
 
-#define RAW_BUF_SIZE 98304
-#define BASE64_BUF_SIZE 131072  /* BASE64_BUF_SIZE >= (RAW_BUF_SIZE + 2) / 3 * 4 */
-
-static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool queue_message(indigo_adapter_context *client_context, indigo_property *property, indigo_queue_policy policy, indigo_message *message) {
+	if (message->length == 0)
+		return true;
+	if (client_context->output_queue) {
+		char key[2 * INDIGO_NAME_SIZE] = "";
+		if (property != NULL)
+			snprintf(key, sizeof(key), "%s.%s", property->device, property->name);
+		return indigo_queue_message(client_context->output_queue, key, policy, message);
+	}
+	return indigo_write_message(client_context->output, message);
+}
 
-static const char *message_attribute(const char *message) {
+static const char *message_attribute(const char *message, char *buffer) {
 	if (message) {
-		static char buffer[INDIGO_VALUE_SIZE];
 		snprintf(buffer, INDIGO_VALUE_SIZE, " message='%s'", indigo_xml_escape((char *)message));
 		return buffer;
 	}
 	return "";
 }
 
-static const char *hints_attribute(const char *hints) {
+static const char *hints_attribute(const char *hints, char *buffer) {
 	if (*hints) {
-		static char buffer[INDIGO_VALUE_SIZE];
 		snprintf(buffer, INDIGO_VALUE_SIZE, " hints='%s'", indigo_xml_escape((char *)hints));
 		return buffer;
 	}
@@ -82,63 +87,63 @@ static indigo_result xml_device_adapter_define_property(indigo_client *client, i
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&write_mutex);
 	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
+	indigo_message xml_message = { 0 };
+	char message_buffer[INDIGO_VALUE_SIZE], hints_buffer[INDIGO_VALUE_SIZE];
 	char b1[32], b2[32], b3[32], b4[32], b5[32];
 	switch (property->type) {
 	case INDIGO_TEXT_VECTOR:
-		indigo_printf(handle, "<defTextVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints), message_attribute(message));
+		indigo_message_printf(&xml_message, "<defTextVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints, hints_buffer), message_attribute(message, message_buffer));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, "<defText name='%s' label='%s'%s>%s</defText>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints), item->text.value);
+			indigo_message_printf(&xml_message, "<defText name='%s' label='%s'%s>%s</defText>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints, hints_buffer), item->text.value);
 		}
-		indigo_printf(handle, "</defTextVector>\n");
+		indigo_message_printf(&xml_message, "</defTextVector>\n");
 		break;
 	case INDIGO_NUMBER_VECTOR:
-		indigo_printf(handle, "<defNumberVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints), message_attribute(message));
+		indigo_message_printf(&xml_message, "<defNumberVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints, hints_buffer), message_attribute(message, message_buffer));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
 			if (client->version >= INDIGO_VERSION_2_0 && property->perm != INDIGO_RO_PERM)
-				indigo_printf(handle, "<defNumber name='%s' label='%s' format='%s' min='%s' max='%s' step='%s' target='%s'>%s</defNumber>\n", indigo_item_name(client->version, property, item), item->label, item->number.format, indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), indigo_dtoa(item->number.target, b4), indigo_dtoa(item->number.value, b5));
+				indigo_message_printf(&xml_message, "<defNumber name='%s' label='%s' format='%s' min='%s' max='%s' step='%s' target='%s'>%s</defNumber>\n", indigo_item_name(client->version, property, item), item->label, item->number.format, indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), indigo_dtoa(item->number.target, b4), indigo_dtoa(item->number.value, b5));
 			else
-				indigo_printf(handle, "<defNumber name='%s' label='%s'%s format='%s' min='%s' max='%s' step='%s'>%s</defNumber>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints), item->number.format, indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), indigo_dtoa(item->number.value, b4));
+				indigo_message_printf(&xml_message, "<defNumber name='%s' label='%s'%s format='%s' min='%s' max='%s' step='%s'>%s</defNumber>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints, hints_buffer), item->number.format, indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), indigo_dtoa(item->number.value, b4));
 		}
-		indigo_printf(handle, "</defNumberVector>\n");
+		indigo_message_printf(&xml_message, "</defNumberVector>\n");
 		break;
 	case INDIGO_SWITCH_VECTOR:
-		indigo_printf(handle, "<defSwitchVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s' rule='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], indigo_switch_rule_text[property->rule], hints_attribute(property->hints), message_attribute(message));
+		indigo_message_printf(&xml_message, "<defSwitchVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s' rule='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], indigo_switch_rule_text[property->rule], hints_attribute(property->hints, hints_buffer), message_attribute(message, message_buffer));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, "<defSwitch name='%s' label='%s'%s>%s</defSwitch>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints), item->sw.value ? "On" : "Off");
+			indigo_message_printf(&xml_message, "<defSwitch name='%s' label='%s'%s>%s</defSwitch>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints, hints_buffer), item->sw.value ? "On" : "Off");
 		}
-		indigo_printf(handle, "</defSwitchVector>\n");
+		indigo_message_printf(&xml_message, "</defSwitchVector>\n");
 		break;
 	case INDIGO_LIGHT_VECTOR:
-		indigo_printf(handle, "<defLightVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints), message_attribute(message));
+		indigo_message_printf(&xml_message, "<defLightVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints, hints_buffer), message_attribute(message, message_buffer));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, " <defLight name='%s' label='%s'%s>%s</defLight>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints), indigo_property_state_text[item->light.value]);
+			indigo_message_printf(&xml_message, " <defLight name='%s' label='%s'%s>%s</defLight>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints, hints_buffer), indigo_property_state_text[item->light.value]);
 		}
-		indigo_printf(handle, "</defLightVector>\n");
+		indigo_message_printf(&xml_message, "</defLightVector>\n");
 		break;
 	case INDIGO_BLOB_VECTOR:
-		indigo_printf(handle, "<defBLOBVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints), message_attribute(message));
+		indigo_message_printf(&xml_message, "<defBLOBVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints, hints_buffer), message_attribute(message, message_buffer));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, "<defBLOB name='%s' label='%s'%s/>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints));
+			indigo_message_printf(&xml_message, "<defBLOB name='%s' label='%s'%s/>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints, hints_buffer));
 		}
-		indigo_printf(handle, "</defBLOBVector>\n");
+		indigo_message_printf(&xml_message, "</defBLOBVector>\n");
 		break;
 	}
-	pthread_mutex_unlock(&write_mutex);
+	queue_message(client_context, property, INDIGO_QUEUE_KEEP, &xml_message);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
 static indigo_result xml_device_adapter_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
-	FILE* fh;
-	int handle2;
 	assert(device != NULL);
 	assert(client != NULL);
 	assert(property != NULL);
@@ -146,46 +151,47 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&write_mutex);
 	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
+	indigo_message xml_message = { 0 };
+	char message_buffer[INDIGO_VALUE_SIZE];
 	char b1[32], b2[32];
 	switch (property->type) {
 		case INDIGO_TEXT_VECTOR:
-			indigo_printf(handle, "<setTextVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+			indigo_message_printf(&xml_message, "<setTextVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message, message_buffer));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				indigo_printf(handle, "<oneText name='%s'>%s</oneText>\n", indigo_item_name(client->version, property, item), indigo_xml_escape(item->text.value));
+				indigo_message_printf(&xml_message, "<oneText name='%s'>%s</oneText>\n", indigo_item_name(client->version, property, item), indigo_xml_escape(item->text.value));
 			}
-			indigo_printf(handle, "</setTextVector>\n");
+			indigo_message_printf(&xml_message, "</setTextVector>\n");
 			break;
 		case INDIGO_NUMBER_VECTOR:
-			indigo_printf(handle, "<setNumberVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+			indigo_message_printf(&xml_message, "<setNumberVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message, message_buffer));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
 				if (client->version >= INDIGO_VERSION_2_0 && property->perm != INDIGO_RO_PERM)
-					indigo_printf(handle, "<oneNumber name='%s' target='%s'>%s</oneNumber>\n", indigo_item_name(client->version, property, item), indigo_dtoa(item->number.target, b1), indigo_dtoa(item->number.value, b2));
+					indigo_message_printf(&xml_message, "<oneNumber name='%s' target='%s'>%s</oneNumber>\n", indigo_item_name(client->version, property, item), indigo_dtoa(item->number.target, b1), indigo_dtoa(item->number.value, b2));
 				else
-					indigo_printf(handle, "<oneNumber name='%s'>%s</oneNumber>\n", indigo_item_name(client->version, property, item), indigo_dtoa(item->number.value, b1));
+					indigo_message_printf(&xml_message, "<oneNumber name='%s'>%s</oneNumber>\n", indigo_item_name(client->version, property, item), indigo_dtoa(item->number.value, b1));
 			}
-			indigo_printf(handle, "</setNumberVector>\n");
+			indigo_message_printf(&xml_message, "</setNumberVector>\n");
 			break;
 		case INDIGO_SWITCH_VECTOR:
-			indigo_printf(handle, "<setSwitchVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+			indigo_message_printf(&xml_message, "<setSwitchVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message, message_buffer));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				indigo_printf(handle, "<oneSwitch name='%s'>%s</oneSwitch>\n", indigo_item_name(client->version, property, item), item->sw.value ? "On" : "Off");
+				indigo_message_printf(&xml_message, "<oneSwitch name='%s'>%s</oneSwitch>\n", indigo_item_name(client->version, property, item), item->sw.value ? "On" : "Off");
 			}
-			indigo_printf(handle, "</setSwitchVector>\n");
+			indigo_message_printf(&xml_message, "</setSwitchVector>\n");
 			break;
 		case INDIGO_LIGHT_VECTOR:
-			indigo_printf(handle, "<setLightVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+			indigo_message_printf(&xml_message, "<setLightVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message, message_buffer));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				indigo_printf(handle, "<oneLight name='%s'>%s</oneLight>\n", indigo_item_name(client->version, property, item), indigo_property_state_text[item->light.value]);
+				indigo_message_printf(&xml_message, "<oneLight name='%s'>%s</oneLight>\n", indigo_item_name(client->version, property, item), indigo_property_state_text[item->light.value]);
 			}
-			indigo_printf(handle, "</setLightVector>\n");
+			indigo_message_printf(&xml_message, "</setLightVector>\n");
 			break;
 		case INDIGO_BLOB_VECTOR: {
 			indigo_enable_blob_mode mode = INDIGO_ENABLE_BLOB_NEVER;
@@ -198,54 +204,46 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 				record = record->next;
 			}
 			if (mode != INDIGO_ENABLE_BLOB_NEVER) {
-				indigo_printf(handle, "<setBLOBVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+				indigo_message_printf(&xml_message, "<setBLOBVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message, message_buffer));
 				if (property->state == INDIGO_OK_STATE) {
 					for (int i = 0; i < property->count; i++) {
 						indigo_item *item = &property->items[i];
-						long input_length = item->blob.size;
-						unsigned char *data = item->blob.value;
 						if (mode == INDIGO_ENABLE_BLOB_URL && client->version >= INDIGO_VERSION_2_0) {
 							if (*item->blob.url == 0)
-								indigo_printf(handle, "<oneBLOB name='%s' path='/blob/%p%s'/>\n", indigo_item_name(client->version, property, item), item, item->blob.format);
+								indigo_message_printf(&xml_message, "<oneBLOB name='%s' path='/blob/%p%s'/>\n", indigo_item_name(client->version, property, item), item, item->blob.format);
 							else
-								indigo_printf(handle, "<oneBLOB name='%s' url='%s'/>\n", indigo_item_name(client->version, property, item), item->blob.url);
+								indigo_message_printf(&xml_message, "<oneBLOB name='%s' url='%s'/>\n", indigo_item_name(client->version, property, item), item->blob.url);
+						} else if (mode == INDIGO_ENABLE_BLOB_BINARY && client->version >= INDIGO_VERSION_2_0) {
+							// raw payload of exactly 'size' bytes follows '>' immediately
+							indigo_message_printf(&xml_message, "<oneBLOB name='%s' format='%s' size='%ld' encoding='binary'>", indigo_item_name(client->version, property, item), item->blob.format, item->blob.size);
+							indigo_message_append_blob(&xml_message, item->blob.buffer, item->blob.value, item->blob.size, false);
+							indigo_message_printf(&xml_message, "</oneBLOB>\n");
 						} else {
-							indigo_printf(handle, "<oneBLOB name='%s' format='%s' size='%ld'>\n", indigo_item_name(client->version, property, item), item->blob.format, item->blob.size);
-							handle2 = dup(handle);
-							fh = fdopen(handle2, "w");
-							if (client->version >= INDIGO_VERSION_2_0) {
-								while (input_length) {
-									char encoded_data[BASE64_BUF_SIZE + 1];
-									long len = (RAW_BUF_SIZE < input_length) ?  RAW_BUF_SIZE : input_length;
-									long enclen = base64_encode((unsigned char*)encoded_data, (unsigned char*)data, len);
-									fwrite(encoded_data, 1, enclen, fh);
-									input_length -= len;
-									data += len;
-								}
-							} else {
-								static char encoded_data[74];
-								while (input_length) {
-									/* 54 raw = 72 encoded */
-									long len = (54 < input_length) ?  54 : input_length;
-									long enclen = base64_encode((unsigned char*)encoded_data, (unsigned char*)data, len);
-									encoded_data[enclen] = '\n';
-									fwrite(encoded_data, 1, enclen, fh);
-									input_length -= len;
-									data += len;
-								}
-							}
-							fflush(fh);
-							fclose(fh);
-							indigo_printf(handle, "</oneBLOB>\n");
+							indigo_message_printf(&xml_message, "<oneBLOB name='%s' format='%s' size='%ld'>\n", indigo_item_name(client->version, property, item), item->blob.format, item->blob.size);
+							// shared buffer is encoded by writer thread while sent, so the encoded copy is never held in memory per client
+							indigo_message_append_blob(&xml_message, item->blob.buffer, item->blob.value, item->blob.size, true);
+							indigo_message_printf(&xml_message, "</oneBLOB>\n");
 						}
 					}
 				}
-				indigo_printf(handle, "</setBLOBVector>\n");
+				indigo_message_printf(&xml_message, "</setBLOBVector>\n");
 			}
 			break;
 		}
 	}
-	pthread_mutex_unlock(&write_mutex);
+	indigo_queue_policy policy = INDIGO_QUEUE_KEEP;
+	if (property->type == INDIGO_BLOB_VECTOR && property->state == INDIGO_OK_STATE)
+		policy = INDIGO_QUEUE_BLOB;
+	else if (property->type == INDIGO_BLOB_VECTOR)
+		policy = INDIGO_QUEUE_KEEP;
+	else if (message == NULL && property->type != INDIGO_TEXT_VECTOR)
+		policy = INDIGO_QUEUE_COALESCE;
+	if (!queue_message(client_context, property, policy, &xml_message) && policy == INDIGO_QUEUE_BLOB) {
+		// client didn't read previous data yet, BLOB is dropped but the client must know it
+		indigo_message_printf(&xml_message, "<setBLOBVector device='%s' name='%s' state='Alert' message='BLOB dropped, client is not reading fast enough'>\n</setBLOBVector>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property));
+		queue_message(client_context, property, INDIGO_QUEUE_KEEP, &xml_message);
+	}
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -257,15 +255,17 @@ static indigo_result xml_device_adapter_delete_property(indigo_client *client, i
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&write_mutex);
 	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
+	indigo_message xml_message = { 0 };
+	char message_buffer[INDIGO_VALUE_SIZE];
 	if (*property->name)
-		indigo_printf(handle, "<delProperty device='%s' name='%s'%s/>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), message_attribute(message));
+		indigo_message_printf(&xml_message, "<delProperty device='%s' name='%s'%s/>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), message_attribute(message, message_buffer));
 	else
-		indigo_printf(handle, "<delProperty device='%s'%s/>\n", device->name, message_attribute(message));
-	pthread_mutex_unlock(&write_mutex);
+		indigo_message_printf(&xml_message, "<delProperty device='%s'%s/>\n", device->name, message_attribute(message, message_buffer));
+	queue_message(client_context, property, INDIGO_QUEUE_KEEP, &xml_message);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -276,13 +276,15 @@ static indigo_result xml_device_adapter_send_message(indigo_client *client, indi
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&write_mutex);
 	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
+	indigo_message xml_message = { 0 };
+	char message_buffer[INDIGO_VALUE_SIZE];
 	if (message)
-		indigo_printf(handle, "<message%s/>\n", message_attribute(message));
-	pthread_mutex_unlock(&write_mutex);
+		indigo_message_printf(&xml_message, "<message%s/>\n", message_attribute(message, message_buffer));
+	queue_message(client_context, NULL, INDIGO_QUEUE_KEEP, &xml_message);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -301,8 +303,11 @@ indigo_client *indigo_xml_device_adapter(int input, int ouput) {
 	memcpy(client, &client_template, sizeof(indigo_client));
 	indigo_adapter_context *client_context = malloc(sizeof(indigo_adapter_context));
 	assert(client_context != NULL);
+	memset(client_context, 0, sizeof(indigo_adapter_context));
 	client_context->input = input;
 	client_context->output = ouput;
+	client_context->output_queue = indigo_create_output_queue(ouput);
+	pthread_mutex_init(&client_context->mutex, NULL);
 	client->client_context = client_context;
 	client->is_remote = input == ouput;
 	return client;
@@ -311,7 +316,10 @@ indigo_client *indigo_xml_device_adapter(int input, int ouput) {
 void indigo_release_xml_device_adapter(indigo_client *client) {
 	assert(client != NULL);
 	assert(client->client_context != NULL);
-	free(client->client_context);
+	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	indigo_release_output_queue(client_context->output_queue);
+	pthread_mutex_destroy(&client_context->mutex);
+	free(client_context);
 	free(client);
 }
 
@@ -465,6 +465,42 @@ indigo_result indigo_filter_define_property(indigo_client *client, indigo_device
 	return INDIGO_OK;
 }
 
+// Copy only what update messages carry, item names, labels and hints are set when the copy is defined.
+
+static void copy_item_values(indigo_property *copy, indigo_property *property) {
+	int count = copy->count < property->count ? copy->count : property->count;
+	for (int i = 0; i < count; i++) {
+		indigo_item *copy_item = copy->items + i;
+		indigo_item *item = property->items + i;
+		switch (property->type) {
+			case INDIGO_TEXT_VECTOR:
+				strcpy(copy_item->text.value, item->text.value);
+				break;
+			case INDIGO_NUMBER_VECTOR:
+				strcpy(copy_item->number.format, item->number.format);
+				copy_item->number.min = item->number.min;
+				copy_item->number.max = item->number.max;
+				copy_item->number.step = item->number.step;
+				copy_item->number.value = item->number.value;
+				copy_item->number.target = item->number.target;
+				break;
+			case INDIGO_SWITCH_VECTOR:
+				copy_item->sw.value = item->sw.value;
+				break;
+			case INDIGO_LIGHT_VECTOR:
+				copy_item->light.value = item->light.value;
+				break;
+			case INDIGO_BLOB_VECTOR:
+				strcpy(copy_item->blob.format, item->blob.format);
+				strcpy(copy_item->blob.url, item->blob.url);
+				copy_item->blob.size = item->blob.size;
+				copy_item->blob.value = item->blob.value;
+				copy_item->blob.buffer = item->blob.buffer;
+				break;
+		}
+	}
+}
+
 indigo_result indigo_filter_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
 	if (device == FILTER_CLIENT_CONTEXT->device)
 		return INDIGO_OK;
@@ -508,7 +544,7 @@ indigo_result indigo_filter_update_property(indigo_client *client, indigo_device
 			for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
 				if (device_cache[i] == property) {
 					if (agent_cache[i]) {
-						memcpy(agent_cache[i]->items, device_cache[i]->items, device_cache[i]->count * sizeof(indigo_item));
+						copy_item_values(agent_cache[i], device_cache[i]);
 						agent_cache[i]->state = device_cache[i]->state;
 						indigo_update_property(device, agent_cache[i], NULL);
 					}
@@ -12,6 +12,8 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_ccd_driver.h>
@@ -21,76 +23,97 @@
 #define IM (1)
 #define PI_2 (6.2831853071795864769252867665590057683943L)
 
-static void _fft(const int n, const int offset, const int delta, const double (*x)[2], double (*X)[2], double (*_X)[2]);
-
-static void fft(const int n, const double (*x)[2], double (*X)[2]) {
-	double (*_X)[2] = malloc(2 * n * sizeof(double));
-	_fft(n, 0, 1, x, X, _X);
-	free(_X);
-}
-
-static void _fft(const int n, const int offset, const int delta, const double (*x)[2], double (*X)[2], double (*_X)[2]) {
-	int n2 = n / 2;
-	int k;
-	double ccos, csin;
-	int k00, k01, k10, k11;
-	double tmp0, tmp1;
-	if (n != 2) {
-		_fft(n2, offset, 2 * delta, x, _X, X);
-		_fft(n2, offset + delta, 2 * delta, x, _X, X);
-		for (k = 0; k < n2; k++) {
-			k00 = offset + k * delta;
-			k01 = k00 + n2 * delta;
-			k10 = offset + 2 * k * delta;
-			k11 = k10 + delta;
-			ccos = cos(PI_2 * k / (double)n);
-			csin = sin(PI_2 * k / (double)n);
-			tmp0 = ccos * _X[k11][RE] + csin * _X[k11][IM];
-			tmp1 = ccos * _X[k11][IM] - csin * _X[k11][RE];
-			X[k01][RE] = _X[k10][RE] - tmp0;
-			X[k01][IM] = _X[k10][IM] - tmp1;
-			X[k00][RE] = _X[k10][RE] + tmp0;
-			X[k00][IM] = _X[k10][IM] + tmp1;
+// FFT plans are created once per (power of 2) size and cached for the life of the process, plan contains bit reversal
+// permutation, twiddle factors and scratch buffer for correlation (guarded by plan mutex), so no allocation is needed per call
+
+typedef struct {
+	int n;
+	int *reverse;
+	double (*twiddle)[2];
+	double (*scratch)[2];
+	pthread_mutex_t mutex;
+} fft_plan;
+
+static fft_plan *fft_plans[32];
+static pthread_mutex_t fft_plans_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static fft_plan *get_fft_plan(const int n) {
+	int bits = 0;
+	while ((1 << bits) < n)
+		bits++;
+	pthread_mutex_lock(&fft_plans_mutex);
+	fft_plan *plan = fft_plans[bits];
+	if (plan == NULL) {
+		plan = malloc(sizeof(fft_plan));
+		plan->n = n;
+		plan->reverse = malloc(n * sizeof(int));
+		for (int i = 0; i < n; i++) {
+			int r = 0;
+			for (int b = 0; b < bits; b++)
+				r |= ((i >> b) & 1) << (bits - 1 - b);
+			plan->reverse[i] = r;
 		}
-	} else {
-		k00 = offset;
-		k01 = k00 + delta;
-		X[k01][RE] = x[k00][RE] - x[k01][RE];
-		X[k01][IM] = x[k00][IM] - x[k01][IM];
-		X[k00][RE] = x[k00][RE] + x[k01][RE];
-		X[k00][IM] = x[k00][IM] + x[k01][IM];
+		plan->twiddle = malloc(n / 2 * 2 * sizeof(double));
+		for (int k = 0; k < n / 2; k++) {
+			plan->twiddle[k][RE] = cos(PI_2 * k / (double)n);
+			plan->twiddle[k][IM] = -sin(PI_2 * k / (double)n);
+		}
+		plan->scratch = malloc(2 * n * sizeof(double));
+		pthread_mutex_init(&plan->mutex, NULL);
+		fft_plans[bits] = plan;
 	}
+	pthread_mutex_unlock(&fft_plans_mutex);
+	return plan;
 }
 
-static void ifft(const int n, const double (*X)[2], double (*x)[2]) {
-	int n2 = n / 2;
-	int i;
-	double tmp0, tmp1;
-	fft(n, X, x);
-	x[0][RE] = x[0][RE] / n;
-	x[0][IM] = x[0][IM] / n;
-	x[n2][RE] = x[n2][RE] / n;
-	x[n2][IM] = x[n2][IM] / n;
-	for (i = 1; i < n2; i++) {
-		tmp0 = x[i][RE] / n;
-		tmp1 = x[i][IM] / n;
-		x[i][RE] = x[n-i][RE] / n;
-		x[i][IM] = x[n-i][IM] / n;
-		x[n-i][RE] = tmp0;
-		x[n-i][IM] = tmp1;
-	}
-}
-
-static void corellate_fft(const int n, const double (*X1)[2], const double (*X2)[2], double (*c)[2]) {
-	int i;
-	double (*C)[2] = malloc(2 * n * sizeof(double));
-	/* pointwise multiply X1 conjugate with X2 here, store in X1 */
-	for (i = 0; i < n; i++) {
-		C[i][RE] = X1[i][RE] * X2[i][RE] + X1[i][IM] * X2[i][IM];
-		C[i][IM] = X1[i][IM] * X2[i][RE] - X1[i][RE] * X2[i][IM];
+// in place iterative radix-2 transform, inverse one uses conjugate twiddle factors and is scaled by 1/n
+
+static void fft(const fft_plan *plan, double (*x)[2], const bool inverse) {
+	const int n = plan->n;
+	const double sign = inverse ? -1 : 1;
+	for (int i = 0; i < n; i++) {
+		int j = plan->reverse[i];
+		if (i < j) {
+			double tmp0 = x[i][RE], tmp1 = x[i][IM];
+			x[i][RE] = x[j][RE];
+			x[i][IM] = x[j][IM];
+			x[j][RE] = tmp0;
+			x[j][IM] = tmp1;
+		}
+	}
+	for (int size = 2; size <= n; size <<= 1) {
+		const int n2 = size / 2, step = n / size;
+		for (int start = 0; start < n; start += size) {
+			double (*a)[2] = x + start, (*b)[2] = x + start + n2;
+			for (int k = 0; k < n2; k++) {
+				double ccos = plan->twiddle[k * step][RE];
+				double csin = sign * plan->twiddle[k * step][IM];
+				double tmp0 = ccos * b[k][RE] - csin * b[k][IM];
+				double tmp1 = ccos * b[k][IM] + csin * b[k][RE];
+				b[k][RE] = a[k][RE] - tmp0;
+				b[k][IM] = a[k][IM] - tmp1;
+				a[k][RE] += tmp0;
+				a[k][IM] += tmp1;
+			}
+		}
+	}
+	if (inverse) {
+		for (int i = 0; i < n; i++) {
+			x[i][RE] /= n;
+			x[i][IM] /= n;
+		}
+	}
+}
+
+static void corellate_fft(const fft_plan *plan, const double (*X1)[2], const double (*X2)[2], double (*c)[2]) {
+	/* pointwise multiply X1 with X2 conjugate, store in c and transform back in place */
+	for (int i = 0; i < plan->n; i++) {
+		double re = X1[i][RE] * X2[i][RE] + X1[i][IM] * X2[i][IM];
+		double im = X1[i][IM] * X2[i][RE] - X1[i][RE] * X2[i][IM];
+		c[i][RE] = re;
+		c[i][IM] = im;
 	}
-	ifft(n, C, c);
-	free(C);
+	fft(plan, c, true);
 }
 
 static double find_distance(const int n, const double (*c)[2]) {
@@ -443,6 +466,34 @@ static double calibrate_re(double (*vector)[2], int size) {
 	return snr;
 }
 
+// Column and row projections are computed in one pass over the frame with integer accumulators, one function per raw type
+// (RGB pixels are sums of all three channels), inner loops are left to the compiler to vectorize
+
+#define DEFINE_PROJECTION(name, type, components)\
+INDIGO_IMAGE_KERNEL static void name(const type *data, const int width, const int height, double (*col_x)[2], double (*col_y)[2]) {\
+	uint64_t *sum_x = calloc(width, sizeof(uint64_t));\
+	for (int y = 0; y < height; y++) {\
+		const type *row = data + (long)y * width * components;\
+		uint64_t sum_y = 0;\
+		for (int x = 0; x < width; x++) {\
+			uint32_t value = row[x * components];\
+			if (components == 3)\
+				value += row[x * components + 1] + row[x * components + 2];\
+			sum_x[x] += value;\
+			sum_y += value;\
+		}\
+		col_y[y][RE] = sum_y;\
+	}\
+	for (int x = 0; x < width; x++)\
+		col_x[x][RE] = sum_x[x];\
+	free(sum_x);\
+}
+
+DEFINE_PROJECTION(projection_mono8, uint8_t, 1)
+DEFINE_PROJECTION(projection_mono16, uint16_t, 1)
+DEFINE_PROJECTION(projection_rgb24, uint8_t, 3)
+DEFINE_PROJECTION(projection_rgb48, uint16_t, 3)
+
 indigo_result indigo_donuts_frame_digest(indigo_raw_type raw_type, const void *data, const int width, const int height, indigo_frame_digest *c) {
 	if ((width < 3) || (height < 3))
 		return INDIGO_FAILED;
@@ -450,38 +501,22 @@ indigo_result indigo_donuts_frame_digest(indigo_raw_type raw_type, const void *d
 		return INDIGO_FAILED;
 	c->width = next_power_2(width);
 	c->height = next_power_2(height);
-	double (*col_x)[2] = calloc(2 * c->width * sizeof(double), 1);
-	double (*col_y)[2] = calloc(2 * c->height * sizeof(double), 1);
-	c->fft_x = malloc(2 * c->width * sizeof(double));
-	c->fft_y = malloc(2 * c->height * sizeof(double));
-	int ci = 0, li = 0, max = width * height;
-	for (int i = 0; i < max; i++) {
-		double value;
-		switch (raw_type) {
-			case INDIGO_RAW_MONO8: {
-				value = ((uint8_t *)data)[i];
-				break;
-			}
-			case INDIGO_RAW_MONO16: {
-				value = ((uint16_t *)data)[i];
-				break;
-			}
-			case INDIGO_RAW_RGB24: {
-				value = ((uint8_t *)data)[i] + ((uint8_t *)data)[i + 1] + ((uint8_t *)data)[i + 2];
-				break;
-			}
-			case INDIGO_RAW_RGB48: {
-				value = ((uint16_t *)data)[i] + ((uint16_t *)data)[i + 1] + ((uint16_t *)data)[i + 2];
-				break;
-			}
-		}
-		col_x[ci][RE] += value;
-		col_y[li][RE] += value;
-		ci++;
-		if (ci == width) {
-			ci = 0;
-			li++;
-		}
+	// projections are accumulated directly into digest buffers and transformed in place
+	double (*col_x)[2] = c->fft_x = calloc(2 * c->width * sizeof(double), 1);
+	double (*col_y)[2] = c->fft_y = calloc(2 * c->height * sizeof(double), 1);
+	switch (raw_type) {
+		case INDIGO_RAW_MONO8:
+			projection_mono8(data, width, height, col_x, col_y);
+			break;
+		case INDIGO_RAW_MONO16:
+			projection_mono16(data, width, height, col_x, col_y);
+			break;
+		case INDIGO_RAW_RGB24:
+			projection_rgb24(data, width, height, col_x, col_y);
+			break;
+		case INDIGO_RAW_RGB48:
+			projection_rgb48(data, width, height, col_x, col_y);
+			break;
 	}
 	c->snr = (calibrate_re(col_x, width) + calibrate_re(col_y, height)) / 2;
 //	printf("col_x:");
@@ -494,11 +529,373 @@ indigo_result indigo_donuts_frame_digest(indigo_raw_type raw_type, const void *d
 //		printf(" %5.2f",col_y[i][RE]);
 //	}
 //	printf("\n");
-	fft(c->width, col_x, c->fft_x);
-	fft(c->height, col_y, c->fft_y);
+	fft(get_fft_plan(c->width), c->fft_x, false);
+	fft(get_fft_plan(c->height), c->fft_y, false);
 	c->algorithm = donuts;
-	free(col_x);
-	free(col_y);
+	return INDIGO_OK;
+}
+
+// Multi-star digest: isolated stars are detected once in the reference frame, every next frame is then centroided in small
+// windows around all of them (ordered by row, so the frame is traversed top to bottom only once) and drift is computed as
+// SNR weighted mean of individual star shifts with outliers rejected
+
+#define MAX_SAMPLES				65536
+#define MAX_CANDIDATES		256
+#define MIN_STAR_SNR			5
+#define MIN_TRACKED_SNR		3
+
+typedef struct {
+	int x;
+	int y;
+	uint32_t value;
+} star_candidate;
+
+static int compare_double(const void *a, const void *b) {
+	double aa = *(const double *)a, bb = *(const double *)b;
+	return (aa > bb) - (aa < bb);
+}
+
+static int compare_candidates(const void *a, const void *b) {
+	uint32_t aa = ((const star_candidate *)a)->value, bb = ((const star_candidate *)b)->value;
+	return (aa < bb) - (aa > bb);
+}
+
+static int compare_stars(const void *a, const void *b) {
+	const indigo_guide_star *aa = a, *bb = b;
+	if (aa->y != bb->y)
+		return (aa->y > bb->y) - (aa->y < bb->y);
+	return (aa->x > bb->x) - (aa->x < bb->x);
+}
+
+// k-th smallest value (Wirth's selection), values are reordered
+
+static uint32_t select_uint32(uint32_t *values, const long count, const long k) {
+	long left = 0, right = count - 1;
+	while (left < right) {
+		uint32_t pivot = values[k];
+		long i = left, j = right;
+		do {
+			while (values[i] < pivot)
+				i++;
+			while (pivot < values[j])
+				j--;
+			if (i <= j) {
+				uint32_t tmp = values[i];
+				values[i++] = values[j];
+				values[j--] = tmp;
+			}
+		} while (i <= j);
+		if (j < k)
+			left = i;
+		if (k < i)
+			right = j;
+	}
+	return values[k];
+}
+
+// median and MAD based sigma, values are reordered
+
+static void median_sigma(uint32_t *values, const long count, double *median, double *sigma) {
+	uint32_t m = select_uint32(values, count, count / 2);
+	for (long i = 0; i < count; i++)
+		values[i] = values[i] > m ? values[i] - m : m - values[i];
+	*median = m;
+	*sigma = 1.4826 * select_uint32(values, count, count / 2);
+	if (*sigma < 1)
+		*sigma = 1;
+}
+
+static double median_double(const double *values, const int count) {
+	double sorted[count];
+	memcpy(sorted, values, count * sizeof(double));
+	qsort(sorted, count, sizeof(double), compare_double);
+	return count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+}
+
+// Typed kernels for star detection and centroiding, one set per raw type (RGB pixels are sums of all three channels):
+// sample - strided background sample of the frame
+// scan - local maxima above threshold with at least 3 neighbours above threshold (to reject hot pixels), brightest MAX_CANDIDATES are kept
+// peak - position of the brightest pixel in rectangle
+// moments - centroid in (2 * radius + 1)^2 window, background and noise are estimated from median and MAD of window border
+
+#define DEFINE_STAR_KERNELS(suffix, type, components)\
+static inline uint32_t pixel_##suffix(const type *data, const long i) {\
+	const type *pixel = data + i * components;\
+	return components == 3 ? (uint32_t)pixel[0] + pixel[1] + pixel[2] : pixel[0];\
+}\
+\
+static long sample_##suffix(const type *data, const long size, uint32_t *samples) {\
+	long step = size / MAX_SAMPLES + 1, count = 0;\
+	for (long i = 0; i < size; i += step)\
+		samples[count++] = pixel_##suffix(data, i);\
+	return count;\
+}\
+\
+static int scan_##suffix(const type *data, const int width, const int height, const int border, const uint32_t threshold, const uint32_t saturation, star_candidate *candidates) {\
+	int count = 0, smallest = 0;\
+	for (int y = border; y < height - border; y++) {\
+		const long row = (long)y * width;\
+		for (int x = border; x < width - border; x++) {\
+			uint32_t value = pixel_##suffix(data, row + x);\
+			if (value <= threshold || value >= saturation)\
+				continue;\
+			int above = 0;\
+			bool peak = true;\
+			for (int j = -1; j <= 1 && peak; j++) {\
+				for (int i = -1; i <= 1; i++) {\
+					if (i == 0 && j == 0)\
+						continue;\
+					uint32_t neighbour = pixel_##suffix(data, row + j * width + x + i);\
+					if (neighbour > value || (neighbour == value && (j < 0 || (j == 0 && i < 0)))) {\
+						peak = false;\
+						break;\
+					}\
+					if (neighbour > threshold)\
+						above++;\
+				}\
+			}\
+			if (!peak || above < 3)\
+				continue;\
+			if (count < MAX_CANDIDATES)\
+				candidates[count++] = (star_candidate){ x, y, value };\
+			else if (value > candidates[smallest].value)\
+				candidates[smallest] = (star_candidate){ x, y, value };\
+			else\
+				continue;\
+			if (count == MAX_CANDIDATES) {\
+				for (int k = 0; k < count; k++)\
+					if (candidates[k].value < candidates[smallest].value)\
+						smallest = k;\
+			}\
+		}\
+	}\
+	return count;\
+}\
+\
+static void peak_##suffix(const type *data, const int width, const int x0, const int y0, const int x1, const int y1, int *px, int *py) {\
+	uint32_t max = 0;\
+	*px = x0;\
+	*py = y0;\
+	for (int y = y0; y <= y1; y++) {\
+		const long row = (long)y * width;\
+		for (int x = x0; x <= x1; x++) {\
+			uint32_t value = pixel_##suffix(data, row + x);\
+			if (value > max) {\
+				max = value;\
+				*px = x;\
+				*py = y;\
+			}\
+		}\
+	}\
+}\
+\
+static bool moments_##suffix(const type *data, const int width, const int height, const int radius, indigo_guide_star *star) {\
+	int xx = (int)round(star->x), yy = (int)round(star->y);\
+	if (xx < radius || yy < radius || xx >= width - radius || yy >= height - radius)\
+		return false;\
+	uint32_t ring[8 * radius], max = 0;\
+	int n = 0;\
+	for (int i = -radius; i < radius; i++) {\
+		ring[n++] = pixel_##suffix(data, (long)(yy - radius) * width + xx + i);\
+		ring[n++] = pixel_##suffix(data, (long)(yy + radius) * width + xx - i);\
+		ring[n++] = pixel_##suffix(data, (long)(yy + i) * width + xx + radius);\
+		ring[n++] = pixel_##suffix(data, (long)(yy - i) * width + xx - radius);\
+	}\
+	double background, sigma;\
+	median_sigma(ring, n, &background, &sigma);\
+	double threshold = background + 2 * sigma, m00 = 0, m10 = 0, m01 = 0;\
+	for (int j = yy - radius + 1; j < yy + radius; j++) {\
+		const long row = (long)j * width;\
+		for (int i = xx - radius + 1; i < xx + radius; i++) {\
+			uint32_t value = pixel_##suffix(data, row + i);\
+			if (value > max)\
+				max = value;\
+			if (value > threshold) {\
+				double weight = value - background;\
+				m00 += weight;\
+				m10 += i * weight;\
+				m01 += j * weight;\
+			}\
+		}\
+	}\
+	if (m00 == 0)\
+		return false;\
+	star->x = m10 / m00;\
+	star->y = m01 / m00;\
+	star->flux = m00;\
+	star->snr = (max - background) / sigma;\
+	return true;\
+}
+
+DEFINE_STAR_KERNELS(mono8, uint8_t, 1)
+DEFINE_STAR_KERNELS(mono16, uint16_t, 1)
+DEFINE_STAR_KERNELS(rgb24, uint8_t, 3)
+DEFINE_STAR_KERNELS(rgb48, uint16_t, 3)
+
+static bool star_moments(indigo_raw_type raw_type, const void *data, const int width, const int height, const int radius, indigo_guide_star *star) {
+	switch (raw_type) {
+		case INDIGO_RAW_MONO8:
+			return moments_mono8(data, width, height, radius, star);
+		case INDIGO_RAW_MONO16:
+			return moments_mono16(data, width, height, radius, star);
+		case INDIGO_RAW_RGB24:
+			return moments_rgb24(data, width, height, radius, star);
+		case INDIGO_RAW_RGB48:
+			return moments_rgb48(data, width, height, radius, star);
+	}
+	return false;
+}
+
+static void star_peak(indigo_raw_type raw_type, const void *data, const int width, const int x0, const int y0, const int x1, const int y1, int *px, int *py) {
+	switch (raw_type) {
+		case INDIGO_RAW_MONO8:
+			peak_mono8(data, width, x0, y0, x1, y1, px, py);
+			break;
+		case INDIGO_RAW_MONO16:
+			peak_mono16(data, width, x0, y0, x1, y1, px, py);
+			break;
+		case INDIGO_RAW_RGB24:
+			peak_rgb24(data, width, x0, y0, x1, y1, px, py);
+			break;
+		case INDIGO_RAW_RGB48:
+			peak_rgb48(data, width, x0, y0, x1, y1, px, py);
+			break;
+	}
+}
+
+indigo_result indigo_multistar_reference_digest(indigo_raw_type raw_type, const void *data, const int radius, const int count, const int width, const int height, indigo_frame_digest *c) {
+	if ((width <= 4 * radius) || (height <= 4 * radius) || (count < 1))
+		return INDIGO_FAILED;
+	if ((data == NULL) || (c == NULL))
+		return INDIGO_FAILED;
+	long size = (long)width * height, sample_count = 0;
+	uint32_t *samples = malloc(MAX_SAMPLES * sizeof(uint32_t));
+	star_candidate *candidates = malloc(MAX_CANDIDATES * sizeof(star_candidate));
+	int candidate_count = 0, border = 2 * radius;
+	double background, sigma;
+	switch (raw_type) {
+		case INDIGO_RAW_MONO8:
+			sample_count = sample_mono8(data, size, samples);
+			break;
+		case INDIGO_RAW_MONO16:
+			sample_count = sample_mono16(data, size, samples);
+			break;
+		case INDIGO_RAW_RGB24:
+			sample_count = sample_rgb24(data, size, samples);
+			break;
+		case INDIGO_RAW_RGB48:
+			sample_count = sample_rgb48(data, size, samples);
+			break;
+	}
+	median_sigma(samples, sample_count, &background, &sigma);
+	free(samples);
+	uint32_t threshold = (uint32_t)(background + MIN_STAR_SNR * sigma);
+	switch (raw_type) {
+		case INDIGO_RAW_MONO8:
+			candidate_count = scan_mono8(data, width, height, border, threshold, 0xFF, candidates);
+			break;
+		case INDIGO_RAW_MONO16:
+			candidate_count = scan_mono16(data, width, height, border, threshold, 0xFFFF, candidates);
+			break;
+		case INDIGO_RAW_RGB24:
+			candidate_count = scan_rgb24(data, width, height, border, threshold, 3 * 0xFF, candidates);
+			break;
+		case INDIGO_RAW_RGB48:
+			candidate_count = scan_rgb48(data, width, height, border, threshold, 3 * 0xFFFF, candidates);
+			break;
+	}
+	qsort(candidates, candidate_count, sizeof(star_candidate), compare_candidates);
+	int max_count = count < INDIGO_MAX_GUIDE_STARS ? count : INDIGO_MAX_GUIDE_STARS, star_count = 0, min_distance = 4 * radius * radius;
+	indigo_guide_star *stars = malloc(max_count * sizeof(indigo_guide_star));
+	double snr = 0;
+	for (int k = 0; k < candidate_count && star_count < max_count; k++) {
+		// only stars without any other candidate in their window are used
+		bool isolated = true;
+		for (int l = 0; l < candidate_count && isolated; l++) {
+			int dx = candidates[l].x - candidates[k].x, dy = candidates[l].y - candidates[k].y;
+			isolated = l == k || dx * dx + dy * dy > min_distance;
+		}
+		if (!isolated)
+			continue;
+		indigo_guide_star *star = stars + star_count;
+		star->x = candidates[k].x;
+		star->y = candidates[k].y;
+		if (!star_moments(raw_type, data, width, height, radius, star) || !star_moments(raw_type, data, width, height, radius, star) || star->snr < MIN_STAR_SNR)
+			continue;
+		snr += star->snr;
+		star_count++;
+	}
+	free(candidates);
+	if (star_count == 0) {
+		free(stars);
+		return INDIGO_FAILED;
+	}
+	qsort(stars, star_count, sizeof(indigo_guide_star), compare_stars);
+	c->width = width;
+	c->height = height;
+	c->stars = stars;
+	c->star_count = star_count;
+	c->snr = snr / star_count;
+	c->algorithm = multistar;
+	//INDIGO_DEBUG(indigo_debug("indigo_multistar_reference_digest: %d stars, background = %g, sigma = %g", star_count, background, sigma));
+	return INDIGO_OK;
+}
+
+indigo_result indigo_multistar_frame_digest(indigo_raw_type raw_type, const void *data, const indigo_frame_digest *ref, const int radius, const int width, const int height, indigo_frame_digest *c) {
+	if ((data == NULL) || (ref == NULL) || (c == NULL))
+		return INDIGO_FAILED;
+	if ((ref->algorithm != multistar) || (ref->width != width) || (ref->height != height))
+		return INDIGO_FAILED;
+	// coarse frame shift is median of peak offsets of up to 3 brightest stars searched in 3x larger windows
+	int brightest[3] = { -1, -1, -1 };
+	for (int i = 0; i < ref->star_count; i++) {
+		for (int k = 0; k < 3; k++) {
+			if (brightest[k] == -1 || ref->stars[i].snr > ref->stars[brightest[k]].snr) {
+				memmove(brightest + k + 1, brightest + k, (2 - k) * sizeof(int));
+				brightest[k] = i;
+				break;
+			}
+		}
+	}
+	double shift_x[3], shift_y[3];
+	int shifts = 0;
+	for (int k = 0; k < 3 && brightest[k] != -1; k++) {
+		const indigo_guide_star *star = ref->stars + brightest[k];
+		int x = (int)round(star->x), y = (int)round(star->y), px = x, py = y;
+		int x0 = x - 3 * radius < 0 ? 0 : x - 3 * radius, x1 = x + 3 * radius >= width ? width - 1 : x + 3 * radius;
+		int y0 = y - 3 * radius < 0 ? 0 : y - 3 * radius, y1 = y + 3 * radius >= height ? height - 1 : y + 3 * radius;
+		star_peak(raw_type, data, width, x0, y0, x1, y1, &px, &py);
+		shift_x[shifts] = px - star->x;
+		shift_y[shifts] = py - star->y;
+		shifts++;
+	}
+	double dx = median_double(shift_x, shifts), dy = median_double(shift_y, shifts), snr = 0;
+	indigo_guide_star *stars = malloc(ref->star_count * sizeof(indigo_guide_star));
+	int valid = 0;
+	// each star window is scanned separately and twice (second scan is re-centered on the first centroid),
+	// reference stars are in row order, so windows are at least visited from top to bottom
+	for (int i = 0; i < ref->star_count; i++) {
+		indigo_guide_star *star = stars + i;
+		star->x = ref->stars[i].x + dx;
+		star->y = ref->stars[i].y + dy;
+		if (star_moments(raw_type, data, width, height, radius, star) && star_moments(raw_type, data, width, height, radius, star) && star->snr >= MIN_TRACKED_SNR) {
+			snr += star->snr;
+			valid++;
+		} else {
+			// lost star is ignored by indigo_calculate_drift()
+			star->snr = 0;
+		}
+	}
+	if (valid == 0) {
+		free(stars);
+		return INDIGO_FAILED;
+	}
+	c->width = width;
+	c->height = height;
+	c->stars = stars;
+	c->star_count = ref->star_count;
+	c->snr = snr / valid;
+	c->algorithm = multistar;
 	return INDIGO_OK;
 }
 
@@ -513,16 +910,60 @@ indigo_result indigo_calculate_drift(const indigo_frame_digest *ref, const indig
 		return INDIGO_OK;
 	}
 	if (ref->algorithm == donuts) {
-		double (*c_buf)[2];
-		int max_dim = (ref->width > ref->height) ? ref->width : ref->height;
-		c_buf = malloc(2 * max_dim * sizeof(double));
 		/* find X correction */
-		corellate_fft(ref->width, ref->fft_x, new->fft_x, c_buf);
-		*drift_x = -find_distance(ref->width, c_buf);
+		fft_plan *plan = get_fft_plan(ref->width);
+		pthread_mutex_lock(&plan->mutex);
+		corellate_fft(plan, ref->fft_x, new->fft_x, plan->scratch);
+		*drift_x = -find_distance(ref->width, plan->scratch);
+		pthread_mutex_unlock(&plan->mutex);
 		/* find Y correction */
-		corellate_fft(ref->height, ref->fft_y, new->fft_y, c_buf);
-		*drift_y = find_distance(ref->height, c_buf);
-		free(c_buf);
+		plan = get_fft_plan(ref->height);
+		pthread_mutex_lock(&plan->mutex);
+		corellate_fft(plan, ref->fft_y, new->fft_y, plan->scratch);
+		*drift_y = find_distance(ref->height, plan->scratch);
+		pthread_mutex_unlock(&plan->mutex);
+		return INDIGO_OK;
+	}
+	if (ref->algorithm == multistar) {
+		if ((new->algorithm != multistar) || (new->star_count != ref->star_count))
+			return INDIGO_FAILED;
+		double dx[INDIGO_MAX_GUIDE_STARS], dy[INDIGO_MAX_GUIDE_STARS], weight[INDIGO_MAX_GUIDE_STARS], deviation[INDIGO_MAX_GUIDE_STARS];
+		int count = 0;
+		// centroid error of faint stars is dominated by noise (weight ~ SNR^2), bright stars are limited by seeing (weight ~ 1)
+		for (int i = 0; i < ref->star_count; i++) {
+			if (new->stars[i].snr > 0) {
+				dx[count] = new->stars[i].x - ref->stars[i].x;
+				dy[count] = ref->stars[i].y - new->stars[i].y;
+				double snr2 = new->stars[i].snr * new->stars[i].snr;
+				weight[count] = snr2 / (snr2 + 100);
+				count++;
+			}
+		}
+		if (count == 0)
+			return INDIGO_FAILED;
+		// stars further than 3 sigma (MAD based, at least 0.5px) from median shift are rejected
+		double median_x = median_double(dx, count), median_y = median_double(dy, count);
+		for (int i = 0; i < count; i++)
+			deviation[i] = fabs(dx[i] - median_x);
+		double limit_x = fmax(3 * 1.4826 * median_double(deviation, count), 0.5);
+		for (int i = 0; i < count; i++)
+			deviation[i] = fabs(dy[i] - median_y);
+		double limit_y = fmax(3 * 1.4826 * median_double(deviation, count), 0.5);
+		double sum_x = 0, sum_y = 0, sum_weight = 0;
+		for (int i = 0; i < count; i++) {
+			if (fabs(dx[i] - median_x) <= limit_x && fabs(dy[i] - median_y) <= limit_y) {
+				sum_x += weight[i] * dx[i];
+				sum_y += weight[i] * dy[i];
+				sum_weight += weight[i];
+			}
+		}
+		if (sum_weight == 0) {
+			*drift_x = median_x;
+			*drift_y = median_y;
+		} else {
+			*drift_x = sum_x / sum_weight;
+			*drift_y = sum_y / sum_weight;
+		}
 		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
@@ -535,6 +976,11 @@ indigo_result indigo_delete_frame_digest(indigo_frame_digest *fdigest) {
 				free(fdigest->fft_x);
 			if (fdigest->fft_y)
 				free(fdigest->fft_y);
+		} else if (fdigest->algorithm == multistar) {
+			if (fdigest->stars)
+				free(fdigest->stars);
+			fdigest->stars = NULL;
+			fdigest->star_count = 0;
 		}
 		fdigest->width = 0;
 		fdigest->height = 0;
@@ -543,3 +989,322 @@ indigo_result indigo_delete_frame_digest(indigo_frame_digest *fdigest) {
 	}
 	return INDIGO_FAILED;
 }
+
+// Full frame star detection: background and noise are estimated on a mesh of MESH_SIZE cells (median and MAD of every
+// other pixel, smoothed by median filter), pixels above DETECTION_SIGMA are grouped to 8-connected components and
+// components with peak above MIN_STAR_SNR are measured. Frame is processed in strips in parallel, every strip has private
+// mask covering one row above it (to see that component started above) and 2 * max_radius rows below it and owns components
+// starting in its own rows.
+// Largest accepted star radius scales with frame size (at least MAX_STAR_RADIUS), so heavily defocused stars on autofocus
+// curve wings are still detected and measured. Median filter window grows with it to keep such stars out of background
+// (median of linear gradient is preserved), strips grow to keep their overlap reasonable.
+
+#define MESH_SIZE					64
+#define STRIP_HEIGHT			64
+#define MAX_STAR_RADIUS		24
+#define STAR_RADIUS_RATIO	20
+#define DETECTION_SIGMA		3
+#define MIN_STAR_AREA			4
+#define MAX_FIELD_STARS		1024
+
+typedef struct {
+	indigo_raw_type raw_type;
+	const void *data;
+	int width;
+	int height;
+	int max_radius;
+	int mesh_width;
+	int mesh_height;
+	int strip_height;
+	double *background;
+	double *noise;
+	uint32_t *threshold;
+	uint32_t saturation;
+	indigo_star_detection **stars;
+	int *counts;
+} detection_job;
+
+static inline uint32_t raw_pixel(indigo_raw_type raw_type, const void *data, const long i) {
+	switch (raw_type) {
+		case INDIGO_RAW_MONO8:
+			return pixel_mono8(data, i);
+		case INDIGO_RAW_MONO16:
+			return pixel_mono16(data, i);
+		case INDIGO_RAW_RGB24:
+			return pixel_rgb24(data, i);
+		case INDIGO_RAW_RGB48:
+			return pixel_rgb48(data, i);
+	}
+	return 0;
+}
+
+static void mesh_kernel(void *data, long from, long to) {
+	detection_job *job = data;
+	long unit = (long)MESH_SIZE * job->width;
+	uint32_t *samples = malloc(MESH_SIZE * MESH_SIZE / 4 * sizeof(uint32_t));
+	for (long mesh_row = (from + unit - 1) / unit; mesh_row * unit < to; mesh_row++) {
+		int y0 = (int)mesh_row * MESH_SIZE, y1 = y0 + MESH_SIZE < job->height ? y0 + MESH_SIZE : job->height;
+		for (int cell = 0; cell < job->mesh_width; cell++) {
+			int x0 = cell * MESH_SIZE, x1 = x0 + MESH_SIZE < job->width ? x0 + MESH_SIZE : job->width, count = 0;
+			for (int y = y0; y < y1; y += 2)
+				for (int x = x0; x < x1; x += 2)
+					samples[count++] = raw_pixel(job->raw_type, job->data, (long)y * job->width + x);
+			long index = mesh_row * job->mesh_width + cell;
+			median_sigma(samples, count, job->background + index, job->noise + index);
+		}
+	}
+	free(samples);
+}
+
+static double median_window(const double *values, const int mesh_width, const int mesh_height, const int x, const int y, const int k) {
+	double window[(2 * k + 1) * (2 * k + 1)];
+	int count = 0;
+	for (int j = y - k; j <= y + k; j++)
+		for (int i = x - k; i <= x + k; i++)
+			if (i >= 0 && j >= 0 && i < mesh_width && j < mesh_height)
+				window[count++] = values[j * mesh_width + i];
+	return median_double(window, count);
+}
+
+static void mask_rows(const detection_job *job, const int y0, const int y1, uint8_t *mask) {
+	for (int y = y0; y < y1; y++) {
+		const uint32_t *threshold = job->threshold + (y / MESH_SIZE) * job->mesh_width;
+		const long row = (long)y * job->width;
+		uint8_t *out = mask + (long)(y - y0) * job->width;
+		for (int cell = 0; cell < job->mesh_width; cell++) {
+			int x0 = cell * MESH_SIZE, x1 = x0 + MESH_SIZE < job->width ? x0 + MESH_SIZE : job->width;
+			uint32_t limit = threshold[cell];
+			switch (job->raw_type) {
+				case INDIGO_RAW_MONO8:
+					for (int x = x0; x < x1; x++)
+						out[x] = pixel_mono8(job->data, row + x) > limit;
+					break;
+				case INDIGO_RAW_MONO16:
+					for (int x = x0; x < x1; x++)
+						out[x] = pixel_mono16(job->data, row + x) > limit;
+					break;
+				case INDIGO_RAW_RGB24:
+					for (int x = x0; x < x1; x++)
+						out[x] = pixel_rgb24(job->data, row + x) > limit;
+					break;
+				case INDIGO_RAW_RGB48:
+					for (int x = x0; x < x1; x++)
+						out[x] = pixel_rgb48(job->data, row + x) > limit;
+					break;
+			}
+		}
+	}
+}
+
+// HFD is twice flux weighted mean distance from centroid, FWHM is diameter of circle with the same area as pixels above half maximum
+
+static bool measure_star(const detection_job *job, indigo_star_detection *star, const int radius) {
+	int xx = (int)round(star->x), yy = (int)round(star->y);
+	if (xx < radius || yy < radius || xx >= job->width - radius || yy >= job->height - radius)
+		return false;
+	double background = job->background[(yy / MESH_SIZE) * job->mesh_width + xx / MESH_SIZE];
+	double half_max = star->peak / 2, sum = 0, sum_r = 0;
+	int above_half_max = 0;
+	for (int j = -radius; j <= radius; j++) {
+		const long row = (long)(yy + j) * job->width;
+		for (int i = -radius; i <= radius; i++) {
+			if (i * i + j * j > radius * radius)
+				continue;
+			double value = raw_pixel(job->raw_type, job->data, row + xx + i) - background;
+			double dx = xx + i - star->x, dy = yy + j - star->y;
+			sum += value;
+			sum_r += value * sqrt(dx * dx + dy * dy);
+			if (value >= half_max)
+				above_half_max++;
+		}
+	}
+	if (sum <= 0 || sum_r <= 0)
+		return false;
+	star->hfd = 2 * sum_r / sum;
+	star->fwhm = 2 * sqrt(above_half_max / M_PI);
+	return true;
+}
+
+static void detection_kernel(void *data, long from, long to) {
+	detection_job *job = data;
+	const int width = job->width, margin = 2 * job->max_radius;
+	long unit = (long)job->strip_height * width;
+	uint8_t *mask = malloc((long)(job->strip_height + 1 + margin) * width);
+	int stack_size = 1024;
+	long *stack = malloc(stack_size * sizeof(long));
+	for (long strip = (from + unit - 1) / unit; strip * unit < to; strip++) {
+		int y0 = (int)strip * job->strip_height, y1 = y0 + job->strip_height < job->height ? y0 + job->strip_height : job->height;
+		int m0 = y0 > 0 ? y0 - 1 : 0, m1 = y1 + margin < job->height ? y1 + margin : job->height;
+		int capacity = 0;
+		mask_rows(job, m0, m1, mask);
+		for (long seed = (long)(y0 - m0) * width; seed < (long)(y1 - m0) * width; seed++) {
+			if (mask[seed] != 1)
+				continue;
+			// flood fill of 8-connected component, pixels are marked by 2 when visited
+			int top = 0, area = 0, min_x = width, max_x = 0, min_y = m1, max_y = 0;
+			uint32_t peak = 0;
+			double sum = 0, sum_x = 0, sum_y = 0;
+			mask[seed] = 2;
+			stack[top++] = seed;
+			while (top > 0) {
+				long index = stack[--top];
+				int x = (int)(index % width), y = (int)(index / width) + m0;
+				uint32_t value = raw_pixel(job->raw_type, job->data, (long)y * width + x);
+				double weight = value - job->background[(y / MESH_SIZE) * job->mesh_width + x / MESH_SIZE];
+				area++;
+				sum += weight;
+				sum_x += weight * x;
+				sum_y += weight * y;
+				if (value > peak)
+					peak = value;
+				if (x < min_x)
+					min_x = x;
+				if (x > max_x)
+					max_x = x;
+				if (y < min_y)
+					min_y = y;
+				if (y > max_y)
+					max_y = y;
+				for (int j = -1; j <= 1; j++) {
+					if (y + j < m0 || y + j >= m1)
+						continue;
+					for (int i = -1; i <= 1; i++) {
+						if (x + i < 0 || x + i >= width)
+							continue;
+						long neighbour = index + j * width + i;
+						if (mask[neighbour] == 1) {
+							mask[neighbour] = 2;
+							if (top == stack_size) {
+								stack_size *= 2;
+								stack = realloc(stack, stack_size * sizeof(long));
+							}
+							stack[top++] = neighbour;
+						}
+					}
+				}
+			}
+			// component starting in strip above, touching private mask border, too small or too large is not a star
+			if (min_y < y0 || (min_y == m0 && m0 > 0) || (max_y == m1 - 1 && m1 < job->height))
+				continue;
+			if (area < MIN_STAR_AREA || max_x - min_x >= 2 * job->max_radius || max_y - min_y >= 2 * job->max_radius || sum <= 0)
+				continue;
+			indigo_star_detection star = { .x = sum_x / sum, .y = sum_y / sum, .flux = sum };
+			int cell = ((int)star.y / MESH_SIZE) * job->mesh_width + (int)star.x / MESH_SIZE;
+			star.peak = peak - job->background[cell];
+			if (peak >= job->saturation || star.peak < MIN_STAR_SNR * job->noise[cell])
+				continue;
+			int extent = (max_x - min_x > max_y - min_y ? max_x - min_x : max_y - min_y) / 2 + 1;
+			int radius = 2 * extent < 4 ? 4 : 2 * extent > job->max_radius ? job->max_radius : 2 * extent;
+			if (!measure_star(job, &star, radius))
+				continue;
+			if (job->counts[strip] == capacity) {
+				capacity = capacity ? 2 * capacity : 16;
+				job->stars[strip] = realloc(job->stars[strip], capacity * sizeof(indigo_star_detection));
+			}
+			job->stars[strip][job->counts[strip]++] = star;
+		}
+	}
+	free(stack);
+	free(mask);
+}
+
+static int compare_detections(const void *a, const void *b) {
+	double aa = ((const indigo_star_detection *)a)->flux, bb = ((const indigo_star_detection *)b)->flux;
+	return (aa < bb) - (aa > bb);
+}
+
+indigo_result indigo_find_stars(indigo_raw_type raw_type, const void *data, const int width, const int height, const int max_stars, indigo_star_detection star_list[], int *star_count) {
+	if ((width < 3) || (height < 3) || (max_stars < 1))
+		return INDIGO_FAILED;
+	if ((data == NULL) || (star_list == NULL) || (star_count == NULL))
+		return INDIGO_FAILED;
+	int max_radius = (width < height ? width : height) / STAR_RADIUS_RATIO;
+	if (max_radius < MAX_STAR_RADIUS)
+		max_radius = MAX_STAR_RADIUS;
+	int strip_height = 2 * max_radius > STRIP_HEIGHT ? 2 * max_radius : STRIP_HEIGHT;
+	// filter window is at least twice as wide as the largest star
+	int filter_radius = (2 * max_radius + MESH_SIZE - 1) / MESH_SIZE;
+	detection_job job = { .raw_type = raw_type, .data = data, .width = width, .height = height, .max_radius = max_radius, .mesh_width = (width + MESH_SIZE - 1) / MESH_SIZE, .mesh_height = (height + MESH_SIZE - 1) / MESH_SIZE, .strip_height = strip_height };
+	int cells = job.mesh_width * job.mesh_height, strips = (height + strip_height - 1) / strip_height;
+	double *background = malloc(cells * sizeof(double)), *noise = malloc(cells * sizeof(double));
+	job.background = malloc(cells * sizeof(double));
+	job.noise = malloc(cells * sizeof(double));
+	job.threshold = malloc(cells * sizeof(uint32_t));
+	switch (raw_type) {
+		case INDIGO_RAW_MONO8:
+			job.saturation = 0xFF;
+			break;
+		case INDIGO_RAW_MONO16:
+			job.saturation = 0xFFFF;
+			break;
+		case INDIGO_RAW_RGB24:
+			job.saturation = 3 * 0xFF;
+			break;
+		case INDIGO_RAW_RGB48:
+			job.saturation = 3 * 0xFFFF;
+			break;
+	}
+	indigo_parallel(mesh_kernel, &job, (long)job.mesh_height * MESH_SIZE * width);
+	for (int y = 0; y < job.mesh_height; y++) {
+		for (int x = 0; x < job.mesh_width; x++) {
+			background[y * job.mesh_width + x] = median_window(job.background, job.mesh_width, job.mesh_height, x, y, filter_radius);
+			noise[y * job.mesh_width + x] = median_window(job.noise, job.mesh_width, job.mesh_height, x, y, filter_radius);
+		}
+	}
+	free(job.background);
+	free(job.noise);
+	job.background = background;
+	job.noise = noise;
+	for (int i = 0; i < cells; i++)
+		job.threshold[i] = (uint32_t)(background[i] + DETECTION_SIGMA * noise[i]);
+	job.stars = calloc(strips, sizeof(indigo_star_detection *));
+	job.counts = calloc(strips, sizeof(int));
+	indigo_parallel(detection_kernel, &job, (long)strips * strip_height * width);
+	int count = 0;
+	for (int i = 0; i < strips; i++)
+		count += job.counts[i];
+	indigo_star_detection *stars = malloc((count ? count : 1) * sizeof(indigo_star_detection));
+	count = 0;
+	for (int i = 0; i < strips; i++) {
+		if (job.stars[i]) {
+			memcpy(stars + count, job.stars[i], job.counts[i] * sizeof(indigo_star_detection));
+			count += job.counts[i];
+			free(job.stars[i]);
+		}
+	}
+	qsort(stars, count, sizeof(indigo_star_detection), compare_detections);
+	*star_count = count < max_stars ? count : max_stars;
+	memcpy(star_list, stars, *star_count * sizeof(indigo_star_detection));
+	free(stars);
+	free(job.stars);
+	free(job.counts);
+	free(job.threshold);
+	free(background);
+	free(noise);
+	//INDIGO_DEBUG(indigo_debug("indigo_find_stars: %d stars", count));
+	return INDIGO_OK;
+}
+
+indigo_result indigo_field_psf(indigo_raw_type raw_type, const void *data, const int width, const int height, double *hfd, double *fwhm, int *star_count) {
+	if ((hfd == NULL) || (fwhm == NULL) || (star_count == NULL))
+		return INDIGO_FAILED;
+	indigo_star_detection *stars = malloc(MAX_FIELD_STARS * sizeof(indigo_star_detection));
+	int count = 0;
+	*hfd = *fwhm = 0;
+	*star_count = 0;
+	if (indigo_find_stars(raw_type, data, width, height, MAX_FIELD_STARS, stars, &count) != INDIGO_OK || count == 0) {
+		free(stars);
+		return INDIGO_FAILED;
+	}
+	double *values = malloc(count * sizeof(double));
+	for (int i = 0; i < count; i++)
+		values[i] = stars[i].hfd;
+	*hfd = median_double(values, count);
+	for (int i = 0; i < count; i++)
+		values[i] = stars[i].fwhm;
+	*fwhm = median_double(values, count);
+	*star_count = count;
+	free(values);
+	free(stars);
+	return INDIGO_OK;
+}
@@ -30,12 +30,15 @@
 #include <stdarg.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <assert.h>
 #include <pthread.h>
+#include <time.h>
 #include <sys/types.h>
 #if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
 #include <unistd.h>
 #include <termios.h>
 #include <netdb.h>
+#include <sys/select.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -50,6 +53,37 @@
 
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_io.h>
+#include <indigo/indigo_base64.h>
+
+#define OUTPUT_QUEUE_SIZE					(16 * 1024 * 1024)
+#define OUTPUT_QUEUE_MAX_COUNT		4096
+#define READER_BUFFER_SIZE				4096
+#define BASE64_CHUNK_SIZE					(48 * 1024)
+#define OUTPUT_QUEUE_CLOSE_TIMEOUT	5
+
+typedef struct indigo_queued_message {
+	char *data;
+	long length;
+	indigo_message_blob *blobs;
+	long size;
+	char key[2 * INDIGO_NAME_SIZE];
+	indigo_queue_policy policy;
+	struct indigo_queued_message *next;
+} indigo_queued_message;
+
+struct indigo_output_queue {
+	int handle;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+	indigo_queued_message *head;
+	indigo_queued_message *tail;
+	long pending_size;
+	int pending_count;
+	bool closing;
+	bool failed;
+	bool finished;
+};
 
 #if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
 
@@ -392,6 +426,43 @@ int indigo_close(int handle) {
 int indigo_read_line(int handle, char *buffer, int length) {
 	char c = '\0';
 	long total_bytes = 0;
+	length--;
+#if !defined(INDIGO_WINDOWS)
+	while (total_bytes < length) {
+		long bytes_read = recv(handle, buffer + total_bytes, length - total_bytes, MSG_PEEK);
+		if (bytes_read < 0 && errno == EINTR)
+			continue;
+		if (bytes_read < 0 && errno == ENOTSOCK)
+			break;
+		if (bytes_read <= 0) {
+			errno = ECONNRESET;
+			INDIGO_TRACE_PROTOCOL(indigo_trace("%d → ERROR", handle));
+			return -1;
+		}
+		char *end = memchr(buffer + total_bytes, '\n', bytes_read);
+		if (end != NULL)
+			bytes_read = end - (buffer + total_bytes) + 1;
+		long bytes_consumed;
+		while ((bytes_consumed = recv(handle, buffer + total_bytes, bytes_read, 0)) < 0 && errno == EINTR)
+			;
+		if (bytes_consumed != bytes_read) {
+			errno = ECONNRESET;
+			INDIGO_TRACE_PROTOCOL(indigo_trace("%d → ERROR", handle));
+			return -1;
+		}
+		char *in = buffer + total_bytes, *out = in;
+		for (long i = 0; i < bytes_read; i++, in++) {
+			if (*in != '\r' && *in != '\n')
+				*out++ = *in;
+		}
+		total_bytes = out - buffer;
+		if (end != NULL) {
+			buffer[total_bytes] = '\0';
+			INDIGO_TRACE_PROTOCOL(indigo_trace("%d → %s", handle, buffer));
+			return (int)total_bytes;
+		}
+	}
+#endif
 	while (total_bytes < length) {
 #if defined(INDIGO_WINDOWS)
 		long bytes_read = recv(handle, &c, 1, 0);
@@ -458,3 +529,377 @@ int indigo_scanf(int handle, const char *format, ...) {
 	va_end(args);
 	return count;
 }
+
+struct indigo_reader {
+	int handle;
+	int start;
+	int end;
+	char buffer[READER_BUFFER_SIZE];
+};
+
+indigo_reader *indigo_create_reader(int handle) {
+	indigo_reader *reader = malloc(sizeof(indigo_reader));
+	assert(reader != NULL);
+	reader->handle = handle;
+	reader->start = reader->end = 0;
+	return reader;
+}
+
+// Wait up to timeout us (negative = forever) and read available data into reader buffer, returns number of bytes, 0 on timeout or -1 on error.
+
+static int reader_fill(indigo_reader *reader, long timeout) {
+	if (reader->start == reader->end) {
+		reader->start = reader->end = 0;
+	} else if (reader->start > 0) {
+		memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+		reader->end -= reader->start;
+		reader->start = 0;
+	}
+	while (true) {
+		if (timeout >= 0) {
+			fd_set readout;
+			FD_ZERO(&readout);
+			FD_SET(reader->handle, &readout);
+			struct timeval tv = { timeout / 1000000, timeout % 1000000 };
+			int result = select(reader->handle + 1, &readout, NULL, NULL, &tv);
+			if (result < 0 && errno == EINTR)
+				continue;
+			if (result < 0)
+				return -1;
+			if (result == 0)
+				return 0;
+		}
+#if defined(INDIGO_WINDOWS)
+		long bytes_read = recv(reader->handle, reader->buffer + reader->end, READER_BUFFER_SIZE - reader->end, 0);
+		if (bytes_read == -1 && WSAGetLastError() == WSAETIMEDOUT) {
+			Sleep(500);
+			continue;
+		}
+#else
+		long bytes_read = read(reader->handle, reader->buffer + reader->end, READER_BUFFER_SIZE - reader->end);
+		if (bytes_read < 0 && errno == EINTR)
+			continue;
+#endif
+		if (bytes_read <= 0) {
+			if (bytes_read == 0)
+				errno = ECONNRESET;
+			INDIGO_TRACE_PROTOCOL(indigo_trace("%d → ERROR", reader->handle));
+			return -1;
+		}
+		reader->end += bytes_read;
+		return (int)bytes_read;
+	}
+}
+
+static int reader_read_until(indigo_reader *reader, char *buffer, int length, char delimiter, bool skip_cr, long timeout, long next_timeout) {
+	int total_bytes = 0;
+	length--;
+	while (total_bytes < length) {
+		if (reader->start == reader->end) {
+			int result = reader_fill(reader, timeout);
+			if (result < 0)
+				return -1;
+			if (result == 0)
+				break;
+			timeout = next_timeout;
+		}
+		char c = reader->buffer[reader->start++];
+		if (c == delimiter)
+			break;
+		if (skip_cr && c == '\r')
+			continue;
+		buffer[total_bytes++] = c;
+	}
+	buffer[total_bytes] = '\0';
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d → %s", reader->handle, buffer));
+	return total_bytes;
+}
+
+int indigo_reader_read_line(indigo_reader *reader, char *buffer, int length) {
+	return reader_read_until(reader, buffer, length, '\n', true, -1, -1);
+}
+
+int indigo_reader_read_until(indigo_reader *reader, char *buffer, int length, char delimiter, long timeout, long next_timeout) {
+	return reader_read_until(reader, buffer, length, delimiter, false, timeout, next_timeout);
+}
+
+int indigo_reader_read(indigo_reader *reader, char *buffer, int length) {
+	int buffered = reader->end - reader->start;
+	if (buffered >= length) {
+		memcpy(buffer, reader->buffer + reader->start, length);
+		reader->start += length;
+		return length;
+	}
+	memcpy(buffer, reader->buffer + reader->start, buffered);
+	reader->start = reader->end = 0;
+	if (indigo_read(reader->handle, buffer + buffered, length - buffered) != length - buffered)
+		return -1;
+	return length;
+}
+
+bool indigo_reader_discard(indigo_reader *reader, long timeout) {
+	while (true) {
+		reader->start = reader->end = 0;
+		int result = reader_fill(reader, timeout);
+		if (result < 0)
+			return false;
+		if (result == 0)
+			return true;
+	}
+}
+
+void indigo_release_reader(indigo_reader *reader) {
+	free(reader);
+}
+
+void indigo_message_append(indigo_message *message, const char *data, long length) {
+	memcpy(indigo_message_reserve(message, length), data, length);
+	message->length += length;
+}
+
+char *indigo_message_reserve(indigo_message *message, long length) {
+	if (message->length + length + 1 > message->size) {
+		long size = message->size ? message->size : 1024;
+		while (message->length + length + 1 > size)
+			size *= 2;
+		message->data = realloc(message->data, size);
+		message->size = size;
+	}
+	return message->data + message->length;
+}
+
+void indigo_message_printf(indigo_message *message, const char *format, ...) {
+	char buffer[1024];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+	if (length < sizeof(buffer)) {
+		indigo_message_append(message, buffer, length);
+	} else {
+		va_start(args, format);
+		vsnprintf(indigo_message_reserve(message, length), length + 1, format, args);
+		va_end(args);
+		message->length += length;
+	}
+}
+
+void indigo_message_append_blob(indigo_message *message, indigo_blob_buffer *buffer, const void *data, long size, bool base64) {
+	if (buffer == NULL || !indigo_blob_buffer_contains(buffer, data, size)) {
+		// driver owns data and may overwrite it once update is finished, so it has to be copied
+		if (base64) {
+			char *encoded = indigo_message_reserve(message, (size + 2) / 3 * 4);
+			message->length += base64_encode((unsigned char *)encoded, data, size);
+		} else {
+			indigo_message_append(message, data, size);
+		}
+		return;
+	}
+	indigo_message_blob *blob = malloc(sizeof(indigo_message_blob));
+	assert(blob != NULL);
+	blob->offset = message->length;
+	blob->buffer = indigo_retain_blob_buffer(buffer);
+	blob->data = data;
+	blob->size = size;
+	blob->base64 = base64;
+	blob->next = NULL;
+	indigo_message_blob **tail = &message->blobs;
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = blob;
+}
+
+static void release_message_blobs(indigo_message_blob *blob) {
+	while (blob) {
+		indigo_message_blob *next = blob->next;
+		indigo_release_blob_buffer(blob->buffer);
+		free(blob);
+		blob = next;
+	}
+}
+
+// Payload is encoded in chunks of multiple of 3 bytes, so the output is the same as if it was encoded at once.
+
+static bool write_message_blob(int handle, indigo_message_blob *blob) {
+	if (!blob->base64)
+		return indigo_write(handle, (const char *)blob->data, blob->size);
+	unsigned char encoded[BASE64_CHUNK_SIZE / 3 * 4 + 1];
+	for (long offset = 0; offset < blob->size; offset += BASE64_CHUNK_SIZE) {
+		long length = blob->size - offset < BASE64_CHUNK_SIZE ? blob->size - offset : BASE64_CHUNK_SIZE;
+		if (!indigo_write(handle, (const char *)encoded, base64_encode(encoded, blob->data + offset, length)))
+			return false;
+	}
+	return true;
+}
+
+static bool write_message(int handle, const char *data, long length, indigo_message_blob *blob) {
+	long offset = 0;
+	for (; blob; blob = blob->next) {
+		if (blob->offset > offset && !indigo_write(handle, data + offset, blob->offset - offset))
+			return false;
+		if (!write_message_blob(handle, blob))
+			return false;
+		offset = blob->offset;
+	}
+	return offset == length || indigo_write(handle, data + offset, length - offset);
+}
+
+bool indigo_write_message(int handle, indigo_message *message) {
+	bool result = write_message(handle, message->data, message->length, message->blobs);
+	free(message->data);
+	release_message_blobs(message->blobs);
+	memset(message, 0, sizeof(indigo_message));
+	return result;
+}
+
+static void release_queued_message(indigo_queued_message *message) {
+	free(message->data);
+	release_message_blobs(message->blobs);
+	free(message);
+}
+
+static void shutdown_handle(int handle) {
+#if defined(INDIGO_WINDOWS)
+	shutdown(handle, SD_BOTH);
+#else
+	shutdown(handle, SHUT_RDWR);
+#endif
+}
+
+static void *output_queue_writer(indigo_output_queue *queue) {
+	pthread_mutex_lock(&queue->mutex);
+	while (true) {
+		while (queue->head == NULL && !queue->closing)
+			pthread_cond_wait(&queue->changed, &queue->mutex);
+		indigo_queued_message *message = queue->head;
+		if (message == NULL)
+			break;
+		if ((queue->head = message->next) == NULL)
+			queue->tail = NULL;
+		queue->pending_size -= message->size;
+		queue->pending_count--;
+		bool failed = queue->failed;
+		pthread_mutex_unlock(&queue->mutex);
+		if (!failed) {
+			failed = !write_message(queue->handle, message->data, message->length, message->blobs);
+			INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %.*s", queue->handle, (int)(message->length < 4096 ? message->length : 4096), message->data));
+		}
+		pthread_mutex_lock(&queue->mutex);
+		if (failed && !queue->failed) {
+			INDIGO_DEBUG(indigo_debug("Output queue %d: write failed (%s)", queue->handle, strerror(errno)));
+			queue->failed = true;
+		}
+		release_queued_message(message);
+		pthread_cond_broadcast(&queue->changed);
+	}
+	queue->finished = true;
+	pthread_cond_broadcast(&queue->changed);
+	pthread_mutex_unlock(&queue->mutex);
+	return NULL;
+}
+
+indigo_output_queue *indigo_create_output_queue(int handle) {
+	indigo_output_queue *queue = malloc(sizeof(indigo_output_queue));
+	assert(queue != NULL);
+	memset(queue, 0, sizeof(indigo_output_queue));
+	queue->handle = handle;
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->changed, NULL);
+	if (pthread_create(&queue->thread, NULL, (void *(*)(void *))output_queue_writer, queue) != 0) {
+		INDIGO_ERROR(indigo_error("Output queue %d: can't create writer thread (%s)", handle, strerror(errno)));
+		pthread_cond_destroy(&queue->changed);
+		pthread_mutex_destroy(&queue->mutex);
+		free(queue);
+		return NULL;
+	}
+	return queue;
+}
+
+bool indigo_queue_message(indigo_output_queue *queue, const char *key, indigo_queue_policy policy, indigo_message *message) {
+	assert(queue != NULL);
+	assert(message != NULL);
+	indigo_queued_message *queued = malloc(sizeof(indigo_queued_message));
+	assert(queued != NULL);
+	queued->data = message->data;
+	queued->length = message->length;
+	queued->blobs = message->blobs;
+	// only content owned by the queue counts, shared BLOB payloads are just retained
+	queued->size = message->length;
+	queued->policy = policy;
+	queued->next = NULL;
+	strncpy(queued->key, key ? key : "", sizeof(queued->key));
+	memset(message, 0, sizeof(indigo_message));
+	pthread_mutex_lock(&queue->mutex);
+	if (policy != INDIGO_QUEUE_KEEP && *queued->key) {
+		// the latest value wins, drop pending messages with the same key
+		indigo_queued_message *previous = NULL, *pending = queue->head;
+		while (pending) {
+			indigo_queued_message *next = pending->next;
+			if (pending->policy == policy && !strcmp(pending->key, queued->key)) {
+				if (previous)
+					previous->next = next;
+				else
+					queue->head = next;
+				if (queue->tail == pending)
+					queue->tail = previous;
+				queue->pending_size -= pending->size;
+				queue->pending_count--;
+				release_queued_message(pending);
+			} else {
+				previous = pending;
+			}
+			pending = next;
+		}
+	}
+	if (policy == INDIGO_QUEUE_BLOB && queue->pending_count > 0 && queue->pending_size + queued->size > OUTPUT_QUEUE_SIZE) {
+		// producer is never blocked, BLOB is rejected if the client didn't consume previous data yet (caller has to tell the client)
+		INDIGO_DEBUG(indigo_debug("Output queue %d: BLOB '%s' dropped (%ld bytes pending)", queue->handle, queued->key, queue->pending_size));
+		pthread_mutex_unlock(&queue->mutex);
+		release_queued_message(queued);
+		return false;
+	} else if (queue->pending_count >= OUTPUT_QUEUE_MAX_COUNT && !queue->failed) {
+		INDIGO_ERROR(indigo_error("Output queue %d: client is not reading, connection closed", queue->handle));
+		queue->failed = true;
+		shutdown_handle(queue->handle);
+	}
+	if (queue->failed || queue->closing) {
+		pthread_mutex_unlock(&queue->mutex);
+		release_queued_message(queued);
+		return false;
+	}
+	if (queue->tail)
+		queue->tail->next = queued;
+	else
+		queue->head = queued;
+	queue->tail = queued;
+	queue->pending_size += queued->size;
+	queue->pending_count++;
+	pthread_cond_broadcast(&queue->changed);
+	pthread_mutex_unlock(&queue->mutex);
+	return true;
+}
+
+void indigo_release_output_queue(indigo_output_queue *queue) {
+	if (queue == NULL)
+		return;
+	pthread_mutex_lock(&queue->mutex);
+	queue->closing = true;
+	pthread_cond_broadcast(&queue->changed);
+	// pending messages are flushed, but a stalled peer must not block the caller forever
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += OUTPUT_QUEUE_CLOSE_TIMEOUT;
+	while (!queue->finished) {
+		if (pthread_cond_timedwait(&queue->changed, &queue->mutex, &deadline) == ETIMEDOUT) {
+			INDIGO_DEBUG(indigo_debug("Output queue %d: peer is not reading, connection closed", queue->handle));
+			queue->failed = true;
+			shutdown_handle(queue->handle);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&queue->mutex);
+	pthread_join(queue->thread, NULL);
+	pthread_cond_destroy(&queue->changed);
+	pthread_mutex_destroy(&queue->mutex);
+	free(queue);
+}
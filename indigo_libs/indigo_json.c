@@ -133,6 +133,8 @@ static void *one_text_handler(parser_state state, char *name, char *value, indig
 	if (state == END_STRUCT) {
 		if (property->count < INDIGO_MAX_ITEMS)
 			property->count++;
+		if (property->count < INDIGO_MAX_ITEMS)
+			memset(property->items + property->count, 0, sizeof(indigo_item));
 	} else if (state == TEXT_VALUE && !strcmp(name, "name")) {
 		strncpy(property->items[property->count].name, value, INDIGO_NAME_SIZE);
 	} else if (state == TEXT_VALUE && !strcmp(name, "value")) {
@@ -145,6 +147,7 @@ static void *new_text_vector_handler(parser_state state, char *name, char *value
 	INDIGO_TRACE_PARSER(indigo_trace("JSON Parser: %s %s '%s' '%s'", __FUNCTION__, parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_ARRAY && !strcmp(name, "items")) {
 		property->count = 0;
+		memset(property->items, 0, sizeof(indigo_item));
 		return one_text_handler;
 	}
 	if (state == TEXT_VALUE) {
@@ -167,6 +170,8 @@ static void *one_number_handler(parser_state state, char *name, char *value, ind
 	if (state == END_STRUCT) {
 		if (property->count < INDIGO_MAX_ITEMS)
 			property->count++;
+		if (property->count < INDIGO_MAX_ITEMS)
+			memset(property->items + property->count, 0, sizeof(indigo_item));
 	} else if (state == TEXT_VALUE && !strcmp(name, "name")) {
 		strncpy(property->items[property->count].name, value, INDIGO_NAME_SIZE);
 	} else if (state == NUMBER_VALUE && !strcmp(name, "value")) {
@@ -179,6 +184,7 @@ static void *new_number_vector_handler(parser_state state, char *name, char *val
 	INDIGO_TRACE_PARSER(indigo_trace("JSON Parser: %s %s '%s' '%s'", __FUNCTION__, parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_ARRAY && !strcmp(name, "items")) {
 		property->count = 0;
+		memset(property->items, 0, sizeof(indigo_item));
 		return one_number_handler;
 	}
 	if (state == TEXT_VALUE) {
@@ -201,6 +207,8 @@ static void *one_switch_handler(parser_state state, char *name, char *value, ind
 	if (state == END_STRUCT) {
 		if (property->count < INDIGO_MAX_ITEMS)
 			property->count++;
+		if (property->count < INDIGO_MAX_ITEMS)
+			memset(property->items + property->count, 0, sizeof(indigo_item));
 	} else if (state == TEXT_VALUE && !strcmp(name, "name")) {
 		strncpy(property->items[property->count].name, value, INDIGO_NAME_SIZE);
 	} else if (state == LOGICAL_VALUE && !strcmp(name, "value")) {
@@ -213,6 +221,7 @@ static void *new_switch_vector_handler(parser_state state, char *name, char *val
 	INDIGO_TRACE_PARSER(indigo_trace("JSON Parser: %s %s '%s' '%s'", __FUNCTION__, parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_ARRAY && !strcmp(name, "items")) {
 		property->count = 0;
+		memset(property->items, 0, sizeof(indigo_item));
 		return one_switch_handler;
 	}
 	if (state == TEXT_VALUE) {
@@ -231,7 +240,8 @@ static void *new_switch_vector_handler(parser_state state, char *name, char *val
 static void *top_level_handler(parser_state state, char *name, char *value, indigo_property *property, indigo_device *device, indigo_client *client, char *message) {
 	INDIGO_TRACE_PARSER(indigo_trace("JSON Parser: %s %s '%s' '%s'", __FUNCTION__, parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_STRUCT) {
-		memset(property, 0, PROPERTY_SIZE);
+		// items are cleared one by one as they are parsed, so only the touched part of the buffer is ever written
+		memset(property, 0, sizeof(indigo_property));
 		if (name != NULL) {
 			if (!strcmp(name, "getProperties"))
 				return get_properties_handler;
@@ -274,7 +284,7 @@ void indigo_json_parse(indigo_device *device, indigo_client *client) {
 	parser_handler handler = top_level_handler;
 	parser_state state = IDLE;
 	indigo_property *property = (indigo_property *)property_buffer;
-	memset(property_buffer, 0, PROPERTY_SIZE);
+	memset(property, 0, sizeof(indigo_property));
 
 	while (true) {
 		assert(pointer - buffer <= JSON_BUFFER_SIZE);
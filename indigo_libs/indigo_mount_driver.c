@@ -265,14 +265,15 @@ void indigo_mount_load_alignment_points(indigo_device *device) {
 	if (handle > 0) {
 		int count;
 		char buffer[1024], name[INDIGO_NAME_SIZE], label[INDIGO_VALUE_SIZE];
-		indigo_read_line(handle, buffer, sizeof(buffer));
+		indigo_reader *reader = indigo_create_reader(handle);
+		indigo_reader_read_line(reader, buffer, sizeof(buffer));
 		sscanf(buffer, "%d", &count);
 		MOUNT_CONTEXT->alignment_point_count = count;
 		MOUNT_ALIGNMENT_SELECT_POINTS_PROPERTY->count = count;
 		MOUNT_ALIGNMENT_DELETE_POINTS_PROPERTY->count = count;
 		for (int i = 0; i < count; i++) {
 			indigo_alignment_point *point =  MOUNT_CONTEXT->alignment_points + i;
-			indigo_read_line(handle, buffer, sizeof(buffer));
+			indigo_reader_read_line(reader, buffer, sizeof(buffer));
 			point->used = false;
 			sscanf(buffer, "%d %lg %lg %lg %lg %lg %d", (int *)&point->used, &point->ra, &point->dec, &point->raw_ra, &point->raw_dec, &point->lst, &point->side_of_pier);
 			snprintf(name, INDIGO_NAME_SIZE, "%d", i);
@@ -280,6 +281,7 @@ void indigo_mount_load_alignment_points(indigo_device *device) {
 			indigo_init_switch_item(MOUNT_ALIGNMENT_SELECT_POINTS_PROPERTY->items + i, name, label, point->used);
 			indigo_init_switch_item(MOUNT_ALIGNMENT_DELETE_POINTS_PROPERTY->items + i, name, label, false);
 		}
+		indigo_release_reader(reader);
 		close(handle);
 		if (IS_CONNECTED) {
 			MOUNT_ALIGNMENT_SELECT_POINTS_PROPERTY->state = INDIGO_OK_STATE;
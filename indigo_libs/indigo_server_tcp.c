@@ -34,6 +34,7 @@
 #include <signal.h>
 #include <stdarg.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -43,6 +44,14 @@
 
 #ifdef INDIGO_LINUX
 #include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#endif
+
+#ifdef INDIGO_MACOS
+#include <sys/uio.h>
 #endif
 
 #include <indigo/indigo_bus.h>
@@ -67,6 +76,10 @@ static bool shutdown_initiated = false;
 static int client_count = 0;
 static indigo_server_tcp_callback server_callback;
 
+#ifdef INDIGO_LINUX
+static int epoll_handle = -1;
+#endif
+
 int indigo_server_tcp_port = 7624;
 bool indigo_is_ephemeral_port = false;
 
@@ -81,190 +94,674 @@ static struct resource {
 
 #define BUFFER_SIZE	1024
 
-static void start_worker_thread(int *client_socket) {
-	int socket = *client_socket;
-	INDIGO_LOG(indigo_log("Worker thread started socket = %d", socket));
-	server_callback(++client_count);
-	int res = 0;
-	char c;
-	if (recv(socket, &c, 1, MSG_PEEK) == 1) {
-		if (c == '<') {
-			INDIGO_LOG(indigo_log("Protocol switched to XML"));
-			indigo_client *protocol_adapter = indigo_xml_device_adapter(socket, socket);
-			assert(protocol_adapter != NULL);
-			indigo_attach_client(protocol_adapter);
-			indigo_xml_parse(NULL, protocol_adapter);
-			indigo_detach_client(protocol_adapter);
-			indigo_release_xml_device_adapter(protocol_adapter);
-		} else if (c == '{') {
+#define ZEROCOPY_THRESHOLD	(1024 * 1024)
+#define TRANSFER_THRESHOLD	(64 * 1024)
+#define HTTP_WORKER_COUNT	4
+#define HTTP_TIMEOUT			10
+#define HTTP_IDLE_TIMEOUT		30
+#define HTTP_HEADER_SIZE		8192
+
+// Parse single "bytes=first-last", "bytes=first-" or "bytes=-suffix" range.
+// Returns 1 for valid range, 0 if range is missing or not supported (whole content is sent) and -1 if range is not satisfiable.
+
+static int parse_range(const char *range, long size, long *first, long *last) {
+	char *tail;
+	*first = 0;
+	*last = size - 1;
+	if (*range == 0 || strncasecmp(range, "bytes=", 6) || strchr(range, ','))
+		return 0;
+	range += 6;
+	if (*range == '-') {
+		long suffix = strtol(range + 1, &tail, 10);
+		if (tail == range + 1 || suffix <= 0 || size == 0)
+			return -1;
+		*first = suffix < size ? size - suffix : 0;
+		return 1;
+	}
+	long value = strtol(range, &tail, 10);
+	if (tail == range || *tail != '-' || value < 0)
+		return 0;
+	if (tail[1]) {
+		range = tail + 1;
+		long end = strtol(range, &tail, 10);
+		if (tail == range || end < value)
+			return 0;
+		if (end < *last)
+			*last = end;
+	}
+	if (value >= size)
+		return -1;
+	*first = value;
+	return 1;
+}
+
+// Send status line and range related headers, content headers and body are up to caller.
+
+static bool send_content_status(int socket, int range_status, long first, long last, long size) {
+	if (range_status < 0) {
+		indigo_printf(socket, "HTTP/1.1 416 Range Not Satisfiable\r\n");
+		indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+		indigo_printf(socket, "Content-Range: bytes */%ld\r\n", size);
+		indigo_printf(socket, "Content-Length: 0\r\n");
+		indigo_printf(socket, "\r\n");
+		return false;
+	}
+	indigo_printf(socket, range_status ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n");
+	indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+	indigo_printf(socket, "Accept-Ranges: bytes\r\n");
+	if (range_status)
+		indigo_printf(socket, "Content-Range: bytes %ld-%ld/%ld\r\n", first, last, size);
+	return true;
+}
+
+// Send file content without copying it through user space where possible.
+
+static bool send_file(int socket, int handle, long offset, long length) {
+#if defined(INDIGO_LINUX)
+	off_t position = offset;
+	while (length > 0) {
+		ssize_t count = sendfile(socket, handle, &position, length);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return false;
+		length -= count;
+	}
+	return true;
+#elif defined(INDIGO_MACOS)
+	while (length > 0) {
+		off_t count = length;
+		if (sendfile(handle, socket, offset, &count, NULL, 0) < 0 && errno != EINTR && errno != EAGAIN)
+			return false;
+		if (count == 0)
+			return false;
+		offset += count;
+		length -= count;
+	}
+	return true;
+#else
+	char buffer[128 * 1024];
+	if (lseek(handle, offset, SEEK_SET) < 0)
+		return false;
+	while (length > 0) {
+		long count = read(handle, buffer, length < sizeof(buffer) ? length : sizeof(buffer));
+		if (count <= 0 || !indigo_write(socket, buffer, count))
+			return false;
+		length -= count;
+	}
+	return true;
+#endif
+}
+
+// Send BLOB content, large BLOBs are sent with MSG_ZEROCOPY where available. Kernel reads the pages directly
+// from the (immutable) BLOB buffer, so it is necessary to wait for completion notifications before the caller
+// releases the buffer.
+
+static bool send_blob(int socket, const char *data, long length) {
+#if defined(INDIGO_LINUX) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+	int one = 1;
+	if (length < ZEROCOPY_THRESHOLD || setsockopt(socket, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0)
+		return indigo_write(socket, data, length);
+	uint32_t pending = 0;
+	while (length > 0) {
+		ssize_t count = send(socket, data, length, MSG_ZEROCOPY | MSG_NOSIGNAL);
+		if (count < 0 && errno == ENOBUFS)
+			count = send(socket, data, length, MSG_NOSIGNAL);
+		else if (count > 0)
+			pending++;
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return false;
+		data += count;
+		length -= count;
+	}
+	uint32_t completed = 0;
+	while (completed < pending) {
+		struct pollfd pfd = { socket, 0, 0 };
+		if (poll(&pfd, 1, HTTP_TIMEOUT * 1000) <= 0)
+			return false;
+		char control[128];
+		struct msghdr msg = { 0 };
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(socket, &msg, MSG_ERRQUEUE) < 0) {
+			if (errno == EAGAIN || errno == EINTR) {
+				int error = 0;
+				socklen_t size = sizeof(error);
+				if (getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &size) < 0 || error != 0)
+					return false;
+				continue;
+			}
+			return false;
+		}
+		for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			struct sock_extended_err *error = (struct sock_extended_err *)CMSG_DATA(cmsg);
+			if (error->ee_errno == 0 && error->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+				completed += error->ee_data - error->ee_info + 1;
+		}
+	}
+	return true;
+#else
+	return indigo_write(socket, data, length);
+#endif
+}
+
+// HTTP connection with request headers collected so far. On Linux connections are kept in a list, so
+// the ones idle in epoll set for too long can be closed.
+
+typedef struct http_connection {
+	int socket;
+	int length;
+	bool waiting;
+	time_t deadline;
+	struct http_connection *prev;
+	struct http_connection *next;
+	char buffer[HTTP_HEADER_SIZE];
+} http_connection;
+
+#ifdef INDIGO_LINUX
+static http_connection *connections = NULL;
+static pthread_mutex_t connections_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static http_connection *create_connection(int socket) {
+	http_connection *connection = malloc(sizeof(http_connection));
+	assert(connection != NULL);
+	connection->socket = socket;
+	connection->length = 0;
+	connection->waiting = false;
+	connection->deadline = 0;
+	connection->prev = NULL;
+	*connection->buffer = 0;
+#ifdef INDIGO_LINUX
+	pthread_mutex_lock(&connections_mutex);
+	connection->next = connections;
+	if (connections)
+		connections->prev = connection;
+	connections = connection;
+	pthread_mutex_unlock(&connections_mutex);
+#else
+	connection->next = NULL;
+#endif
+	return connection;
+}
+
+// Release connection record, socket is closed or owned by session thread.
+
+static void release_connection(http_connection *connection) {
+#ifdef INDIGO_LINUX
+	pthread_mutex_lock(&connections_mutex);
+	if (connection->prev)
+		connection->prev->next = connection->next;
+	else
+		connections = connection->next;
+	if (connection->next)
+		connection->next->prev = connection->prev;
+	pthread_mutex_unlock(&connections_mutex);
+#endif
+	free(connection);
+}
+
+static void close_connection(int socket) {
+	shutdown(socket, SHUT_RDWR);
+	close(socket);
+	server_callback(__atomic_sub_fetch(&client_count, 1, __ATOMIC_RELAXED));
+}
+
+static void drop_connection(http_connection *connection) {
+	close_connection(connection->socket);
+	release_connection(connection);
+}
+
+#ifdef INDIGO_LINUX
+
+// Wait for (the rest of) next HTTP request in epoll set. Idle keep-alive connection is closed after HTTP_IDLE_TIMEOUT,
+// incomplete request keeps the deadline set by its first bytes.
+
+static void wait_for_request(http_connection *connection, int operation) {
+	struct epoll_event event = { 0 };
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.ptr = connection;
+	pthread_mutex_lock(&connections_mutex);
+	if (connection->length == 0)
+		connection->deadline = time(NULL) + HTTP_IDLE_TIMEOUT;
+	connection->waiting = true;
+	pthread_mutex_unlock(&connections_mutex);
+	if (epoll_ctl(epoll_handle, operation, connection->socket, &event) < 0) {
+		indigo_error("Can't add connection to epoll set (%s)", strerror(errno));
+		pthread_mutex_lock(&connections_mutex);
+		connection->waiting = false;
+		pthread_mutex_unlock(&connections_mutex);
+		drop_connection(connection);
+	}
+}
+
+static void stop_waiting(http_connection *connection) {
+	pthread_mutex_lock(&connections_mutex);
+	connection->waiting = false;
+	pthread_mutex_unlock(&connections_mutex);
+}
+
+// Waiting connections past their deadline are shut down, worker then gets the event and closes them.
+
+static void idle_connection_thread(void *data) {
+	while (true) {
+		sleep(1);
+		time_t now = time(NULL);
+		pthread_mutex_lock(&connections_mutex);
+		for (http_connection *connection = connections; connection; connection = connection->next) {
+			if (connection->waiting && connection->deadline <= now) {
+				INDIGO_LOG(indigo_log("%s connection timed out socket = %d", connection->length ? "Incomplete request," : "Idle", connection->socket));
+				connection->waiting = false;
+				shutdown(connection->socket, SHUT_RDWR);
+			}
+		}
+		pthread_mutex_unlock(&connections_mutex);
+	}
+}
+
+#endif
+
+// Find end of request headers (empty line), returns NULL if headers are not complete yet.
+
+static char *find_request_end(char *buffer) {
+	for (char *line = strchr(buffer, '\n'); line; line = strchr(line + 1, '\n')) {
+		if (line[1] == '\n')
+			return line + 2;
+		if (line[1] == '\r' && line[2] == '\n')
+			return line + 3;
+	}
+	return NULL;
+}
+
+// Return next header line without line terminator.
+
+static char *next_line(char **cursor) {
+	char *line = *cursor;
+	char *end = strchr(line, '\n');
+	if (end == NULL) {
+		*cursor = line + strlen(line);
+	} else {
+		*end = 0;
+		*cursor = end + 1;
+		if (end > line && end[-1] == '\r')
+			end[-1] = 0;
+	}
+	return line;
+}
+
+// Read available part of request headers, returns 1 if headers are complete, 0 if more data is needed (only with MSG_DONTWAIT)
+// and -1 if connection should be closed.
+
+static int read_request(http_connection *connection, int flags) {
+	while (find_request_end(connection->buffer) == NULL) {
+		int space = sizeof(connection->buffer) - 1 - connection->length;
+		if (space == 0) {
+			INDIGO_LOG(indigo_log("Request headers too long"));
+			return -1;
+		}
+		ssize_t count = recv(connection->socket, connection->buffer + connection->length, space, flags);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count < 0 && (flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return 0;
+		if (count <= 0)
+			return -1;
+		if (connection->length == 0)
+			connection->deadline = time(NULL) + HTTP_TIMEOUT;
+		connection->length += count;
+		connection->buffer[connection->length] = 0;
+	}
+	return 1;
+}
+
+typedef struct {
+	int socket;
+	http_connection *connection;
+	bool keep_alive;
+	indigo_blob_buffer *buffer;
+	const char *data;
+	int handle;
+	long offset;
+	long length;
+	char request[BUFFER_SIZE];
+} transfer_data;
+
+// Send response body from BLOB or file and release it, returns true if connection can be kept alive.
+
+static bool send_body(transfer_data *transfer) {
+	bool result;
+	if (transfer->handle >= 0)
+		result = send_file(transfer->socket, transfer->handle, transfer->offset, transfer->length);
+	else
+		result = send_blob(transfer->socket, transfer->data + transfer->offset, transfer->length);
+	if (result) {
+		INDIGO_LOG(indigo_log("%s -> OK (%ld bytes)", transfer->request, transfer->length));
+	} else {
+		INDIGO_LOG(indigo_log("%s -> Failed (%s)", transfer->request, strerror(errno)));
+	}
+	if (transfer->handle >= 0)
+		close(transfer->handle);
+	if (transfer->buffer != NULL)
+		indigo_release_blob_buffer(transfer->buffer);
+	return result && transfer->keep_alive;
+}
+
+static bool serve_connection(http_connection *connection, int flags);
+
+#ifdef INDIGO_LINUX
+
+// Large bodies are sent from their own thread, so slow clients can't occupy the epoll workers.
+
+static void transfer_thread(transfer_data *transfer) {
+	http_connection *connection = transfer->connection;
+	bool keep_alive = send_body(transfer);
+	free(transfer);
+	if (!keep_alive)
+		drop_connection(connection);
+	else if (serve_connection(connection, MSG_DONTWAIT))
+		wait_for_request(connection, EPOLL_CTL_MOD);
+}
+
+#endif
+
+// Send response body, returns the same values as handle_http_request().
+
+static int start_transfer(transfer_data *transfer) {
+#ifdef INDIGO_LINUX
+	if (transfer->length >= TRANSFER_THRESHOLD) {
+		transfer_data *copy = malloc(sizeof(transfer_data));
+		assert(copy != NULL);
+		*copy = *transfer;
+		if (indigo_async((void *(*)(void *))&transfer_thread, copy))
+			return 0;
+		indigo_error("Can't create transfer thread for connection (%s)", strerror(errno));
+		free(copy);
+	}
+#endif
+	return send_body(transfer) ? 1 : -1;
+}
+
+typedef struct {
+	int socket;
+	bool web_socket;
+} session_data;
+
+// XML, JSON and JSON-over-WebSocket sessions run blocking protocol parsers, so each of them gets its own thread.
+
+static void session_thread(session_data *session) {
+	int socket = session->socket;
+	bool web_socket = session->web_socket;
+	free(session);
+	INDIGO_LOG(indigo_log("Session thread started socket = %d", socket));
+	char c = '{';
+	if (!web_socket && recv(socket, &c, 1, MSG_PEEK) != 1)
+		c = 0;
+	if (c == '<') {
+		INDIGO_LOG(indigo_log("Protocol switched to XML"));
+		indigo_client *protocol_adapter = indigo_xml_device_adapter(socket, socket);
+		assert(protocol_adapter != NULL);
+		indigo_attach_client(protocol_adapter);
+		indigo_xml_parse(NULL, protocol_adapter);
+		indigo_detach_client(protocol_adapter);
+		indigo_release_xml_device_adapter(protocol_adapter);
+		close_connection(socket);
+	} else if (c == '{') {
+		if (!web_socket)
 			INDIGO_LOG(indigo_log("Protocol switched to JSON"));
-			indigo_client *protocol_adapter = indigo_json_device_adapter(socket, socket, false);
-			assert(protocol_adapter != NULL);
-			indigo_attach_client(protocol_adapter);
-			indigo_json_parse(NULL, protocol_adapter);
-			indigo_detach_client(protocol_adapter);
-			indigo_release_json_device_adapter(protocol_adapter);
-		} else if (c == 'G') {
-			char request[BUFFER_SIZE];
-			char header[BUFFER_SIZE];
-			while ((res = indigo_read_line(socket, request, BUFFER_SIZE)) >= 0) {
-				bool keep_alive = false;
-				if (!strncmp(request, "GET /", 5)) {
-					char *path = request + 4;
-					char *space = strchr(path, ' ');
-					if (space)
-						*space = 0;
-					char *param = strchr(path, '?');
-					if (param)
-						*param = 0;
-					char websocket_key[256] = "";
-					while (indigo_read_line(socket, header, BUFFER_SIZE) > 0) {
-						if (!strncasecmp(header, "Sec-WebSocket-Key: ", 19))
-							strncpy(websocket_key, header + 19, sizeof(websocket_key));
-						if (!strcasecmp(header, "Connection: keep-alive"))
-							keep_alive = true;
-					}
-					if (!strcmp(path, "/")) {
-						if (*websocket_key) {
-							unsigned char shaHash[SHA1_SIZE];
-							memset(shaHash, 0, sizeof(shaHash));
-							strcat(websocket_key, "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
-							sha1(shaHash, websocket_key, strlen(websocket_key));
-							indigo_printf(socket, "HTTP/1.1 101 Switching Protocols\r\n");
-							indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-							indigo_printf(socket, "Upgrade: websocket\r\n");
-							indigo_printf(socket, "Connection: upgrade\r\n");
-							base64_encode((unsigned char *)websocket_key, shaHash, 20);
-							indigo_printf(socket, "Sec-WebSocket-Accept: %s\r\n", websocket_key);
-							indigo_printf(socket, "\r\n");
-							INDIGO_LOG(indigo_log("Protocol switched to JSON-over-WebSockets"));
-							indigo_client *protocol_adapter = indigo_json_device_adapter(socket, socket, true);
-							assert(protocol_adapter != NULL);
-							indigo_attach_client(protocol_adapter);
-							indigo_json_parse(NULL, protocol_adapter);
-							indigo_detach_client(protocol_adapter);
-						} else {
-							indigo_printf(socket, "HTTP/1.1 301 OK\r\n");
-							indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-							indigo_printf(socket, "Location: /mng.html\r\n");
-							indigo_printf(socket, "Content-type: text/html\r\n");
-							indigo_printf(socket, "\r\n");
-							indigo_printf(socket, "<a href='/mng.html'>INDIGO Server Manager</a>");
-						}
-						keep_alive = false;
-					} else if (!strncmp(path, "/blob/", 6)) {
-						indigo_item *item;
-						indigo_blob_entry *entry;
-						if (sscanf(path, "/blob/%p.", &item) && (entry = indigo_validate_blob(item))) {
-							indigo_printf(socket, "HTTP/1.1 200 OK\r\n");
-							indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-							if (!strcmp(entry->format, ".jpeg")) {
-								indigo_printf(socket, "Content-Type: image/jpeg\r\n");
-							} else {
-								indigo_printf(socket, "Content-Type: application/octet-stream\r\n");
-								indigo_printf(socket, "Content-Disposition: attachment; filename=\"%p%s\"\r\n", item, entry->format);
-							}
-							if (keep_alive)
-								indigo_printf(socket, "Connection: keep-alive\r\n");
-							indigo_printf(socket, "Content-Length: %ld\r\n", entry->size);
-							indigo_printf(socket, "\r\n");
-							pthread_mutex_lock(&entry->mutext);
-							if (indigo_write(socket, entry->content, entry->size)) {
-								INDIGO_LOG(indigo_log("%s -> OK (%ld bytes)", request, entry->size));
-							} else {
-								INDIGO_LOG(indigo_log("%s -> Failed (%s)", request, strerror(errno)));
-								keep_alive = false;
-							}
-							pthread_mutex_unlock(&entry->mutext);
-						} else {
-							indigo_printf(socket, "HTTP/1.1 404 Not found\r\n");
-							indigo_printf(socket, "Content-Type: text/plain\r\n");
-							indigo_printf(socket, "\r\n");
-							indigo_printf(socket, "BLOB not found!\r\n");
-							shutdown(socket,SHUT_RDWR);
-							indigo_usleep(ONE_SECOND_DELAY);
-							close(socket);
-							INDIGO_LOG(indigo_log("%s -> Failed", request));
-							keep_alive = false;
-						}
+		indigo_client *protocol_adapter = indigo_json_device_adapter(socket, socket, web_socket);
+		assert(protocol_adapter != NULL);
+		indigo_attach_client(protocol_adapter);
+		indigo_json_parse(NULL, protocol_adapter);
+		indigo_detach_client(protocol_adapter); // JSON adapter closes socket on detach
+		indigo_release_json_device_adapter(protocol_adapter);
+		server_callback(__atomic_sub_fetch(&client_count, 1, __ATOMIC_RELAXED));
+	} else {
+		close_connection(socket);
+	}
+	INDIGO_LOG(indigo_log("Session thread finished"));
+}
+
+static void start_session(http_connection *connection, bool web_socket) {
+	int socket = connection->socket;
+#ifdef INDIGO_LINUX
+	epoll_ctl(epoll_handle, EPOLL_CTL_DEL, socket, NULL);
+#endif
+	release_connection(connection);
+	struct timeval timeout = { 0 };
+	setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+	session_data *session = malloc(sizeof(session_data));
+	assert(session != NULL);
+	session->socket = socket;
+	session->web_socket = web_socket;
+	if (!indigo_async((void *(*)(void *))&session_thread, session)) {
+		indigo_error("Can't create session thread for connection (%s)", strerror(errno));
+		free(session);
+		close_connection(socket);
+	}
+}
+
+// Handle single HTTP request with complete headers, returns 1 if connection is kept alive, 0 if it was handed over to session
+// or transfer thread and -1 if it should be closed.
+
+static int handle_http_request(http_connection *connection, char *headers) {
+	int socket = connection->socket;
+	char *request = next_line(&headers);
+	char *header;
+	bool keep_alive = false;
+	if (!strncmp(request, "GET /", 5)) {
+		char *path = request + 4;
+		char *space = strchr(path, ' ');
+		if (space)
+			*space = 0;
+		char *param = strchr(path, '?');
+		if (param)
+			*param = 0;
+		char websocket_key[256] = "";
+		char range[64] = "";
+		while (*(header = next_line(&headers))) {
+			if (!strncasecmp(header, "Sec-WebSocket-Key: ", 19))
+				snprintf(websocket_key, sizeof(websocket_key) - 36, "%s", header + 19);
+			// too long range is not supported, whole content is sent
+			if (!strncasecmp(header, "Range: ", 7) && snprintf(range, sizeof(range), "%s", header + 7) >= (int)sizeof(range))
+				*range = 0;
+			if (!strcasecmp(header, "Connection: keep-alive"))
+				keep_alive = true;
+		}
+		if (!strcmp(path, "/")) {
+			if (*websocket_key) {
+				unsigned char shaHash[SHA1_SIZE];
+				memset(shaHash, 0, sizeof(shaHash));
+				strcat(websocket_key, "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+				sha1(shaHash, websocket_key, strlen(websocket_key));
+				indigo_printf(socket, "HTTP/1.1 101 Switching Protocols\r\n");
+				indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+				indigo_printf(socket, "Upgrade: websocket\r\n");
+				indigo_printf(socket, "Connection: upgrade\r\n");
+				base64_encode((unsigned char *)websocket_key, shaHash, 20);
+				indigo_printf(socket, "Sec-WebSocket-Accept: %s\r\n", websocket_key);
+				indigo_printf(socket, "\r\n");
+				INDIGO_LOG(indigo_log("Protocol switched to JSON-over-WebSockets"));
+				start_session(connection, true);
+				return 0;
+			} else {
+				indigo_printf(socket, "HTTP/1.1 301 OK\r\n");
+				indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+				indigo_printf(socket, "Location: /mng.html\r\n");
+				indigo_printf(socket, "Content-type: text/html\r\n");
+				indigo_printf(socket, "\r\n");
+				indigo_printf(socket, "<a href='/mng.html'>INDIGO Server Manager</a>");
+			}
+			keep_alive = false;
+		} else if (!strncmp(path, "/blob/", 6)) {
+			indigo_item *item;
+			indigo_blob_entry entry;
+			if (sscanf(path, "/blob/%p.", &item) && indigo_retain_blob(item, &entry)) {
+				long first, last;
+				int range_status = parse_range(range, entry.size, &first, &last);
+				if (send_content_status(socket, range_status, first, last, entry.size)) {
+					if (!strcmp(entry.format, ".jpeg")) {
+						indigo_printf(socket, "Content-Type: image/jpeg\r\n");
 					} else {
-						struct resource *resource = resources;
-						do {
-							if (!strcmp(resource->path, path))
-								break;
-						} while ((resource = resource->next) != NULL);
-						if (resource == NULL) {
-							indigo_printf(socket, "HTTP/1.1 404 Not found\r\n");
-							indigo_printf(socket, "Content-Type: text/plain\r\n");
-							indigo_printf(socket, "\r\n");
-							indigo_printf(socket, "%s not found!\r\n", path);
-							INDIGO_LOG(indigo_log("%s -> Failed", request));
-							keep_alive = false;
-						} else if (resource->data) {
-							indigo_printf(socket, "HTTP/1.1 200 OK\r\n");
-							indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-							indigo_printf(socket, "Content-Type: %s\r\n", resource->content_type);
-							indigo_printf(socket, "Content-Length: %d\r\n", resource->length);
-							indigo_printf(socket, "Content-Encoding: gzip\r\n");
-							indigo_printf(socket, "\r\n");
-							indigo_write(socket, (const char *)resource->data, resource->length);
-							INDIGO_LOG(indigo_log("%s -> OK (%d bytes)", request, resource->length));
-						} else if (resource->file_name) {
-							char file_name[256];
-							struct stat file_stat;
-							int handle;
-							sprintf(file_name, "%s/%s", getenv("HOME"), resource->file_name);
-							if (stat(file_name, &file_stat) < 0 || (handle = open(file_name, O_RDONLY)) < 0) {
-								indigo_printf(socket, "HTTP/1.1 404 Not found\r\n");
-								indigo_printf(socket, "Content-Type: text/plain\r\n");
-								indigo_printf(socket, "\r\n");
-								indigo_printf(socket, "%s not found (%s)\r\n", file_name, strerror(errno));
-								INDIGO_LOG(indigo_log("%s -> Failed to stat/open file (%s, %s)", request, file_name, strerror(errno)));
-								keep_alive = false;
-							} else {
-								indigo_printf(socket, "HTTP/1.1 200 OK\r\n");
-								indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-								indigo_printf(socket, "Content-Type: %s\r\n", resource->content_type);
-								indigo_printf(socket, "Content-Length: %d\r\n", file_stat.st_size);
-								indigo_printf(socket, "\r\n");
-								long remaining = file_stat.st_size;
-								char buffer[128 * 1024];
-								while (remaining > 0) {
-									long count = read(handle, buffer, remaining < sizeof(buffer) ? remaining : sizeof(buffer));
-									if (count < 0) {
-										INDIGO_LOG(indigo_log("%s -> Failed to read file (%s)", request, strerror(errno)));
-										break;
-									}
-									if (indigo_write(socket, buffer, count)) {
-										INDIGO_LOG(indigo_log("%s -> OK (%ld bytes)", request, count));
-									} else {
-										INDIGO_LOG(indigo_log("%s -> Failed (%s)", request, strerror(errno)));
-										keep_alive = false;
-										break;
-									}
-									remaining -= count;
-								}
-								close(handle);
-							}
-						}
+						indigo_printf(socket, "Content-Type: application/octet-stream\r\n");
+						indigo_printf(socket, "Content-Disposition: attachment; filename=\"%p%s\"\r\n", item, entry.format);
 					}
+					if (keep_alive)
+						indigo_printf(socket, "Connection: keep-alive\r\n");
+					indigo_printf(socket, "Content-Length: %ld\r\n", last - first + 1);
+					indigo_printf(socket, "\r\n");
+					transfer_data transfer = { .socket = socket, .connection = connection, .keep_alive = keep_alive, .buffer = entry.buffer, .data = entry.content, .handle = -1, .offset = first, .length = last - first + 1 };
+					snprintf(transfer.request, sizeof(transfer.request), "%s", request);
+					return start_transfer(&transfer);
+				} else {
+					INDIGO_LOG(indigo_log("%s -> Range not satisfiable (%s)", request, range));
 				}
-				if (!keep_alive) {
+				indigo_release_blob_buffer(entry.buffer);
+			} else {
+				indigo_printf(socket, "HTTP/1.1 404 Not found\r\n");
+				indigo_printf(socket, "Content-Type: text/plain\r\n");
+				indigo_printf(socket, "\r\n");
+				indigo_printf(socket, "BLOB not found!\r\n");
+				INDIGO_LOG(indigo_log("%s -> Failed", request));
+				keep_alive = false;
+			}
+		} else {
+			struct resource *resource = resources;
+			do {
+				if (!strcmp(resource->path, path))
 					break;
+			} while ((resource = resource->next) != NULL);
+			if (resource == NULL) {
+				indigo_printf(socket, "HTTP/1.1 404 Not found\r\n");
+				indigo_printf(socket, "Content-Type: text/plain\r\n");
+				indigo_printf(socket, "\r\n");
+				indigo_printf(socket, "%s not found!\r\n", path);
+				INDIGO_LOG(indigo_log("%s -> Failed", request));
+				keep_alive = false;
+			} else if (resource->data) {
+				indigo_printf(socket, "HTTP/1.1 200 OK\r\n");
+				indigo_printf(socket, "Server: INDIGO/%d.%d-%s\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+				indigo_printf(socket, "Content-Type: %s\r\n", resource->content_type);
+				indigo_printf(socket, "Content-Length: %d\r\n", resource->length);
+				indigo_printf(socket, "Content-Encoding: gzip\r\n");
+				indigo_printf(socket, "\r\n");
+				indigo_write(socket, (const char *)resource->data, resource->length);
+				INDIGO_LOG(indigo_log("%s -> OK (%d bytes)", request, resource->length));
+			} else if (resource->file_name) {
+				char file_name[256];
+				struct stat file_stat;
+				int handle;
+				sprintf(file_name, "%s/%s", getenv("HOME"), resource->file_name);
+				if (stat(file_name, &file_stat) < 0 || (handle = open(file_name, O_RDONLY)) < 0) {
+					indigo_printf(socket, "HTTP/1.1 404 Not found\r\n");
+					indigo_printf(socket, "Content-Type: text/plain\r\n");
+					indigo_printf(socket, "\r\n");
+					indigo_printf(socket, "%s not found (%s)\r\n", file_name, strerror(errno));
+					INDIGO_LOG(indigo_log("%s -> Failed to stat/open file (%s, %s)", request, file_name, strerror(errno)));
+					keep_alive = false;
+				} else {
+					long first, last;
+					int range_status = parse_range(range, file_stat.st_size, &first, &last);
+					if (send_content_status(socket, range_status, first, last, file_stat.st_size)) {
+						indigo_printf(socket, "Content-Type: %s\r\n", resource->content_type);
+						indigo_printf(socket, "Content-Length: %ld\r\n", last - first + 1);
+						indigo_printf(socket, "\r\n");
+						transfer_data transfer = { .socket = socket, .connection = connection, .keep_alive = keep_alive, .handle = handle, .offset = first, .length = last - first + 1 };
+						snprintf(transfer.request, sizeof(transfer.request), "%s", request);
+						return start_transfer(&transfer);
+					} else {
+						INDIGO_LOG(indigo_log("%s -> Range not satisfiable (%s)", request, range));
+					}
+					close(handle);
 				}
 			}
-		} else {
+		}
+	}
+	return keep_alive ? 1 : -1;
+}
+
+// Serve requests available on new or idle keep-alive connection, returns true if connection should wait for more data.
+
+static bool serve_connection(http_connection *connection, int flags) {
+	char headers[HTTP_HEADER_SIZE];
+	while (true) {
+		char c = *connection->buffer;
+		if (connection->length == 0) {
+			ssize_t count = recv(connection->socket, &c, 1, MSG_PEEK | flags);
+			if (count < 0 && (flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK))
+				return true;
+			if (count != 1)
+				break;
+			if (c == '<' || c == '{') {
+				start_session(connection, false);
+				return false;
+			}
+		}
+		if (c != 'G') {
 			INDIGO_LOG(indigo_log("Unrecognised protocol"));
+			break;
 		}
+		int result = read_request(connection, flags);
+		if (result == 0)
+			return true;
+		if (result < 0)
+			break;
+		// request is consumed before it is handled, so transfer thread can continue with pipelined one
+		int length = (int)(find_request_end(connection->buffer) - connection->buffer);
+		memcpy(headers, connection->buffer, length);
+		headers[length] = 0;
+		connection->length -= length;
+		memmove(connection->buffer, connection->buffer + length, connection->length + 1);
+		if (connection->length)
+			connection->deadline = time(NULL) + HTTP_TIMEOUT;
+		result = handle_http_request(connection, headers);
+		if (result == 0)
+			return false;
+		if (result < 0)
+			break;
 	}
-	shutdown(socket, SHUT_RDWR);
-	//indigo_usleep(ONE_SECOND_DELAY); // ???
-	close(socket);
-	server_callback(--client_count);
+	drop_connection(connection);
+	return false;
+}
+
+#ifdef INDIGO_LINUX
+
+// Connections wait for data in epoll set instead of blocked threads. Events are one shot, so only one worker
+// gets the connection. Request headers are read without blocking and collected until complete, so a slow client
+// can't occupy the small pool of workers. Keep-alive connections are re-armed after response. XML and JSON
+// sessions are moved to their own threads.
+
+static void epoll_worker_thread(void *data) {
+	struct epoll_event event;
+	while (true) {
+		int count = epoll_wait(epoll_handle, &event, 1, -1);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			indigo_error("epoll_wait() failed (%s)", strerror(errno));
+			break;
+		}
+		if (count == 1) {
+			http_connection *connection = event.data.ptr;
+			stop_waiting(connection);
+			if (serve_connection(connection, MSG_DONTWAIT))
+				wait_for_request(connection, EPOLL_CTL_MOD);
+		}
+	}
+}
+
+#else
+
+static void connection_thread(int *client_socket) {
+	http_connection *connection = create_connection(*client_socket);
 	free(client_socket);
-	INDIGO_LOG(indigo_log("Worker thread finished"));
+	serve_connection(connection, 0);
 }
 
+#endif
+
 void indigo_server_shutdown() {
 	if (!shutdown_initiated) {
 		shutdown_initiated = true;
@@ -363,7 +860,7 @@ indigo_result indigo_server_start(indigo_server_tcp_callback callback) {
 		close(server_socket);
 		return INDIGO_CANT_START_SERVER;
 	}
-	if (listen(server_socket, 64) < 0) {
+	if (listen(server_socket, SOMAXCONN) < 0) {
 		indigo_error("Can't listen on server socket (%s)", strerror(errno));
 		close(server_socket);
 		return INDIGO_CANT_START_SERVER;
@@ -373,6 +870,21 @@ indigo_result indigo_server_start(indigo_server_tcp_callback callback) {
 	INDIGO_LOG(indigo_log("Server started on %d", indigo_server_tcp_port));
 	server_callback(client_count);
 	signal(SIGPIPE, SIG_IGN);
+#ifdef INDIGO_LINUX
+	if (epoll_handle == -1) {
+		if ((epoll_handle = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+			indigo_error("Can't create epoll instance (%s)", strerror(errno));
+			close(server_socket);
+			return INDIGO_CANT_START_SERVER;
+		}
+		for (int i = 0; i < HTTP_WORKER_COUNT; i++) {
+			if (!indigo_async((void *(*)(void *))&epoll_worker_thread, NULL))
+				indigo_error("Can't create worker thread (%s)", strerror(errno));
+		}
+		if (!indigo_async((void *(*)(void *))&idle_connection_thread, NULL))
+			indigo_error("Can't create idle connection thread (%s)", strerror(errno));
+	}
+#endif
 	while (1) {
 		client_socket = accept(server_socket, (struct sockaddr *)&client_name, &name_len);
 		if (client_socket == -1) {
@@ -380,10 +892,23 @@ indigo_result indigo_server_start(indigo_server_tcp_callback callback) {
 				break;
 			indigo_error("Can't accept connection (%s)", strerror(errno));
 		} else {
+			INDIGO_LOG(indigo_log("Connection accepted socket = %d", client_socket));
+			server_callback(__atomic_add_fetch(&client_count, 1, __ATOMIC_RELAXED));
+			struct timeval timeout = { HTTP_TIMEOUT, 0 };
+			setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+			// stalled HTTP client fails the transfer instead of blocking the thread forever
+			setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef INDIGO_LINUX
+			wait_for_request(create_connection(client_socket), EPOLL_CTL_ADD);
+#else
 			int *pointer = malloc(sizeof(int));
 			*pointer = client_socket;
-			if (!indigo_async((void *(*)(void *))&start_worker_thread, pointer))
+			if (!indigo_async((void *(*)(void *))&connection_thread, pointer)) {
 				indigo_error("Can't create worker thread for connection (%s)", strerror(errno));
+				free(pointer);
+				close_connection(client_socket);
+			}
+#endif
 		}
 	}
 	shutdown_initiated = false;
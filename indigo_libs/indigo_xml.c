@@ -54,7 +54,7 @@
 
 #define BUFFER_SIZE 524288  /* BUFFER_SIZE % 4 == 0, inportant for base64 */
 
-#define PROPERTY_SIZE sizeof(indigo_property)+INDIGO_MAX_ITEMS*(sizeof(indigo_item))
+#define PROPERTY_CAPACITY 16
 
 typedef enum PARSE_STATES {
 	ERROR,
@@ -126,17 +126,32 @@ static indigo_rule parse_rule(char *value) {
 }
 
 typedef struct {
-	char property_buffer[PROPERTY_SIZE];
+	indigo_property *property;
+	int capacity;
 	indigo_device *device;
 	indigo_client *client;
 	int count;
 	indigo_property **properties;
+	bool binary_blob;
 } parser_context;
 
 bool indigo_use_blob_urls = true;
 
 typedef void *(* parser_handler)(parser_state state, parser_context *context, char *name, char *value, char *message);
 
+// property buffer grows with item count up to INDIGO_MAX_ITEMS, handlers must not use property pointer after adding an item
+static indigo_item *add_item(parser_context *context) {
+	indigo_property *property = context->property;
+	if (property->count == context->capacity) {
+		context->capacity = context->capacity * 2 < INDIGO_MAX_ITEMS ? context->capacity * 2 : INDIGO_MAX_ITEMS;
+		property = context->property = realloc(property, sizeof(indigo_property) + context->capacity * sizeof(indigo_item));
+		assert(property != NULL);
+	}
+	indigo_item *item = property->items + property->count++;
+	memset(item, 0, sizeof(indigo_item));
+	return item;
+}
+
 static void *top_level_handler(parser_state state, parser_context *context, char *name, char *value, char *message);
 static void *new_text_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message);
 static void *new_number_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message);
@@ -153,7 +168,7 @@ static void *set_light_vector_handler(parser_state state, parser_context *contex
 static void *set_blob_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message);
 
 static void *enable_blob_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_client *client = context->client;
 	assert(client != NULL);
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: enable_blob_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
@@ -188,6 +203,8 @@ static void *enable_blob_handler(parser_state state, parser_context *context, ch
 			strncpy(record->name, property->name, INDIGO_NAME_SIZE);
 			if (!strcmp(value, "URL"))
 				record->mode = INDIGO_ENABLE_BLOB_URL;
+			else if (!strcmp(value, "Binary"))
+				record->mode = INDIGO_ENABLE_BLOB_BINARY;
 			else
 				record->mode = INDIGO_ENABLE_BLOB_ALSO;
 			record->next = client->enable_blob_mode_records;
@@ -197,14 +214,14 @@ static void *enable_blob_handler(parser_state state, parser_context *context, ch
 			indigo_enable_blob(client, property, INDIGO_ENABLE_BLOB_NEVER);
 		}
 	} else if (state == END_TAG) {
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return enable_blob_handler;
 }
 
 static void *get_properties_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_client *client = context->client;
 	assert(client != NULL);
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: get_properties_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
@@ -224,8 +241,14 @@ static void *get_properties_handler(parser_state state, parser_context *context,
 				version = INDIGO_VERSION_2_0;
 			if (version > client->version) {
 				assert(client->client_context != NULL);
-				int handle = ((indigo_adapter_context *)(client->client_context))->output;
-				indigo_printf(handle, "<switchProtocol version='%d.%d'/>\n", (version >> 8) & 0xFF, version & 0xFF);
+				indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+				if (client_context->output_queue) {
+					indigo_message message = { 0 };
+					indigo_message_printf(&message, "<switchProtocol version='%d.%d'/>\n", (version >> 8) & 0xFF, version & 0xFF);
+					indigo_queue_message(client_context->output_queue, NULL, INDIGO_QUEUE_KEEP, &message);
+				} else {
+					indigo_printf(client_context->output, "<switchProtocol version='%d.%d'/>\n", (version >> 8) & 0xFF, version & 0xFF);
+				}
 				client->version = version;
 			}
 		} else if (!strncmp(name, "device",INDIGO_NAME_SIZE)) {
@@ -235,14 +258,14 @@ static void *get_properties_handler(parser_state state, parser_context *context,
 		}
 	} else if (state == END_TAG) {
 		indigo_enumerate_properties(client, property);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return get_properties_handler;
 }
 
 static void *new_one_text_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_client *client = context->client;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: new_one_text_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -258,13 +281,13 @@ static void *new_one_text_vector_handler(parser_state state, parser_context *con
 }
 
 static void *new_text_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_client *client = context->client;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: new_text_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "oneText")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return new_one_text_vector_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -277,14 +300,14 @@ static void *new_text_vector_handler(parser_state state, parser_context *context
 		}
 	} else if (state == END_TAG) {
 		indigo_change_property(client, property);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return new_text_vector_handler;
 }
 
 static void *new_one_number_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_client *client = context->client;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: new_one_number_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -300,13 +323,13 @@ static void *new_one_number_vector_handler(parser_state state, parser_context *c
 }
 
 static void *new_number_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_client *client = context->client;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: new_number_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "oneNumber")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return new_one_number_vector_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -319,14 +342,14 @@ static void *new_number_vector_handler(parser_state state, parser_context *conte
 		}
 	} else if (state == END_TAG) {
 		indigo_change_property(client, property);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return new_number_vector_handler;
 }
 
 static void *new_one_switch_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_client *client = context->client;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: new_one_switch_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -342,13 +365,13 @@ static void *new_one_switch_vector_handler(parser_state state, parser_context *c
 }
 
 static void *new_switch_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_client *client = context->client;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: new_switch_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "oneSwitch")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return new_one_switch_vector_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -362,7 +385,7 @@ static void *new_switch_vector_handler(parser_state state, parser_context *conte
 		return new_switch_vector_handler;
 	} else if (state == END_TAG) {
 		indigo_change_property(client, property);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return new_switch_vector_handler;
@@ -452,7 +475,7 @@ static void set_property(parser_context *context, indigo_property *other, char *
 }
 
 static void *set_one_text_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_one_text_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -468,13 +491,13 @@ static void *set_one_text_vector_handler(parser_state state, parser_context *con
 }
 
 static void *set_text_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_text_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "oneText")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return set_one_text_vector_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -492,14 +515,14 @@ static void *set_text_vector_handler(parser_state state, parser_context *context
 		}
 	} else if (state == END_TAG) {
 		set_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return set_text_vector_handler;
 }
 
 static void *set_one_number_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_one_number_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -525,16 +548,16 @@ static void *set_one_number_vector_handler(parser_state state, parser_context *c
 }
 
 static void *set_number_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_number_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "oneNumber")) {
 			if (property->count < INDIGO_MAX_ITEMS) {
-				property->items[property->count].number.min = NAN;
-				property->items[property->count].number.max = NAN;
-				property->items[property->count].number.step = NAN;
-				property->count++;
+				indigo_item *item = add_item(context);
+				item->number.min = NAN;
+				item->number.max = NAN;
+				item->number.step = NAN;
 			}
 			return set_one_number_vector_handler;
 		}
@@ -553,14 +576,14 @@ static void *set_number_vector_handler(parser_state state, parser_context *conte
 		}
 	} else if (state == END_TAG) {
 		set_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return set_number_vector_handler;
 }
 
 static void *set_one_switch_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_one_switch_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -576,13 +599,13 @@ static void *set_one_switch_vector_handler(parser_state state, parser_context *c
 }
 
 static void *set_switch_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_switch_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "oneSwitch")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return set_one_switch_vector_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -600,14 +623,14 @@ static void *set_switch_vector_handler(parser_state state, parser_context *conte
 		}
 	} else if (state == END_TAG) {
 		set_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return set_switch_vector_handler;
 }
 
 static void *set_one_light_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_one_light_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -623,13 +646,13 @@ static void *set_one_light_vector_handler(parser_state state, parser_context *co
 }
 
 static void *set_light_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_light_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "oneLight")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return set_one_light_vector_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -647,14 +670,14 @@ static void *set_light_vector_handler(parser_state state, parser_context *contex
 		}
 	} else if (state == END_TAG) {
 		set_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return set_light_vector_handler;
 }
 
 static void *set_one_blob_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_DEBUG_PROTOCOL(if (state == BLOB))
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_one_blob_vector_handler %s '%s' DATA", parser_state_name[state], name != NULL ? name : ""));
@@ -671,6 +694,8 @@ static void *set_one_blob_vector_handler(parser_state state, parser_context *con
 			snprintf(property->items[property->count-1].blob.url, INDIGO_VALUE_SIZE, "%s%s", ((indigo_adapter_context *)context->device->device_context)->url_prefix, value);
 		} else if (!strcmp(name, "url")) {
 			strncpy(property->items[property->count-1].blob.url, value, INDIGO_VALUE_SIZE);
+		} else if (!strcmp(name, "encoding")) {
+			context->binary_blob = !strcmp(value, "binary");
 		}
 	} else if (state == BLOB) {
 		property->items[property->count-1].blob.value = value;
@@ -681,13 +706,13 @@ static void *set_one_blob_vector_handler(parser_state state, parser_context *con
 }
 
 static void *set_blob_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: set_blob_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "oneBLOB")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return set_one_blob_vector_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -705,7 +730,7 @@ static void *set_blob_vector_handler(parser_state state, parser_context *context
 		}
 	} else if (state == END_TAG) {
 		set_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return set_blob_vector_handler;
@@ -765,7 +790,7 @@ static void def_property(parser_context *context, indigo_property *other, char *
 }
 
 static void *def_text_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_text_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -785,13 +810,13 @@ static void *def_text_handler(parser_state state, parser_context *context, char
 }
 
 static void *def_text_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_text_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "defText")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return def_text_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -817,14 +842,14 @@ static void *def_text_vector_handler(parser_state state, parser_context *context
 		}
 	} else if (state == END_TAG) {
 		def_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return def_text_vector_handler;
 }
 
 static void *def_number_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_number_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -854,13 +879,13 @@ static void *def_number_handler(parser_state state, parser_context *context, cha
 }
 
 static void *def_number_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_number_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "defNumber")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return def_number_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -886,14 +911,14 @@ static void *def_number_vector_handler(parser_state state, parser_context *conte
 		}
 	} else if (state == END_TAG) {
 		def_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return def_number_vector_handler;
 }
 
 static void *def_switch_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_switch_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -913,13 +938,13 @@ static void *def_switch_handler(parser_state state, parser_context *context, cha
 }
 
 static void *def_switch_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_switch_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "defSwitch")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return def_switch_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -947,14 +972,14 @@ static void *def_switch_vector_handler(parser_state state, parser_context *conte
 		}
 	} else if (state == END_TAG) {
 		def_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return def_switch_vector_handler;
 }
 
 static void *def_light_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_light_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -974,13 +999,13 @@ static void *def_light_handler(parser_state state, parser_context *context, char
 }
 
 static void *def_light_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_light_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "defLight")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return def_light_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -1004,14 +1029,14 @@ static void *def_light_vector_handler(parser_state state, parser_context *contex
 		}
 	} else if (state == END_TAG) {
 		def_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return def_light_vector_handler;
 }
 
 static void *def_blob_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_blob_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -1033,13 +1058,13 @@ static void *def_blob_handler(parser_state state, parser_context *context, char
 }
 
 static void *def_blob_vector_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: def_blob_vector_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
 		if (!strcmp(name, "defBLOB")) {
 			if (property->count < INDIGO_MAX_ITEMS)
-				property->count++;
+				add_item(context);
 			return def_blob_handler;
 		}
 	} else if (state == ATTRIBUTE_VALUE) {
@@ -1065,14 +1090,14 @@ static void *def_blob_vector_handler(parser_state state, parser_context *context
 		}
 	} else if (state == END_TAG) {
 		def_property(context, property, message);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return def_blob_vector_handler;
 }
 
 static void *del_property_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: del_property_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -1107,14 +1132,14 @@ static void *del_property_handler(parser_state state, parser_context *context, c
 				}
 			}
 		}
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return del_property_handler;
 }
 
 static void *message_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_device *device = context->device;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: message_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == ATTRIBUTE_VALUE) {
@@ -1128,14 +1153,14 @@ static void *message_handler(parser_state state, parser_context *context, char *
 		}
 	} else if (state == END_TAG) {
 		indigo_send_message(device, *message ? message : NULL);
-		memset(property, 0, PROPERTY_SIZE);
+		memset(property, 0, sizeof(indigo_property));
 		return top_level_handler;
 	}
 	return message_handler;
 }
 
 static void *top_level_handler(parser_state state, parser_context *context, char *name, char *value, char *message) {
-	indigo_property *property = (indigo_property *)context->property_buffer;
+	indigo_property *property = context->property;
 	indigo_client *client = context->client;
 	INDIGO_TRACE_PARSER(indigo_trace("XML Parser: top_level_handler %s '%s' '%s'", parser_state_name[state], name != NULL ? name : "", value != NULL ? value : ""));
 	if (state == BEGIN_TAG) {
@@ -1235,6 +1260,7 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 	parser_context *context = malloc(sizeof(parser_context));
 	context->client = client;
 	context->device = device;
+	context->binary_blob = false;
 	if (device != NULL) {
 		context->count = 32;
 		context->properties = malloc(context->count * sizeof(indigo_property *));
@@ -1244,8 +1270,10 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 		context->properties = NULL;
 	}
 
-	indigo_property *property = (indigo_property *)&context->property_buffer;
-	memset(context->property_buffer, 0, PROPERTY_SIZE);
+	context->capacity = PROPERTY_CAPACITY;
+	context->property = malloc(sizeof(indigo_property) + context->capacity * sizeof(indigo_item));
+	assert(context->property != NULL);
+	memset(context->property, 0, sizeof(indigo_property));
 
 	int handle = 0;
 	if (device != NULL) {
@@ -1530,7 +1558,10 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 				} else if (c == '>') {
 					value_pointer = value_buffer;
 					if (handler == set_one_blob_vector_handler) {
+						indigo_property *property = context->property;
 						blob_size = property->items[property->count-1].blob.size;
+						bool binary_blob = context->binary_blob;
+						context->binary_blob = false;
 						if (blob_size > 0) {
 							state = BLOB;
 							if (blob_buffer != NULL) {
@@ -1542,6 +1573,20 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 								assert(blob_buffer != NULL);
 							}
 							blob_pointer = blob_buffer;
+							if (binary_blob) {
+								// raw payload follows '>', take the buffered part and read the rest directly to blob buffer
+								long len = (long)(buffer_end - pointer);
+								if (len > blob_size)
+									len = blob_size;
+								memcpy(blob_pointer, pointer, len);
+								pointer += len;
+								if (len < blob_size && indigo_read(handle, (char *)blob_pointer + len, blob_size - len) <= 0)
+									goto exit_loop;
+								handler = handler(BLOB, context, NULL, (char *)blob_buffer, message);
+								state = BLOB_END;
+								INDIGO_TRACE_PARSER(indigo_trace("XML Parser: '%c' %d ATTRIBUTE_NAME1 -> BLOB_END (binary)", c, depth));
+								break;
+							}
 						} else {
 							state = TEXT;
 						}
@@ -1628,6 +1673,7 @@ exit_loop:
 		free(blob_buffer);
 	if (context->properties)
 		free(context->properties);
+	free(context->property);
 	free(context);
 	free(buffer);
 	free(value_buffer);
@@ -1637,8 +1683,8 @@ exit_loop:
 
 char *indigo_xml_escape(char *string) {
 	if (strpbrk(string, "%<>\"'")) {
-		static char buffers[5][INDIGO_VALUE_SIZE];
-		static int	buffer_index = 0;
+		static __thread char buffers[5][INDIGO_VALUE_SIZE];
+		static __thread int	buffer_index = 0;
 		char *buffer = buffers[buffer_index = (buffer_index + 1) % 5];
 		char *in = string;
 		char *out = buffer;
@@ -1214,7 +1214,7 @@ static void exposure_timer_callback(indigo_device *device)
 						  PRIVATE_DATA->buffer,
 						  PRIVATE_DATA->buffer_size,
 						  PRIVATE_DATA->filename_suffix);
-		if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value) {
+		if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value || CCD_IMAGE_FORMAT_FITS_RICE_ITEM->sw.value) {
 			rc = process_dslr_image_debayer(device,
 							PRIVATE_DATA->buffer,
 							PRIVATE_DATA->buffer_size);
@@ -2601,7 +2601,7 @@ static indigo_result ccd_change_property(indigo_device *device,
 					    false);
 
 		/* RAW or FITS format, set to image quality pure RAW. */
-		if ((CCD_IMAGE_FORMAT_RAW_ITEM->sw.value || CCD_IMAGE_FORMAT_FITS_ITEM->sw.value) && PRIVATE_DATA->name_pure_raw_format) {
+		if ((CCD_IMAGE_FORMAT_RAW_ITEM->sw.value || CCD_IMAGE_FORMAT_FITS_ITEM->sw.value || CCD_IMAGE_FORMAT_FITS_RICE_ITEM->sw.value) && PRIVATE_DATA->name_pure_raw_format) {
 
 			indigo_set_switch(DSLR_COMPRESSION_PROPERTY,
 					  indigo_get_item(DSLR_COMPRESSION_PROPERTY,
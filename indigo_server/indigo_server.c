@@ -921,6 +921,14 @@ static void server_main() {
 			use_web_apps = false;
 		} else if (!strcmp(server_argv[i], "-u-") || !strcmp(server_argv[i], "--disable-blob-urls")) {
 			indigo_use_blob_urls = false;
+		} else if ((!strcmp(server_argv[i], "-o") || !strcmp(server_argv[i], "--local-write-policy")) && i < server_argc - 1) {
+			if (!strcmp(server_argv[i + 1], "sync"))
+				indigo_ccd_local_write_policy = INDIGO_CCD_WRITE_SYNC;
+			else if (!strcmp(server_argv[i + 1], "direct"))
+				indigo_ccd_local_write_policy = INDIGO_CCD_WRITE_DIRECT;
+			else
+				indigo_ccd_local_write_policy = INDIGO_CCD_WRITE_BUFFERED;
+			i++;
 #ifdef RPI_MANAGEMENT
 		} else if (!strcmp(server_argv[i], "-f") || !strcmp(server_argv[i], "--enable-rpi-management")) {
 			FILE *output = popen("which s_rpi_ctrl.sh", "r");
@@ -1176,6 +1184,7 @@ int main(int argc, const char * argv[]) {
 			       "       -b  | --bonjour name                  (default: hostname)\n"
 			       "       -b- | --disable-bonjour\n"
 			       "       -u- | --disable-blob-urls\n"
+			       "       -o  | --local-write-policy buffered|sync|direct (default: buffered)\n"
 			       "       -w- | --disable-web-apps\n"
 			       "       -c- | --disable-control-panel\n"
 #ifdef RPI_MANAGEMENT
@@ -0,0 +1,242 @@
+// Copyright (c) 2026 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Multi-client stress test of XML and JSON device adapters, several threads update properties concurrently and every client
+// must receive complete (not interleaved) messages, all definitions and the last value of each property
+// usage: adapter_stress [max_clients [updates]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_driver_xml.h>
+#include <indigo/indigo_client_xml.h>
+#include <indigo/indigo_driver_json.h>
+
+#define MAX_CLIENTS 64
+#define PROPERTY_COUNT 32
+#define THREAD_COUNT 4
+
+typedef struct {
+	int handle;
+	int adapter_handle;
+	bool json;
+	long messages;
+	long errors;
+	int definitions;
+	bool done;
+	double values[PROPERTY_COUNT];
+} stress_client;
+
+static indigo_device device = { 0 };
+static indigo_property *properties[PROPERTY_COUNT];
+static int update_count;
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// check single complete message and record definition or value it carries
+
+static void process_message(stress_client *client, char *message) {
+	char *name = strstr(message, client->json ? "\"name\": \"" : "name='");
+	if (name == NULL) {
+		client->errors++;
+		return;
+	}
+	name += client->json ? 9 : 6;
+	client->messages++;
+	if (!strncmp(name, "DONE", 4)) {
+		client->done = true;
+		return;
+	}
+	int index = atoi(name + 1);
+	if (*name != 'P' || index < 0 || index >= PROPERTY_COUNT) {
+		client->errors++;
+		return;
+	}
+	bool definition = strstr(message, client->json ? "{ \"defNumberVector\"" : "<defNumberVector") == message;
+	bool update = strstr(message, client->json ? "{ \"setNumberVector\"" : "<setNumberVector") == message;
+	char *value = client->json ? strstr(message, "\"value\": ") : strstr(message, definition ? "<defNumber " : "<oneNumber");
+	if (value && !client->json)
+		value = strchr(value, '>');
+	if (!(definition || update) || value == NULL) {
+		client->errors++;
+		return;
+	}
+	if (definition)
+		client->definitions++;
+	client->values[index] = atof(value + (client->json ? 9 : 1));
+}
+
+// XML messages end with closing vector tag on separate line, JSON messages end when braces are balanced
+
+static void reader_thread(stress_client *client) {
+	static __thread char buffer[64 * 1024];
+	char message[4096];
+	int length = 0, depth = 0;
+	long count;
+	// connection is read until closed, so adapter can flush its queue
+	while ((count = read(client->handle, buffer, sizeof(buffer))) > 0) {
+		for (long i = 0; i < count && !client->done; i++) {
+			char c = buffer[i];
+			if (length == sizeof(message) - 1) {
+				client->errors++;
+				length = 0;
+			}
+			if (client->json) {
+				if (length == 0 && c != '{')
+					continue;
+				message[length++] = c;
+				if (c == '{')
+					depth++;
+				else if (c == '}' && --depth == 0) {
+					message[length] = 0;
+					process_message(client, message);
+					length = 0;
+				}
+			} else {
+				message[length++] = c;
+				if (c == '\n') {
+					message[length] = 0;
+					char *line = strrchr(message, '\n');
+					while (line > message && line[-1] != '\n')
+						line--;
+					if (!strncmp(line, "</", 2)) {
+						process_message(client, message);
+						length = 0;
+					} else if (line != message && strstr(line, "Vector ")) {
+						// next message starts before previous one is closed
+						client->errors++;
+						memmove(message, line, strlen(line) + 1);
+						length = (int)strlen(message);
+					}
+				}
+			}
+		}
+	}
+}
+
+static void updater_thread(void *data) {
+	int first = (int)(long)data * PROPERTY_COUNT / THREAD_COUNT;
+	int last = first + PROPERTY_COUNT / THREAD_COUNT;
+	for (int update = 1; update <= update_count; update++) {
+		for (int i = first; i < last; i++) {
+			properties[i]->items[0].number.value = update;
+			indigo_update_property(&device, properties[i], NULL);
+		}
+	}
+}
+
+static void run_clients(int count, bool json) {
+	static stress_client clients[MAX_CLIENTS];
+	indigo_client *adapters[MAX_CLIENTS];
+	pthread_t readers[MAX_CLIENTS], updaters[THREAD_COUNT];
+	int handles[2];
+	for (int i = 0; i < count; i++) {
+		memset(clients + i, 0, sizeof(stress_client));
+		socketpair(AF_UNIX, SOCK_STREAM, 0, handles);
+		clients[i].handle = handles[1];
+		clients[i].adapter_handle = handles[0];
+		clients[i].json = json;
+		adapters[i] = json ? indigo_json_device_adapter(handles[0], handles[0], false) : indigo_xml_device_adapter(handles[0], handles[0]);
+		adapters[i]->version = INDIGO_VERSION_2_0;
+		indigo_attach_client(adapters[i]);
+		pthread_create(readers + i, NULL, (void *(*)(void *))reader_thread, clients + i);
+	}
+	double start = now();
+	for (int i = 0; i < PROPERTY_COUNT; i++) {
+		properties[i]->items[0].number.value = 0;
+		indigo_define_property(&device, properties[i], NULL);
+	}
+	for (long i = 0; i < THREAD_COUNT; i++)
+		pthread_create(updaters + i, NULL, (void *(*)(void *))updater_thread, (void *)i);
+	for (int i = 0; i < THREAD_COUNT; i++)
+		pthread_join(updaters[i], NULL);
+	indigo_property *done = indigo_init_switch_property(NULL, device.name, "DONE", "Main", "Done", INDIGO_OK_STATE, INDIGO_RO_PERM, INDIGO_ONE_OF_MANY_RULE, 1);
+	indigo_init_switch_item(done->items, "DONE", "Done", true);
+	indigo_define_property(&device, done, NULL);
+	double dispatched = now() - start;
+	long messages = 0, errors = 0;
+	for (int i = 0; i < count; i++) {
+		while (!clients[i].done)
+			usleep(1000);
+		messages += clients[i].messages;
+		errors += clients[i].errors;
+		if (clients[i].definitions != PROPERTY_COUNT)
+			errors++;
+		for (int j = 0; j < PROPERTY_COUNT; j++)
+			if (clients[i].values[j] != update_count)
+				errors++;
+	}
+	double delivered = now() - start;
+	for (int i = 0; i < PROPERTY_COUNT; i++)
+		indigo_delete_property(&device, properties[i], NULL);
+	indigo_delete_property(&device, done, NULL);
+	indigo_release_property(done);
+	for (int i = 0; i < count; i++) {
+		indigo_detach_client(adapters[i]);
+		// JSON adapter closes its handle on detach
+		if (json) {
+			indigo_release_json_device_adapter(adapters[i]);
+		} else {
+			indigo_release_xml_device_adapter(adapters[i]);
+			close(clients[i].adapter_handle);
+		}
+		pthread_join(readers[i], NULL);
+		close(clients[i].handle);
+	}
+	long updates = (long)PROPERTY_COUNT * update_count;
+	printf("%-6s %8d %12.0f %14.1f %12.1f %8ld\n", json ? "JSON" : "XML", count, updates / dispatched, delivered * 1000, 100.0 * messages / (updates * count), errors);
+}
+
+int main(int argc, const char * argv[]) {
+	int max_clients = argc > 1 ? atoi(argv[1]) : 16;
+	update_count = argc > 2 ? atoi(argv[2]) : 2000;
+	if (max_clients < 1 || max_clients > MAX_CLIENTS)
+		max_clients = 16;
+	if (update_count < 1)
+		update_count = 2000;
+	signal(SIGPIPE, SIG_IGN);
+	indigo_main_argc = argc;
+	indigo_main_argv = argv;
+	indigo_start();
+	strcpy(device.name, "Stress");
+	for (int i = 0; i < PROPERTY_COUNT; i++) {
+		char name[INDIGO_NAME_SIZE];
+		snprintf(name, sizeof(name), "P%d", i);
+		properties[i] = indigo_init_number_property(NULL, device.name, name, "Main", name, INDIGO_OK_STATE, INDIGO_RO_PERM, 1);
+		indigo_init_number_item(properties[i]->items, "V", "Value", 0, 1e9, 1, 0);
+	}
+	printf("%d properties updated %d times by %d threads\n", PROPERTY_COUNT, update_count, THREAD_COUNT);
+	printf("%-6s %8s %12s %14s %12s %8s\n", "format", "clients", "[updates/s]", "delivered [ms]", "sent [%]", "errors");
+	for (int json = 0; json <= 1; json++)
+		for (int count = 1; count <= max_clients; count *= 2)
+			run_clients(count, json);
+	for (int i = 0; i < PROPERTY_COUNT; i++)
+		indigo_release_property(properties[i]);
+	indigo_stop();
+	return 0;
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2026 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Base64 throughput benchmark from 1 MB to 100 MB and check that the output is identical to the scalar code,
+// base64_decode_fast_nl() is scalar only, so it is used as reference decoder
+// usage: base64_benchmark [max_size_mb [seconds]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <indigo/indigo_base64.h>
+
+#define CHECK_COUNT 20000
+#define CHECK_SIZE 600
+
+static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// plain RFC 4648 encoder, reference for base64_encode()
+
+static long reference_encode(unsigned char *out, const unsigned char *in, long inlen) {
+	unsigned char *start = out;
+	for (; inlen > 2; inlen -= 3, in += 3) {
+		*out++ = digits[in[0] >> 2];
+		*out++ = digits[(in[0] & 0x03) << 4 | in[1] >> 4];
+		*out++ = digits[(in[1] & 0x0F) << 2 | in[2] >> 6];
+		*out++ = digits[in[2] & 0x3F];
+	}
+	if (inlen > 0) {
+		*out++ = digits[in[0] >> 2];
+		*out++ = digits[(in[0] & 0x03) << 4 | (inlen > 1 ? in[1] >> 4 : 0)];
+		*out++ = inlen > 1 ? digits[(in[1] & 0x0F) << 2] : '=';
+		*out++ = '=';
+	}
+	*out = 0;
+	return out - start;
+}
+
+static void fill(unsigned char *data, long size) {
+	for (long i = 0; i < size; i++)
+		data[i] = (unsigned char)rand();
+}
+
+// repeat operation for at least given time, returns MB/s of binary data
+
+static double measure(long (*operation)(unsigned char *, const unsigned char *, long), unsigned char *out, const unsigned char *in, long inlen, long size, double seconds) {
+	int count = 0;
+	double start = now(), elapsed;
+	do {
+		operation(out, in, inlen);
+		count++;
+	} while ((elapsed = now() - start) < seconds);
+	return (double)size * count / elapsed / 1e6;
+}
+
+// random lengths to cover all tails, decoder is checked with valid input and with invalid characters injected
+
+static long check(void) {
+	static unsigned char data[CHECK_SIZE], encoded[CHECK_SIZE * 4 / 3 + 8], reference[CHECK_SIZE * 4 / 3 + 8];
+	static unsigned char decoded[CHECK_SIZE + 8], reference_decoded[CHECK_SIZE + 8];
+	long errors = 0;
+	for (int i = 0; i < CHECK_COUNT; i++) {
+		long size = 1 + rand() % CHECK_SIZE;
+		fill(data, size);
+		long length = base64_encode(encoded, data, size);
+		if (length != reference_encode(reference, data, size) || memcmp(encoded, reference, length + 1)) {
+			errors++;
+			continue;
+		}
+		if (i % 2) {
+			// '\n' is skipped by reference decoder, so it is not used
+			int invalid[] = { 0, ' ', '-', '_', '.', 0x80, 0xFF };
+			encoded[rand() % length] = invalid[rand() % (sizeof(invalid) / sizeof(int))];
+		}
+		memset(decoded, 0, sizeof(decoded));
+		memset(reference_decoded, 0, sizeof(reference_decoded));
+		long decoded_size = base64_decode_fast(decoded, encoded, length);
+		if (decoded_size != base64_decode_fast_nl(reference_decoded, encoded, length) || memcmp(decoded, reference_decoded, sizeof(decoded)))
+			errors++;
+		else if (i % 2 == 0 && (decoded_size != size || memcmp(decoded, data, size)))
+			errors++;
+	}
+	return errors;
+}
+
+int main(int argc, const char * argv[]) {
+	int max_size = argc > 1 ? atoi(argv[1]) : 100;
+	double seconds = argc > 2 ? atof(argv[2]) : 1;
+	if (max_size < 1)
+		max_size = 100;
+	printf("%d random buffers up to %d bytes: %ld errors\n\n", CHECK_COUNT, CHECK_SIZE, check());
+	printf("%8s %12s %12s %12s %12s %10s\n", "[MB]", "encode", "decode", "ref. encode", "ref. decode", "identical");
+	for (int size_mb = 1; size_mb <= max_size; size_mb *= 10) {
+		long size = size_mb * 1000000L;
+		long length = (size + 2) / 3 * 4;
+		unsigned char *data = malloc(size);
+		unsigned char *encoded = malloc(length + 1), *reference = malloc(length + 1);
+		unsigned char *decoded = malloc(size + 4), *reference_decoded = malloc(size + 4);
+		if (data == NULL || encoded == NULL || reference == NULL || decoded == NULL || reference_decoded == NULL) {
+			printf("can't allocate %d MB buffers\n", size_mb);
+			return 1;
+		}
+		fill(data, size);
+		double encode = measure(base64_encode, encoded, data, size, size, seconds);
+		double decode = measure(base64_decode_fast, decoded, encoded, length, size, seconds);
+		double reference_encode_speed = measure(reference_encode, reference, data, size, size, seconds);
+		double reference_decode_speed = measure(base64_decode_fast_nl, reference_decoded, encoded, length, size, seconds);
+		bool identical = !memcmp(encoded, reference, length + 1) && !memcmp(decoded, data, size) && !memcmp(decoded, reference_decoded, size);
+		printf("%8d %12.0f %12.0f %12.0f %12.0f %10s\n", size_mb, encode, decode, reference_encode_speed, reference_decode_speed, identical ? "yes" : "NO");
+		free(data);
+		free(encoded);
+		free(reference);
+		free(decoded);
+		free(reference_decoded);
+	}
+	printf("\nthroughput in MB/s of binary data\n");
+	return 0;
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2026 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Dispatch benchmark for targeted indigo_change_property() requests, hashed device registry vs. linear scan of all devices
+// usage: bus_benchmark [device_count [iterations]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <indigo/indigo_bus.h>
+
+#define MAX_DEVICES 256
+
+static long change_count = 0;
+
+static indigo_result benchmark_attach(indigo_device *device) {
+	return INDIGO_OK;
+}
+
+static indigo_result benchmark_change_property(indigo_device *device, indigo_client *client, indigo_property *property) {
+	change_count++;
+	return INDIGO_OK;
+}
+
+static indigo_result benchmark_detach(indigo_device *device) {
+	return INDIGO_OK;
+}
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// routing loop of indigo_change_property() before the device registry, every attached device name is compared
+
+static void linear_change_property(indigo_device **devices, indigo_client *client, indigo_property *property) {
+	for (int i = 0; i < MAX_DEVICES; i++) {
+		indigo_device *device = devices[i];
+		if (device != NULL && device->change_property != NULL) {
+			bool route = *property->device == 0;
+			route = route || !strcmp(property->device, device->name);
+			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
+			route = route || (!indigo_use_host_suffix && *device->name == '@');
+			if (route)
+				device->last_result = device->change_property(device, client, property);
+		}
+	}
+}
+
+int main(int argc, const char * argv[]) {
+	int device_count = argc > 1 ? atoi(argv[1]) : 48;
+	int iterations = argc > 2 ? atoi(argv[2]) : 1000000;
+	if (device_count < 1 || device_count > MAX_DEVICES - 1)
+		device_count = 48;
+	indigo_main_argc = argc;
+	indigo_main_argv = argv;
+	indigo_start();
+	static indigo_device benchmark_template = INDIGO_DEVICE_INITIALIZER(
+		"",
+		benchmark_attach,
+		NULL,
+		benchmark_change_property,
+		NULL,
+		benchmark_detach
+	);
+	indigo_device *devices[MAX_DEVICES] = { NULL };
+	for (int i = 0; i < device_count; i++) {
+		indigo_device *device = malloc(sizeof(indigo_device));
+		memcpy(device, &benchmark_template, sizeof(indigo_device));
+		snprintf(device->name, INDIGO_NAME_SIZE, "Benchmark Device #%d", i);
+		indigo_attach_device(device);
+		devices[i] = device;
+	}
+	indigo_property *property = indigo_init_switch_property(NULL, devices[device_count - 1]->name, "BENCHMARK", "Main", "Benchmark", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 1);
+	indigo_init_switch_item(property->items, "ITEM", "Item", true);
+	printf("%d devices, %d targeted change requests\n", device_count, iterations);
+	printf("%-10s %12s %12s\n", "routing", "[ns/call]", "delivered");
+	change_count = 0;
+	double start = now();
+	for (int i = 0; i < iterations; i++)
+		indigo_change_property(NULL, property);
+	printf("%-10s %12.1f %12ld\n", "hashed", (now() - start) * 1e9 / iterations, change_count);
+	change_count = 0;
+	start = now();
+	for (int i = 0; i < iterations; i++)
+		linear_change_property(devices, NULL, property);
+	printf("%-10s %12.1f %12ld\n", "linear", (now() - start) * 1e9 / iterations, change_count);
+	for (int i = 0; i < device_count; i++) {
+		indigo_detach_device(devices[i]);
+		free(devices[i]);
+	}
+	indigo_release_property(property);
+	indigo_stop();
+	return 0;
+}
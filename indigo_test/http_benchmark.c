@@ -0,0 +1,223 @@
+// Copyright (c) 2026 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// HTTP server benchmark, keep-alive clients from 1 to max_clients, requests with slow clients connected and cost of XML sessions
+// usage: http_benchmark [max_clients [seconds]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_server_tcp.h>
+
+#define MAX_CLIENTS 1000
+#define SLOW_CLIENTS 16
+
+static const char request[] = "GET /benchmark HTTP/1.1\r\nConnection: keep-alive\r\n\r\n";
+static unsigned char content[1024];
+
+typedef struct {
+	int socket;
+	int received;
+	double sent;
+	char buffer[2048];
+} benchmark_client;
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void server_callback(int count) {
+}
+
+static void *server_thread(void *data) {
+	indigo_server_start(server_callback);
+	return NULL;
+}
+
+static int open_connection() {
+	int handle = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in address = { 0 };
+	address.sin_family = AF_INET;
+	address.sin_port = htons(indigo_server_tcp_port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (handle < 0 || connect(handle, (struct sockaddr *)&address, sizeof(address)) < 0) {
+		perror("connect");
+		exit(1);
+	}
+	return handle;
+}
+
+// response is complete when the headers and Content-Length bytes of body are received
+
+static bool response_complete(benchmark_client *client) {
+	client->buffer[client->received] = 0;
+	char *body = strstr(client->buffer, "\r\n\r\n");
+	char *length = strstr(client->buffer, "Content-Length: ");
+	return body && length && client->received >= body + 4 - client->buffer + atoi(length + 16);
+}
+
+// all clients send request, wait for complete response and send next one on the same connection
+
+static void run_clients(int count, double seconds) {
+	static benchmark_client clients[MAX_CLIENTS];
+	static struct pollfd fds[MAX_CLIENTS];
+	for (int i = 0; i < count; i++) {
+		clients[i].socket = open_connection();
+		clients[i].received = 0;
+		clients[i].sent = now();
+		fds[i].fd = clients[i].socket;
+		fds[i].events = POLLIN;
+		write(clients[i].socket, request, sizeof(request) - 1);
+	}
+	long responses = 0, failures = 0;
+	double latency = 0, max_latency = 0;
+	double start = now(), end = start + seconds;
+	while (now() < end) {
+		if (poll(fds, count, 100) <= 0)
+			continue;
+		for (int i = 0; i < count; i++) {
+			if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			benchmark_client *client = clients + i;
+			long bytes = read(client->socket, client->buffer + client->received, sizeof(client->buffer) - 1 - client->received);
+			if (bytes <= 0) {
+				failures++;
+				close(client->socket);
+				fds[i].fd = -1;
+				continue;
+			}
+			client->received += bytes;
+			if (response_complete(client)) {
+				double time = now();
+				double value = time - client->sent;
+				latency += value;
+				if (value > max_latency)
+					max_latency = value;
+				responses++;
+				client->received = 0;
+				client->sent = time;
+				write(client->socket, request, sizeof(request) - 1);
+			}
+		}
+	}
+	double elapsed = now() - start;
+	for (int i = 0; i < count; i++)
+		if (fds[i].fd >= 0)
+			close(clients[i].socket);
+	printf("%8d %12.0f %12.3f %12.3f %8ld\n", count, responses / elapsed, responses ? latency * 1000 / responses : 0, max_latency * 1000, failures);
+}
+
+// single request on new connection, returns time to complete response or -1 on failure
+
+static double single_request() {
+	benchmark_client client = { 0 };
+	double start = now();
+	client.socket = open_connection();
+	write(client.socket, request, sizeof(request) - 1);
+	long bytes;
+	while (!response_complete(&client) && (bytes = read(client.socket, client.buffer + client.received, sizeof(client.buffer) - 1 - client.received)) > 0)
+		client.received += bytes;
+	close(client.socket);
+	return response_complete(&client) ? now() - start : -1;
+}
+
+static long status_value(const char *name) {
+	char line[256];
+	long value = 0;
+	FILE *file = fopen("/proc/self/status", "r");
+	if (file == NULL)
+		return 0;
+	while (fgets(line, sizeof(line), file))
+		if (!strncmp(line, name, strlen(name)))
+			value = atol(line + strlen(name));
+	fclose(file);
+	return value;
+}
+
+int main(int argc, const char * argv[]) {
+	int max_clients = argc > 1 ? atoi(argv[1]) : 500;
+	double seconds = argc > 2 ? atof(argv[2]) : 3;
+	if (max_clients < 1 || max_clients > MAX_CLIENTS)
+		max_clients = 500;
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+	signal(SIGPIPE, SIG_IGN);
+	indigo_main_argc = argc;
+	indigo_main_argv = argv;
+	indigo_server_tcp_port = 0;
+	indigo_start();
+	memset(content, 'x', sizeof(content));
+	indigo_server_add_resource("/benchmark", content, sizeof(content), "text/plain");
+	pthread_t thread;
+	pthread_create(&thread, NULL, server_thread, NULL);
+	while (indigo_server_tcp_port == 0)
+		usleep(10000);
+	usleep(100000);
+
+	printf("keep-alive clients, %d byte response, %.1f s per run\n", (int)sizeof(content), seconds);
+	printf("%8s %12s %12s %12s %8s\n", "clients", "[req/s]", "avg [ms]", "max [ms]", "failed");
+	static const int levels[] = { 1, 10, 50, 100, 200, 500, 1000 };
+	for (int i = 0; i < sizeof(levels) / sizeof(int) && levels[i] <= max_clients; i++)
+		run_clients(levels[i], seconds);
+
+	// slow clients send incomplete headers and keep connections open
+	int slow[SLOW_CLIENTS];
+	for (int i = 0; i < SLOW_CLIENTS; i++) {
+		slow[i] = open_connection();
+		write(slow[i], "GET /benchmark HTTP/1.1\r\n", 25);
+	}
+	usleep(100000);
+	double time = single_request();
+	printf("\nrequest with %d slow clients connected: %.3f ms%s\n", SLOW_CLIENTS, time * 1000, time < 0 ? " (failed)" : "");
+	for (int i = 0; i < SLOW_CLIENTS; i++)
+		close(slow[i]);
+
+	// each XML session is served by its own thread with a blocking parser
+	int session_count = max_clients;
+	int *sessions = malloc(session_count * sizeof(int));
+	usleep(500000);
+	long threads = status_value("Threads:"), rss = status_value("VmRSS:");
+	for (int i = 0; i < session_count; i++) {
+		sessions[i] = open_connection();
+		write(sessions[i], "<getProperties version='2.0'/>\n", 31);
+	}
+	sleep(1);
+	long session_threads = status_value("Threads:") - threads, session_rss = status_value("VmRSS:") - rss;
+	printf("\n%d XML sessions: %ld threads, %ld kB RSS, %.1f kB per session\n", session_count, session_threads, session_rss, (double)session_rss / session_count);
+	for (int i = 0; i < session_count; i++)
+		close(sessions[i]);
+	free(sessions);
+	indigo_server_shutdown();
+	indigo_stop();
+	return 0;
+}
@@ -0,0 +1,150 @@
+// Copyright (c) 2026 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Image conversion benchmark for indigo_process_image(), FITS, XISF, RAW and JPEG formats with preview over common sensor
+// sizes and bit depths. Checksum covers converted pixel data, preview and JPEG image for all endianness and RGB byte order
+// variants (headers contain time stamps, so they are not included), output of two builds is identical if checksums match.
+// usage: image_benchmark [width height [iterations]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_ccd_driver.h>
+
+static struct {
+	int width;
+	int height;
+} sizes[] = {
+	{ 1920, 1080 },
+	{ 4656, 3520 },
+	{ 6000, 4000 },
+	{ 9576, 6388 }
+};
+
+static indigo_result benchmark_attach(indigo_device *device) {
+	return indigo_ccd_attach(device, INDIGO_VERSION_CURRENT);
+}
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill(unsigned char *data, long size) {
+	// gradient with noise, so histogram and stretch have some work to do, the same for each call
+	unsigned int seed = 1;
+	for (long i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = (unsigned char)((i >> 10) + ((seed >> 16) & 0x1F));
+	}
+}
+
+// FNV-1a
+
+static unsigned long long checksum(unsigned long long hash, const unsigned char *data, long size) {
+	for (long i = 0; i < size; i++)
+		hash = (hash ^ data[i]) * 0x100000001B3ULL;
+	return hash;
+}
+
+static double run(indigo_device *device, unsigned char *data, int width, int height, int bpp, int iterations) {
+	long size = (long)width * height * bpp / 8;
+	double total = 0;
+	for (int i = 0; i < iterations; i++) {
+		fill(data + FITS_HEADER_SIZE, size);
+		double start = now();
+		indigo_process_image(device, data, width, height, bpp, true, true, NULL);
+		total += now() - start;
+	}
+	return total / iterations;
+}
+
+static unsigned long long verify(indigo_device *device, unsigned char *data, int width, int height, int bpp) {
+	long size = (long)width * height * bpp / 8;
+	unsigned long long hash = 0xCBF29CE484222325ULL;
+	for (int variant = 0; variant < 4; variant++) {
+		fill(data + FITS_HEADER_SIZE, size);
+		indigo_process_image(device, data, width, height, bpp, variant & 1, variant & 2, NULL);
+		if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value)
+			hash = checksum(hash, CCD_IMAGE_ITEM->blob.value, CCD_IMAGE_ITEM->blob.size);
+		else
+			hash = checksum(hash, data + FITS_HEADER_SIZE, size);
+		if (CCD_PREVIEW_ENABLED_ITEM->sw.value && CCD_PREVIEW_IMAGE_ITEM->blob.value)
+			hash = checksum(hash, CCD_PREVIEW_IMAGE_ITEM->blob.value, CCD_PREVIEW_IMAGE_ITEM->blob.size);
+	}
+	return hash;
+}
+
+int main(int argc, const char * argv[]) {
+	int size_count = sizeof(sizes) / sizeof(sizes[0]);
+	if (argc > 2) {
+		sizes[0].width = atoi(argv[1]);
+		sizes[0].height = atoi(argv[2]);
+		size_count = 1;
+	}
+	int iterations = argc > 3 ? atoi(argv[3]) : 3;
+	if (iterations < 1)
+		iterations = 3;
+	indigo_main_argc = argc;
+	indigo_main_argv = argv;
+	indigo_start();
+	static indigo_device benchmark_template = INDIGO_DEVICE_INITIALIZER(
+		"Image Benchmark",
+		benchmark_attach,
+		indigo_ccd_enumerate_properties,
+		indigo_ccd_change_property,
+		NULL,
+		indigo_ccd_detach
+	);
+	indigo_device *device = malloc(sizeof(indigo_device));
+	memcpy(device, &benchmark_template, sizeof(indigo_device));
+	indigo_attach_device(device);
+	indigo_set_switch(CCD_UPLOAD_MODE_PROPERTY, CCD_UPLOAD_MODE_CLIENT_ITEM, true);
+	static const struct { int bpp; const char *name; } depths[] = { { 8, "mono8" }, { 16, "mono16" }, { 24, "rgb24" }, { 48, "rgb48" } };
+	indigo_item *formats[] = { CCD_IMAGE_FORMAT_FITS_ITEM, CCD_IMAGE_FORMAT_XISF_ITEM, CCD_IMAGE_FORMAT_RAW_ITEM, CCD_IMAGE_FORMAT_JPEG_ITEM };
+	printf("%d iterations, time with preview\n", iterations);
+	printf("%-12s %-8s %-8s %12s %18s\n", "size", "format", "depth", "time [ms]", "checksum");
+	for (int s = 0; s < size_count; s++) {
+		int width = sizes[s].width, height = sizes[s].height;
+		unsigned char *data = malloc(FITS_HEADER_SIZE + (long)width * height * 6);
+		if (data == NULL) {
+			printf("can't allocate %dx%d frame\n", width, height);
+			break;
+		}
+		char size[32];
+		snprintf(size, sizeof(size), "%dx%d", width, height);
+		for (int f = 0; f < 4; f++) {
+			indigo_set_switch(CCD_IMAGE_FORMAT_PROPERTY, formats[f], true);
+			// JPEG image is its own preview
+			indigo_set_switch(CCD_PREVIEW_PROPERTY, formats[f] == CCD_IMAGE_FORMAT_JPEG_ITEM ? CCD_PREVIEW_DISABLED_ITEM : CCD_PREVIEW_ENABLED_ITEM, true);
+			for (int d = 0; d < 4; d++) {
+				double time = run(device, data, width, height, depths[d].bpp, iterations);
+				unsigned long long hash = verify(device, data, width, height, depths[d].bpp);
+				printf("%-12s %-8s %-8s %12.1f %18llx\n", size, formats[f]->name, depths[d].name, time * 1000, hash);
+			}
+		}
+		free(data);
+	}
+	indigo_detach_device(device);
+	free(device);
+	indigo_stop();
+	return 0;
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2026 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// JPEG encoding benchmark for indigo_process_image(), full size JPEG image and reduced preview
+// usage: jpeg_benchmark [width height [preview_width [iterations]]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_ccd_driver.h>
+
+static indigo_result benchmark_attach(indigo_device *device) {
+	return indigo_ccd_attach(device, INDIGO_VERSION_CURRENT);
+}
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fill(unsigned char *data, long size) {
+	// gradient with noise, so stretch and DCT have some work to do
+	for (long i = 0; i < size; i++)
+		data[i] = (unsigned char)((i >> 10) + (rand() & 0x1F));
+}
+
+static double run(indigo_device *device, void *data, int width, int height, int bpp, int iterations) {
+	long size = (long)width * height * bpp / 8;
+	double total = 0;
+	for (int i = 0; i < iterations; i++) {
+		fill(data + FITS_HEADER_SIZE, size);
+		double start = now();
+		indigo_process_image(device, data, width, height, bpp, true, true, NULL);
+		total += now() - start;
+	}
+	return total / iterations;
+}
+
+int main(int argc, const char * argv[]) {
+	int width = argc > 2 ? atoi(argv[1]) : 4656;
+	int height = argc > 2 ? atoi(argv[2]) : 3520;
+	int preview_width = argc > 3 ? atoi(argv[3]) : 1024;
+	int iterations = argc > 4 ? atoi(argv[4]) : 5;
+	indigo_main_argc = argc;
+	indigo_main_argv = argv;
+	indigo_start();
+	static indigo_device benchmark_template = INDIGO_DEVICE_INITIALIZER(
+		"JPEG Benchmark",
+		benchmark_attach,
+		indigo_ccd_enumerate_properties,
+		indigo_ccd_change_property,
+		NULL,
+		indigo_ccd_detach
+	);
+	indigo_device *device = malloc(sizeof(indigo_device));
+	memcpy(device, &benchmark_template, sizeof(indigo_device));
+	indigo_attach_device(device);
+	indigo_set_switch(CCD_UPLOAD_MODE_PROPERTY, CCD_UPLOAD_MODE_CLIENT_ITEM, true);
+	void *data = malloc(FITS_HEADER_SIZE + (long)width * height * 6);
+	static const struct { int bpp; const char *name; } formats[] = { { 8, "mono8" }, { 16, "mono16" }, { 24, "rgb24" }, { 48, "rgb48" } };
+	printf("%dx%d, preview width %d, %d iterations\n", width, height, preview_width, iterations);
+	printf("%-8s %12s %12s\n", "format", "jpeg [ms]", "preview [ms]");
+	for (int f = 0; f < 4; f++) {
+		indigo_set_switch(CCD_PREVIEW_PROPERTY, CCD_PREVIEW_DISABLED_ITEM, true);
+		indigo_set_switch(CCD_IMAGE_FORMAT_PROPERTY, CCD_IMAGE_FORMAT_JPEG_ITEM, true);
+		double jpeg = run(device, data, width, height, formats[f].bpp, iterations);
+		indigo_set_switch(CCD_PREVIEW_PROPERTY, CCD_PREVIEW_ENABLED_ITEM, true);
+		indigo_set_switch(CCD_IMAGE_FORMAT_PROPERTY, CCD_IMAGE_FORMAT_RAW_ITEM, true);
+		CCD_JPEG_SETTINGS_PREVIEW_WIDTH_ITEM->number.value = preview_width;
+		double preview = run(device, data, width, height, formats[f].bpp, iterations);
+		printf("%-8s %12.1f %12.1f\n", formats[f].name, jpeg * 1000, preview * 1000);
+	}
+	indigo_detach_device(device);
+	free(device);
+	free(data);
+	indigo_stop();
+	return 0;
+}
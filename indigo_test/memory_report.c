@@ -0,0 +1,192 @@
+// Copyright (c) 2026 CloudMakers, s. r. o.
+// All rights reserved.
+//
+// You can use this software under the terms of 'INDIGO Astronomy
+// open-source license' (see LICENSE.md).
+//
+// THIS SOFTWARE IS PROVIDED BY THE AUTHORS 'AS IS' AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+// GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Heap usage of full simulator setup, simulator drivers, imager, guider and mount agents with selected devices and XML clients
+// usage: memory_report [client_count]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <indigo/indigo_bus.h>
+#include <indigo/indigo_xml.h>
+#include <indigo/indigo_driver_xml.h>
+#include <indigo/indigo_client_xml.h>
+
+#include "ccd_simulator/indigo_ccd_simulator.h"
+#include "mount_simulator/indigo_mount_simulator.h"
+#include "dome_simulator/indigo_dome_simulator.h"
+#include "gps_simulator/indigo_gps_simulator.h"
+#include "rotator_simulator/indigo_rotator_simulator.h"
+#include "agent_imager/indigo_agent_imager.h"
+#include "agent_guider/indigo_agent_guider.h"
+#include "agent_mount/indigo_agent_mount.h"
+
+#define MAX_CLIENTS 64
+
+static size_t last_heap = 0;
+
+static size_t heap_in_use() {
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+}
+
+static void report(const char *stage) {
+	sleep(2);
+	size_t heap = heap_in_use();
+	printf("%-40s %12.2f %12.2f\n", stage, heap / 1048576.0, ((double)heap - last_heap) / 1048576.0);
+	last_heap = heap;
+}
+
+// properties defined by agents, most of them are copies of properties of the selected devices
+
+#define MAX_RECORDS 4096
+
+static struct {
+	char device[INDIGO_NAME_SIZE];
+	char name[INDIGO_NAME_SIZE];
+	long size;
+} records[MAX_RECORDS];
+static int record_count = 0;
+static pthread_mutex_t records_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static indigo_result report_define_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+	int length = (int)strlen(property->device);
+	if (length < 6 || strcmp(property->device + length - 6, " Agent"))
+		return INDIGO_OK;
+	pthread_mutex_lock(&records_mutex);
+	int i;
+	for (i = 0; i < record_count; i++)
+		if (!strcmp(records[i].device, property->device) && !strcmp(records[i].name, property->name))
+			break;
+	if (i < MAX_RECORDS) {
+		if (i == record_count) {
+			strcpy(records[i].device, property->device);
+			strcpy(records[i].name, property->name);
+			record_count++;
+		}
+		records[i].size = sizeof(indigo_property) + property->count * sizeof(indigo_item);
+	}
+	pthread_mutex_unlock(&records_mutex);
+	return INDIGO_OK;
+}
+
+static indigo_result report_delete_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+	pthread_mutex_lock(&records_mutex);
+	for (int i = 0; i < record_count; i++) {
+		if (!strcmp(records[i].device, property->device) && (*property->name == 0 || !strcmp(records[i].name, property->name)))
+			records[i--] = records[--record_count];
+	}
+	pthread_mutex_unlock(&records_mutex);
+	return INDIGO_OK;
+}
+
+static indigo_client report_client = {
+	"Memory report", false, NULL, INDIGO_OK, INDIGO_VERSION_CURRENT, NULL,
+	NULL,
+	report_define_property,
+	NULL,
+	report_delete_property,
+	NULL,
+	NULL
+};
+
+static void select_device(const char *agent, const char *list, const char *device) {
+	indigo_change_switch_property_1(NULL, agent, list, device, true);
+	sleep(1);
+}
+
+// client connections are served by parser thread, output is read and dropped
+
+static void parser_thread(indigo_client *protocol_adapter) {
+	indigo_xml_parse(NULL, protocol_adapter);
+}
+
+static void drain_thread(void *data) {
+	char buffer[64 * 1024];
+	while (read((int)(long)data, buffer, sizeof(buffer)) > 0)
+		;
+}
+
+int main(int argc, const char * argv[]) {
+	int client_count = argc > 1 ? atoi(argv[1]) : 4;
+	if (client_count < 0 || client_count > MAX_CLIENTS)
+		client_count = 4;
+	signal(SIGPIPE, SIG_IGN);
+	indigo_main_argc = argc;
+	indigo_main_argv = argv;
+	printf("%-40s %12s %12s\n", "stage", "heap [MB]", "delta [MB]");
+	indigo_start();
+	indigo_attach_client(&report_client);
+	report("bus started");
+	indigo_ccd_simulator(INDIGO_DRIVER_INIT, NULL);
+	indigo_mount_simulator(INDIGO_DRIVER_INIT, NULL);
+	indigo_dome_simulator(INDIGO_DRIVER_INIT, NULL);
+	indigo_gps_simulator(INDIGO_DRIVER_INIT, NULL);
+	indigo_rotator_simulator(INDIGO_DRIVER_INIT, NULL);
+	report("simulator drivers loaded");
+	indigo_agent_imager(INDIGO_DRIVER_INIT, NULL);
+	indigo_agent_guider(INDIGO_DRIVER_INIT, NULL);
+	indigo_agent_mount(INDIGO_DRIVER_INIT, NULL);
+	report("agents loaded");
+	// agents connect selected devices and republish their properties
+	select_device(IMAGER_AGENT_NAME, FILTER_CCD_LIST_PROPERTY_NAME, CCD_SIMULATOR_IMAGER_CAMERA_NAME);
+	select_device(IMAGER_AGENT_NAME, FILTER_WHEEL_LIST_PROPERTY_NAME, CCD_SIMULATOR_WHEEL_NAME);
+	select_device(IMAGER_AGENT_NAME, FILTER_FOCUSER_LIST_PROPERTY_NAME, CCD_SIMULATOR_FOCUSER_NAME);
+	select_device(GUIDER_AGENT_NAME, FILTER_CCD_LIST_PROPERTY_NAME, CCD_SIMULATOR_GUIDER_CAMERA_NAME);
+	select_device(GUIDER_AGENT_NAME, FILTER_GUIDER_LIST_PROPERTY_NAME, CCD_SIMULATOR_GUIDER_NAME);
+	select_device(MOUNT_AGENT_NAME, FILTER_MOUNT_LIST_PROPERTY_NAME, MOUNT_SIMULATOR_NAME);
+	select_device(MOUNT_AGENT_NAME, FILTER_DOME_LIST_PROPERTY_NAME, DOME_SIMULATOR_NAME);
+	select_device(MOUNT_AGENT_NAME, FILTER_GPS_LIST_PROPERTY_NAME, GPS_SIMULATOR_NAME);
+	report("devices selected in agents");
+	long size = 0;
+	for (int i = 0; i < record_count; i++)
+		size += records[i].size;
+	printf("%-40s %12.2f (%d properties)\n", "  properties defined by agents", size / 1048576.0, record_count);
+	indigo_client *protocol_adapters[MAX_CLIENTS];
+	int handles[MAX_CLIENTS][2];
+	for (int i = 0; i < client_count; i++) {
+		socketpair(AF_UNIX, SOCK_STREAM, 0, handles[i]);
+		protocol_adapters[i] = indigo_xml_device_adapter(handles[i][0], handles[i][0]);
+		indigo_attach_client(protocol_adapters[i]);
+		indigo_async((void *(*)(void *))parser_thread, protocol_adapters[i]);
+		indigo_async((void *(*)(void *))drain_thread, (void *)(long)handles[i][1]);
+		write(handles[i][1], "<getProperties version='2.0'/>\n", 31);
+	}
+	char stage[64];
+	snprintf(stage, sizeof(stage), "%d XML clients connected", client_count);
+	report(stage);
+	printf("\nsizeof(indigo_property) = %zu, sizeof(indigo_item) = %zu\n", sizeof(indigo_property), sizeof(indigo_item));
+	for (int i = 0; i < client_count; i++)
+		shutdown(handles[i][1], SHUT_RDWR);
+	sleep(1);
+	indigo_agent_mount(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_agent_guider(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_agent_imager(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_rotator_simulator(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_gps_simulator(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_dome_simulator(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_mount_simulator(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_ccd_simulator(INDIGO_DRIVER_SHUTDOWN, NULL);
+	indigo_stop();
+	return 0;
+}